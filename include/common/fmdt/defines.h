@@ -2,7 +2,10 @@
 
 #define MAX_ROI_SIZE 50000
 #define MAX_TRACKS_SIZE 10000
-#define MAX_KPPV_SIZE 200
 #define MAX_N_FRAMES 10000
 #define MAX_ROI_HISTORY_SIZE 10000
 #define MAX_BB_LIST_SIZE 20000
+#define BB_LOG_CHUNK_SIZE (1 << 20) // in bytes, the positions in the log are 32-bit (4096 chunks max)
+
+#define FEATURES_REG_GRID 4 // cells per dimension of the pairs stratification in the robust registration
+#define FEATURES_REG_MIN_SCALE 0.1 // floor of the residuals scale in the robust registration (in pixels)
@@ -8,7 +8,7 @@ enum obj_e { UNKNOWN = 0, METEOR, STAR, NOISE, N_OBJECTS };
 
 typedef struct {
     uint16_t* id;
-    uint32_t* frame;
+    uint64_t* frame;
     uint16_t* xmin;
     uint16_t* xmax;
     uint16_t* ymin;
@@ -16,6 +16,9 @@ typedef struct {
     uint32_t* S; // number of points
     uint32_t* Sx; // sum of x properties
     uint32_t* Sy; // sum of y properties
+    uint64_t* Sxx; // sum of x^2 (second-order moments, see 'features_compute_shape')
+    uint64_t* Syy; // sum of y^2
+    uint64_t* Sxy; // sum of x * y
     float* x; // abscisse du centre d'inertie x = Sx / S
     float* y; // ordonnee du centre d'inertie y = Sy / S
     float* dx; // erreur par rapport a l`image recalee
@@ -28,7 +31,7 @@ typedef struct {
     uint8_t* is_moving;
     uint8_t* is_extrapolated;
 
-    size_t _size; // current size/utilization of the fields
+    size_t _size; // current size/utilization of the fields (the entries after '_size' are always 0)
     size_t _max_size; // maximum amount of data that can be contained in the fields
 } ROI_t;
 
@@ -37,33 +40,88 @@ typedef struct track track_t;
 typedef struct ROI_light ROI_light_t;
 
 ROI_t* features_alloc_ROI_array(const size_t max_size);
+// clears the '_size' first entries and sets '_size' to 0 (the cost depends on the number of ROIs, not on '_max_size')
 void features_init_ROI_array(ROI_t* ROI_array);
 void features_free_ROI_array(ROI_t* ROI_array);
 void features_clear_index_ROI_array(ROI_t* ROI_array, const size_t r);
 void features_copy_elmt_ROI_array(const ROI_t* ROI_array_src, ROI_t* ROI_array_dest, const int i_src, const int i_dest);
 void features_copy_ROI_array(const ROI_t* ROI_array_src, ROI_t* ROI_array_dest);
 void features_init_ROI(ROI_t* stats, int n);
-void _features_extract(const uint32_t** img, const int i0, const int i1, const int j0, const int j1, uint16_t* ROI_id,
+
+// thread-local accumulators of a band of rows (see 'features_extract')
+typedef struct {
+    uint16_t* xmin;
+    uint16_t* xmax;
+    uint16_t* ymin;
+    uint16_t* ymax;
+    uint32_t* S; // always 0 between two extractions
+    uint32_t* Sx;
+    uint32_t* Sy;
+    uint64_t* Sxx;
+    uint64_t* Syy;
+    uint64_t* Sxy;
+    uint32_t* ids; // labels met in the band
+    size_t n_ids;
+} features_band_t;
+
+typedef struct {
+    int n_bands; // number of bands = number of threads (1 without OpenMP)
+    features_band_t* bands;
+    size_t _max_size; // maximum number of ROIs per extraction
+} features_bands_t;
+
+features_bands_t* features_alloc_bands(const int n_threads, const size_t max_size);
+void features_free_bands(features_bands_t* bands);
+// with 'bands' (and OpenMP), the image is split in 'bands->n_bands' horizontal bands accumulated in parallel, the
+// features are the same whatever the number of bands ('bands' can be NULL: sequential extraction). 'ROI_Sxx',
+// 'ROI_Syy' and 'ROI_Sxy' can be NULL (no second-order moments).
+void _features_extract(const uint16_t** img, const int i0, const int i1, const int j0, const int j1, uint16_t* ROI_id,
                        uint16_t* ROI_xmin, uint16_t* ROI_xmax, uint16_t* ROI_ymin, uint16_t* ROI_ymax, uint32_t* ROI_S,
-                       uint32_t* ROI_Sx, uint32_t* ROI_Sy, float* ROI_x, float* ROI_y, const size_t n_ROI);
-void features_extract(const uint32_t** img, const int i0, const int i1, const int j0, const int j1, const size_t n_ROI,
-                      ROI_t* ROI_array);
-// void features_filter_surface(ROI_t* ROI_array, uint32_t** img, uint32_t threshold_min, uint32_t threshold_max);
-void _features_merge_HI_CCL_v2(const uint32_t** M, const uint8_t** HI_in, uint8_t** HI_out, const int i0, const int i1,
-                               const int j0, const int j1, const uint16_t* ROI_id, const uint16_t* ROI_xmin,
-                               const uint16_t* ROI_xmax, const uint16_t* ROI_ymin, const uint16_t* ROI_ymax,
-                               uint32_t* ROI_S, const size_t n_ROI, const uint32_t S_min, const uint32_t S_max);
-void features_merge_HI_CCL_v2(const uint32_t** M, const uint8_t** HI_in, uint8_t** HI_out, const int i0, const int i1,
-                              const int j0, const int j1, ROI_t* ROI_array, const uint32_t S_min, const uint32_t S_max);
+                       uint32_t* ROI_Sx, uint32_t* ROI_Sy, uint64_t* ROI_Sxx, uint64_t* ROI_Syy, uint64_t* ROI_Sxy,
+                       float* ROI_x, float* ROI_y, const size_t n_ROI, features_bands_t* bands);
+void features_extract(const uint16_t** img, const int i0, const int i1, const int j0, const int j1, const size_t n_ROI,
+                      ROI_t* ROI_array, features_bands_t* bands);
+// void features_filter_surface(ROI_t* ROI_array, uint16_t** img, uint32_t threshold_min, uint32_t threshold_max);
+// 'M_rows' and 'HI_rows' can be NULL, otherwise the lines 'i' with 'M_rows[i]' = 0 ('HI_rows[i]' = 0) are empty in
+// 'M' ('HI_in') and are not read (see 'threshold_dual')
+void _features_merge_HI_CCL_v2(const uint16_t** M, const uint8_t** HI_in, uint8_t** HI_out, const uint8_t* M_rows,
+                               const uint8_t* HI_rows, const int i0, const int i1, const int j0, const int j1,
+                               const uint16_t* ROI_id, uint32_t* ROI_S, const size_t n_ROI, const uint32_t S_min,
+                               const uint32_t S_max);
+void features_merge_HI_CCL_v2(const uint16_t** M, const uint8_t** HI_in, uint8_t** HI_out, const uint8_t* M_rows,
+                              const uint8_t* HI_rows, const int i0, const int i1, const int j0, const int j1,
+                              ROI_t* ROI_array, const uint32_t S_min, const uint32_t S_max);
+// same as 'features_merge_HI_CCL_v2' with a bit-packed high threshold image (see 'tools_alloc_packed_matrix')
+void _features_merge_HI_CCL_packed(const uint16_t** M, const uint64_t** HI_in, uint8_t** HI_out,
+                                   const uint8_t* M_rows, const uint8_t* HI_rows, const int i0, const int i1,
+                                   const int j0, const int j1, const uint16_t* ROI_id, uint32_t* ROI_S,
+                                   const size_t n_ROI, const uint32_t S_min, const uint32_t S_max);
+void features_merge_HI_CCL_packed(const uint16_t** M, const uint64_t** HI_in, uint8_t** HI_out,
+                                  const uint8_t* M_rows, const uint8_t* HI_rows, const int i0, const int i1,
+                                  const int j0, const int j1, ROI_t* ROI_array, const uint32_t S_min,
+                                  const uint32_t S_max);
+// the second-order moments ('ROI_src_Sxx', ..., 'ROI_dest_Sxy') can be NULL (they are not copied)
 size_t _features_shrink_ROI_array(const uint16_t* ROI_src_id, const uint16_t* ROI_src_xmin,
                                   const uint16_t* ROI_src_xmax, const uint16_t* ROI_src_ymin,
                                   const uint16_t* ROI_src_ymax, const uint32_t* ROI_src_S, const uint32_t* ROI_src_Sx,
-                                  const uint32_t* ROI_src_Sy, const float* ROI_src_x, const float* ROI_src_y,
-                                  const size_t n_ROI_src, uint16_t* ROI_dest_id, uint16_t* ROI_dest_xmin,
-                                  uint16_t* ROI_dest_xmax, uint16_t* ROI_dest_ymin, uint16_t* ROI_dest_ymax,
-                                  uint32_t* ROI_dest_S, uint32_t* ROI_dest_Sx, uint32_t* ROI_dest_Sy, float* ROI_dest_x,
-                                  float* ROI_dest_y);
+                                  const uint32_t* ROI_src_Sy, const uint64_t* ROI_src_Sxx,
+                                  const uint64_t* ROI_src_Syy, const uint64_t* ROI_src_Sxy, const float* ROI_src_x,
+                                  const float* ROI_src_y, const size_t n_ROI_src, uint16_t* ROI_dest_id,
+                                  uint16_t* ROI_dest_xmin, uint16_t* ROI_dest_xmax, uint16_t* ROI_dest_ymin,
+                                  uint16_t* ROI_dest_ymax, uint32_t* ROI_dest_S, uint32_t* ROI_dest_Sx,
+                                  uint32_t* ROI_dest_Sy, uint64_t* ROI_dest_Sxx, uint64_t* ROI_dest_Syy,
+                                  uint64_t* ROI_dest_Sxy, float* ROI_dest_x, float* ROI_dest_y);
 void features_shrink_ROI_array(const ROI_t* ROI_array_src, ROI_t* ROI_array_dest);
+// Shape of a CC from its second-order central moments: semi-axes 'a' >= 'b' of the covariance ellipse (2 standard
+// deviations, i.e. the radius for a disk) and orientation 'theta' of the major axis (in radians, in [-pi/2; pi/2]).
+// The elongation is 'a' / 'b' ('b' = 0 for a straight segment).
+void _features_compute_shape(const uint32_t S, const uint32_t Sx, const uint32_t Sy, const uint64_t Sxx,
+                             const uint64_t Syy, const uint64_t Sxy, float* a, float* b, float* theta);
+void features_compute_shape(const ROI_t* ROI_array, const size_t r, float* a, float* b, float* theta);
+// Hot pixels filtering: the CCs with a major semi-axis smaller than 'a_min' (sharper than a star) are removed ('S' is
+// set to 0, same convention as the surface filtering). Has to be called before 'features_merge_HI_CCL_v2' to also
+// remove them from the output image.
+void features_filter_hot_pixels(ROI_t* ROI_array, const float a_min);
 double features_compute_mean_error(const ROI_t* stats);
 double features_compute_std_deviation(const ROI_t* stats, const double mean_error);
 void _features_compute_motion(const int32_t* ROI0_next_id, const float* ROI0_x, const float* ROI0_y, float* ROI0_dx,
@@ -74,11 +132,30 @@ void _features_compute_motion(const int32_t* ROI0_next_id, const float* ROI0_x,
 void features_compute_motion(const ROI_t* ROI_array1, ROI_t* ROI_array0, double* first_theta, double* first_tx,
                              double* first_ty, double* first_mean_error, double* first_std_deviation, double* theta,
                              double* tx, double* ty, double* mean_error, double* std_deviation);
+// Robust and budget-bounded version of 'features_compute_motion': the motion is fitted on at most 'max_pairs' pairs
+// (stratified on a grid, the largest CCs of each cell first, 'max_pairs' >= 'FEATURES_REG_GRID'^2 to select at least
+// one pair per cell) by at most 'n_iters' iterations of reweighted least
+// squares, starting from the motion of the previous frame ('prev_*', a least squares fit of the subset is used
+// instead if they are not finite). 'first_*' are the initial motion and its errors, the errors and the 'is_moving'
+// flags of all the CCs are still computed.
+void _features_compute_motion_robust(const int32_t* ROI0_next_id, const uint32_t* ROI0_S, const float* ROI0_x,
+                                     const float* ROI0_y, float* ROI0_dx, float* ROI0_dy, float* ROI0_error,
+                                     uint8_t* ROI0_is_moving, const size_t n_ROI0, const float* ROI1_x,
+                                     const float* ROI1_y, const size_t max_pairs, const int n_iters,
+                                     const double prev_theta, const double prev_tx, const double prev_ty,
+                                     double* first_theta, double* first_tx, double* first_ty,
+                                     double* first_mean_error, double* first_std_deviation, double* theta, double* tx,
+                                     double* ty, double* mean_error, double* std_deviation);
+void features_compute_motion_robust(const ROI_t* ROI_array1, ROI_t* ROI_array0, const size_t max_pairs,
+                                    const int n_iters, const double prev_theta, const double prev_tx,
+                                    const double prev_ty, double* first_theta, double* first_tx, double* first_ty,
+                                    double* first_mean_error, double* first_std_deviation, double* theta, double* tx,
+                                    double* ty, double* mean_error, double* std_deviation);
 void _features_ROI_write(FILE* f, const uint16_t* ROI_id, const uint16_t* ROI_xmin, const uint16_t* ROI_xmax,
                          const uint16_t* ROI_ymin, const uint16_t* ROI_ymax, const uint32_t* ROI_S,
                          const uint32_t* ROI_Sx, const uint32_t* ROI_Sy, const float* ROI_x, const float* ROI_y,
                          const int32_t* ROI_time, const int32_t* ROI_time_motion, const size_t n_ROI,
-                         const uint16_t* track_id, const ROI_light_t* track_end, const enum obj_e* track_obj_type,
+                         const uint32_t* track_id, const ROI_light_t* track_end, const enum obj_e* track_obj_type,
                          const size_t n_tracks, const unsigned age);
 void features_ROI_write(FILE* f, const ROI_t* ROI_array, const track_t* track_array, const unsigned age);
 void _features_ROI0_ROI1_write(FILE* f, const int frame, const uint16_t* ROI0_id, const uint16_t* ROI0_xmin,
@@ -90,7 +167,7 @@ void _features_ROI0_ROI1_write(FILE* f, const int frame, const uint16_t* ROI0_id
                                const uint16_t* ROI1_ymax, const uint32_t* ROI1_S, const uint32_t* ROI1_Sx,
                                const uint32_t* ROI1_Sy, const float* ROI1_x, const float* ROI1_y,
                                const int32_t* ROI1_time, const int32_t* ROI1_time_motion, const size_t n_ROI1,
-                               const uint16_t* track_id, const ROI_light_t* track_end, const enum obj_e* track_obj_type,
+                               const uint32_t* track_id, const ROI_light_t* track_end, const enum obj_e* track_obj_type,
                                const size_t n_tracks);
 void features_ROI0_ROI1_write(FILE* f, const int frame, const ROI_t* ROI_array0, const ROI_t* ROI_array1,
                               const track_t* track_array);
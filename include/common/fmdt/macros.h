@@ -40,3 +40,29 @@
 #define MAX(a, b) (((a) < (b)) ? (b) : (a))
 #endif
 #define CLAMP(x, a, b) MIN(MAX(x, a), b)
+// index of the least significant bit set to 1 in a 64-bit word ('x' has to be != 0)
+#if defined(__GNUC__) || defined(__clang__)
+#define CTZ64(x) __builtin_ctzll(x)
+#else
+static inline int CTZ64(uint64_t x) {
+    int n = 0;
+    while (!(x & 1)) {
+        x >>= 1;
+        n++;
+    }
+    return n;
+}
+#endif
+// number of bits set to 1 in a 64-bit word
+#if defined(__GNUC__) || defined(__clang__)
+#define POPCNT64(x) __builtin_popcountll(x)
+#else
+static inline int POPCNT64(uint64_t x) {
+    int n = 0;
+    while (x) {
+        x &= x - 1;
+        n++;
+    }
+    return n;
+}
+#endif
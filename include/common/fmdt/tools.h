@@ -7,6 +7,9 @@
 // rgb8 is defined in NRC2 (nrtype.h), but adding "#include <nrtype.h>" here is overkill
 typedef struct { uint8_t r; uint8_t g; uint8_t b; } rgb8_t;
 
+// number of 64-bit words of a bit-packed line (bit 'k' of the word 'w' is the pixel j0 + 64 * w + k)
+#define PACKED_N_WORDS(j0, j1) ((size_t)(((j1) - (j0)) + 64) / 64)
+
 typedef struct BB_coord_t {
     int track_id;
     int xmin;
@@ -45,3 +48,14 @@ void tools_copy_ui8matrix_ui8matrix(const uint8_t** X, const int i0, const int i
 void tools_convert_ui8matrix_ui32matrix(const uint8_t** X, const int nrl, const int nrh, const int ncl, const int nch,
                                         uint32_t** Y);
 void tools_write_PNM_row(const uint8_t* line, const int width, FILE* file);
+// bit-packed binary images (1 bit per pixel), the rows are indexed from 'i0' and the words from 0
+uint64_t** tools_alloc_packed_matrix(const int i0, const int i1, const int j0, const int j1);
+void tools_free_packed_matrix(uint64_t** M, const int i0);
+// memory arenas: the field arrays of a structure of arrays are slices of a single allocation
+#define TOOLS_ARENA_ALIGN 64 // alignment of the arenas and of their slices (= cache line)
+// 'TOOLS_ARENA_ALIGN'-byte aligned arena of 'size' bytes, the large arenas are on (transparent) huge pages if possible
+void* tools_arena_alloc(const size_t size);
+void tools_arena_free(void* arena);
+// next slice of 'size' bytes at '*offset' in 'arena', '*offset' is moved to the next aligned slice. If 'arena' is
+// NULL, only '*offset' is updated (to compute the size of an arena before its allocation).
+void* tools_arena_slice(void* arena, size_t* offset, const size_t size);
@@ -23,7 +23,7 @@ enum change_state_reason_e { REASON_TOO_BIG_ANGLE = 1, REASON_WRONG_DIRECTION, R
 
 typedef struct ROI_light {
     uint16_t id;
-    uint32_t frame;
+    uint64_t frame;
     uint16_t xmin;
     uint16_t xmax;
     uint16_t ymin;
@@ -40,7 +40,7 @@ typedef struct ROI_light {
 } ROI_light_t;
 
 typedef struct track {
-    uint16_t* id;
+    uint32_t* id;
     ROI_light_t* begin;
     ROI_light_t* end;
     float* extrapol_x;
@@ -52,28 +52,84 @@ typedef struct track {
     size_t _size; // current size/utilization of the fields
     size_t _max_size; // maximum amount of data that can be contained in the fields
     size_t _offset;
+    size_t _n_flushed; // number of tracks removed by 'tracking_flush_tracks' (the next ids follow them)
+    unsigned _n_flushed_objects[N_OBJECTS]; // number of removed tracks per type of object
 } track_t;
 
-typedef struct BB_t {
+typedef struct {
+    uint64_t frame;
+    uint16_t track_id;
     uint16_t bb_x;
     uint16_t bb_y;
     uint16_t rx;
     uint16_t ry;
-    uint16_t track_id;
-    struct BB_t* next;
 } BB_t;
 
+// Append-only log of the bounding boxes of all the tracks. The records are packed in arena chunks of
+// 'BB_LOG_CHUNK_SIZE' bytes and chained per track, a record can be delta encoded from the previous record of its track
+// (12 bytes instead of 23). The tracks are identified by their position + 1 in the 'track_t' array: this is their id
+// until the array is compacted by 'tracking_flush_tracks' (then the log can only be read per track).
+typedef struct {
+    uint8_t** chunks;
+    uint32_t* chunks_size; // number of bytes used in each chunk
+    size_t n_chunks;
+    size_t _max_chunks;
+    uint32_t* track_head; // position + 1 of the first record of each track (0 = no record), indexed by track id
+    uint32_t* track_tail; // position + 1 of the last record of each track
+    uint32_t* track_n_BB; // number of records of each track
+    BB_t* track_last; // last bounding box of each track (reference of the delta encoding)
+    uint64_t max_frame; // biggest frame in the log
+    size_t _size; // number of records
+    size_t _n_dropped; // number of records of the flushed tracks (reclaimed when they are the majority)
+    size_t _max_tracks;
+    int delta; // delta encoding of the records
+} BB_log_t;
+
+// ROI of a previous frame, only the fields read by the tracking (tracks creation and angle check)
+typedef struct {
+    uint64_t frame;
+    uint16_t xmin;
+    uint16_t xmax;
+    uint16_t ymin;
+    uint16_t ymax;
+    float x;
+    float y;
+    int32_t prev_id;
+} ROI_hist_elmt_t;
+
+// Ring buffer of the ROIs of the last frames, the slot of the current frame is 'array[_head]' and the slot of the
+// frame 't - age' is 'array[(_head + age) % _max_size]'
 typedef struct {
-    ROI_light_t** array;
+    ROI_hist_elmt_t** array;
     uint32_t* n_ROI;
+    uint32_t* _max_n_ROI_slot; // allocated size of each slot (grows with the number of ROIs)
     uint32_t _max_n_ROI;
+    size_t _head;
     size_t _size; // current size/utilization of the 'ROI_history_t.array' field
     size_t _max_size; // maximum amount of data that can be contained in the 'ROI_history_t.array' field
 } ROI_history_t;
 
+// Uniform grid over the centroids of the ROIs of one frame, the ROIs of the cell 'c' are
+// 'ROI_ids[cell_start[c]]' ... 'ROI_ids[cell_start[c + 1] - 1]' (in increasing order)
+typedef struct {
+    uint32_t* cell_start;
+    uint32_t* ROI_ids;
+    uint32_t* matches; // scratch buffer of the queries
+    float x0;
+    float y0;
+    float inv_cell_size;
+    size_t n_cols;
+    size_t n_rows;
+    size_t _max_cells;
+    size_t _max_ROI;
+    int is_built; // the grid is built on the first query of the frame
+} ROI_grid_t;
+
 typedef struct {
     ROI_history_t* ROI_history;
     ROI_light_t* ROI_list;
+    ROI_grid_t* ROI0_grid; // ROIs of 't - 1' (re-acquisition of the extrapolated tracks)
+    ROI_grid_t* ROI1_grid; // ROIs of 't' without predecessor (re-acquisition of the lost tracks)
 } tracking_data_t;
 
 extern enum color_e g_obj_to_color[N_OBJECTS];
@@ -91,38 +147,55 @@ void tracking_init_track_array(track_t* track_array);
 void tracking_free_track_array(track_t* track_array);
 void tracking_clear_index_track_array(track_t* track_array, const size_t t);
 // void tracking_init_tracks(track_t* tracks, int n);
-void tracking_init_BB_array(BB_t** BB_array);
-void tracking_free_BB_array(BB_t** BB_array);
-void _tracking_perform(tracking_data_t* tracking_data, const uint16_t* ROI0_id, const uint32_t* ROI0_frame,
+BB_log_t* tracking_alloc_BB_log(const size_t max_tracks, const int delta);
+void tracking_init_BB_log(BB_log_t* BB_log);
+void tracking_free_BB_log(BB_log_t* BB_log);
+void tracking_add_BB(BB_log_t* BB_log, const uint16_t rx, const uint16_t ry, const uint16_t bb_x, const uint16_t bb_y,
+                     const uint16_t track, const uint64_t frame);
+size_t tracking_get_track_n_BB(const BB_log_t* BB_log, const uint16_t track);
+// Decodes the bounding boxes of a track (in insertion order) in 'BBs' and returns their number
+size_t tracking_get_track_BB(const BB_log_t* BB_log, const uint16_t track, BB_t* BBs);
+// Streaming: removes the tracks finished before 'frame - 1' (all the tracks if 'all' is set) from 'track_array' and
+// from 'BB_log', the other tracks are moved to the beginning of the array (in the same order). The removed tracks are
+// written in 'f_tracks' and their bounding boxes in 'f_BB' (sorted by frame, only the meteors if 'track_all' is not
+// set), the files can be NULL. Returns the number of removed tracks.
+size_t tracking_flush_tracks(track_t* track_array, BB_log_t* BB_log, const size_t frame, FILE* f_tracks, FILE* f_BB,
+                             const int track_all, const int all);
+// the new tracks are ignored (with a warning) when there are already 'max_tracks' tracks
+void _tracking_perform(tracking_data_t* tracking_data, const uint16_t* ROI0_id, const uint64_t* ROI0_frame,
                        const uint16_t* ROI0_xmin, const uint16_t* ROI0_xmax, const uint16_t* ROI0_ymin,
                        const uint16_t* ROI0_ymax, const float* ROI0_x, const float* ROI0_y, const float* ROI0_error,
                        const int32_t* ROI0_time, const int32_t* ROI0_time_motion, const int32_t* ROI0_prev_id,
                        const int32_t* ROI0_next_id, const uint8_t* ROI0_is_extrapolated, const size_t n_ROI0,
-                       const uint16_t* ROI1_id, const uint32_t* ROI1_frame, const uint16_t* ROI1_xmin,
+                       const uint16_t* ROI1_id, const uint64_t* ROI1_frame, const uint16_t* ROI1_xmin,
                        const uint16_t* ROI1_xmax, const uint16_t* ROI1_ymin, const uint16_t* ROI1_ymax,
                        const float* ROI1_x, const float* ROI1_y, int32_t* ROI1_time, int32_t* ROI1_time_motion,
                        const int32_t* ROI1_prev_id, uint8_t* ROI1_is_extrapolated, const size_t n_ROI1,
-                       uint16_t* track_id, ROI_light_t* track_begin, ROI_light_t* track_end, float* track_extrapol_x,
+                       uint32_t* track_id, ROI_light_t* track_begin, ROI_light_t* track_end, float* track_extrapol_x,
                        float* track_extrapol_y, enum state_e* track_state, enum obj_e* track_obj_type,
                        enum change_state_reason_e* track_change_state_reason, size_t* offset_tracks, size_t* n_tracks,
-                       BB_t** BB_array, size_t frame, double theta, double tx, double ty, double mean_error,
-                       double std_deviation, size_t r_extrapol, float angle_max, float diff_dev, int track_all,
-                       size_t fra_star_min, size_t fra_meteor_min, size_t fra_meteor_max);
+                       const size_t max_tracks, const size_t n_flushed_tracks, BB_log_t* BB_log, size_t frame,
+                       double theta, double tx, double ty, double mean_error, double std_deviation,
+                       size_t r_extrapol, float angle_max, float diff_dev, int track_all, size_t fra_star_min,
+                       size_t fra_meteor_min, size_t fra_meteor_max);
 void tracking_perform(tracking_data_t* tracking_data, const ROI_t* ROI_array0, ROI_t* ROI_array1, track_t* track_array,
-                      BB_t** BB_array, size_t frame, double theta, double tx, double ty, double mean_error,
+                      BB_log_t* BB_log, size_t frame, double theta, double tx, double ty, double mean_error,
                       double std_deviation, size_t r_extrapol, float angle_max, float diff_dev, int track_all,
                       size_t fra_star_min, size_t fra_meteor_min, size_t fra_meteor_max);
-size_t _tracking_count_objects(const uint16_t* track_id, const enum obj_e* track_obj_type, unsigned* n_stars,
+size_t _tracking_count_objects(const uint32_t* track_id, const enum obj_e* track_obj_type, unsigned* n_stars,
                                unsigned* n_meteors, unsigned* n_noise, const size_t n_tracks);
 // return the real number of tracks
 size_t tracking_count_objects(const track_t* track_array, unsigned* n_stars, unsigned* n_meteors, unsigned* n_noise);
-// void tracking_print_array_BB(BB_t** tabBB, int n);
-void _tracking_track_array_write(FILE* f, const uint16_t* track_id, const ROI_light_t* track_begin,
+void _tracking_track_array_write(FILE* f, const uint32_t* track_id, const ROI_light_t* track_begin,
                                  const ROI_light_t* track_end, const enum obj_e* track_obj_type,
                                  const size_t n_tracks);
 void tracking_track_array_write(FILE* f, const track_t* track_array);
+void tracking_track_array_write_header(FILE* f);
 // void tracking_print_buffer(ROIx2_t* buffer, int n);
 void tracking_parse_tracks(const char* filename, track_t* track_array);
 // void tracking_save_tracks(const char* filename, track_t* tracks, int n);
-void tracking_save_array_BB(const char* filename, BB_t** BB_array, track_t* track_array, int N, int track_all);
+// all the bounding boxes of the log sorted by frame: the tracks must never have been flushed (the streaming mode writes
+// the bounding boxes in 'tracking_flush_tracks' instead), exits with an error otherwise
+void tracking_save_array_BB(const char* filename, const BB_log_t* BB_log, const track_t* track_array,
+                            const int track_all);
 size_t tracking_get_track_time(const track_t* track_array, const size_t t);
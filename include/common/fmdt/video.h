@@ -6,13 +6,13 @@
 typedef struct {
     ffmpeg_options ffmpeg_opts;
     ffmpeg_handle ffmpeg;
-    int frame_start;
-    int frame_end;
-    int frame_skip;
-    int frame_current;
+    size_t frame_start;
+    size_t frame_end;
+    size_t frame_skip;
+    size_t frame_current;
 } video_t;
 
-video_t* video_init_from_file(const char* filename, const int start, const int end, const int skip,
+video_t* video_init_from_file(const char* filename, const size_t start, const size_t end, const size_t skip,
                               const size_t n_ffmpeg_threads, int* i0, int* i1, int* j0, int* j1);
 int video_get_next_frame(video_t* video, uint8_t** I);
 void video_free(video_t* video);
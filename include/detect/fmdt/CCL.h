@@ -2,19 +2,133 @@
 
 #include <stdint.h>
 
+#include "fmdt/features.h"
+
+// CCL implementations (= engines, see 'CCL_alloc_and_init_data')
+// - CCL_IMPL_LSL: Light Speed Labeling, run-based labeling (segments + equivalences between the segments)
+// - CCL_IMPL_BLOCK: 2x2 block-based labeling, the equivalences are built between the blocks of 2x2 pixels (the
+//                   pixels of a block are always connected), then the pixels get the label of their block
+enum ccl_impl_e { CCL_IMPL_LSL = 0, CCL_IMPL_BLOCK, N_CCL_IMPL };
+
+#define CCL_IMPL_LSL_STR "LSL"
+#define CCL_IMPL_BLOCK_STR "block"
+
+// capabilities of the CCL implementations (see 'CCL_impl_caps')
+#define CCL_CAP_FEATURES 0x1 // the features are computed during the labeling (cheaper than a 'features_extract')
+#define CCL_CAP_THREADS 0x2  // 'n_threads' > 1 is supported (strip-parallel labeling)
+#define CCL_CAP_ROWS 0x4     // the empty lines of 'img_rows' are skipped (otherwise 'img_rows' is ignored)
+#define CCL_CAP_PACKED 0x8   // bit-packed input images are supported ('CCL_LSL_apply_packed')
+#define CCL_CAP_BAND 0x10    // fused thresholds + labeling by bands ('CCL_LSL_threshold_apply_with_features')
+
 typedef struct {
     int i0, i1, j0, j1;
-    uint32_t** er;  // Relative labels
+    uint16_t** er;      // Relative labels
     //uint32_t** ea;  // Absolute labels
-    uint32_t** era; // Relative/Absolute labels equivalences;
-    uint32_t** rlc; // Run-length coding
-    uint32_t* eq;   // Table d'équivalence
-    uint32_t* ner;  // Number of relative labels
+    uint32_t** era;     // Relative/Absolute labels equivalences;
+    uint16_t** rlc;     // Run-length coding
+    uint32_t* eq;       // Table d'équivalence
+    uint32_t* ner;      // Number of relative labels
+    uint8_t** band;     // Thresholded lines of the bands (see 'CCL_LSL_threshold_apply_with_features')
+    uint8_t* band_rows; // Non-empty lines of the bands
 } CCL_data_t;
 
+typedef struct {
+    int i0, i1, j0, j1;
+    uint32_t** blk; // Provisional labels of the 2x2 blocks
+    uint8_t** msk;  // Masks of the foreground pixels of the 2x2 blocks (with a border of empty blocks)
+    uint32_t* eq;   // Equivalence table of the provisional labels
+    uint32_t* lut;  // Final labels of the roots of the equivalence table
+} CCL_block_data_t;
+
+// generic CCL data: the data of the selected implementation
+typedef struct {
+    enum ccl_impl_e impl;
+    int i0, i1, j0, j1;
+    void* metadata; // 'CCL_data_t' or 'CCL_block_data_t'
+    features_bands_t* ftr_bands; // bands of 'features_extract' (NULL with 'CCL_CAP_FEATURES' or with 1 thread)
+} CCL_gen_data_t;
+
+// selects the segment detection for the CPU, has to be called once before the labelings run in parallel (it is done
+// by 'CCL_LSL_alloc_and_init_data', the '_CCL_LSL_apply*' functions on their own data have to call it first)
+void CCL_LSL_init_dispatch(void);
 CCL_data_t* CCL_LSL_alloc_and_init_data(int i0, int i1, int j0, int j1);
-uint32_t _CCL_LSL_apply(uint32_t** data_er, uint32_t** data_era, uint32_t** data_rlc, uint32_t* data_eq,
-                        uint32_t* data_ner, const uint8_t** img_in, uint32_t** img_out, const int i0, const int i1,
-                        const int j0, const int j1);
-uint32_t CCL_LSL_apply(CCL_data_t *data, const uint8_t** img_in, uint32_t** img_out);
+// 'n_threads' > 1 enables the strip-parallel labeling (requires OpenMP, the labels are the same as with 1 thread)
+// 'img_rows' can be NULL, otherwise the lines 'i' with 'img_rows[i]' = 0 are considered empty and are skipped: their
+// labels are not written, 'img_out' has to contain the labels of the previous call (or zeros)
+uint32_t _CCL_LSL_apply(uint16_t** data_er, uint32_t** data_era, uint16_t** data_rlc, uint32_t* data_eq,
+                        uint32_t* data_ner, const uint8_t** img_in, const uint8_t* img_rows, uint16_t** img_out,
+                        const int i0, const int i1, const int j0, const int j1, const int n_threads);
+uint32_t CCL_LSL_apply(CCL_data_t* data, const uint8_t** img_in, const uint8_t* img_rows, uint16_t** img_out,
+                       const int n_threads);
+// same as 'CCL_LSL_apply' but also computes the features of the CCs (= 'features_extract') during the labeling
+// ('ROI_Sxx', 'ROI_Syy' and 'ROI_Sxy' can be NULL, then the second-order moments are not computed)
+uint32_t _CCL_LSL_apply_with_features(uint16_t** data_er, uint32_t** data_era, uint16_t** data_rlc,
+                                      uint32_t* data_eq, uint32_t* data_ner, const uint8_t** img_in,
+                                      const uint8_t* img_rows, uint16_t** img_out, const int i0, const int i1,
+                                      const int j0, const int j1, const int n_threads, uint16_t* ROI_id,
+                                      uint16_t* ROI_xmin, uint16_t* ROI_xmax, uint16_t* ROI_ymin, uint16_t* ROI_ymax,
+                                      uint32_t* ROI_S, uint32_t* ROI_Sx, uint32_t* ROI_Sy, uint64_t* ROI_Sxx,
+                                      uint64_t* ROI_Syy, uint64_t* ROI_Sxy, float* ROI_x, float* ROI_y);
+uint32_t CCL_LSL_apply_with_features(CCL_data_t* data, const uint8_t** img_in, const uint8_t* img_rows,
+                                     uint16_t** img_out, ROI_t* ROI_array, const int n_threads);
+// bit-packed input image (1 bit per pixel, see 'tools_alloc_packed_matrix'), same labels as 'CCL_LSL_apply'
+uint32_t _CCL_LSL_apply_packed(uint16_t** data_er, uint32_t** data_era, uint16_t** data_rlc, uint32_t* data_eq,
+                               uint32_t* data_ner, const uint64_t** img_in, const uint8_t* img_rows,
+                               uint16_t** img_out, const int i0, const int i1, const int j0, const int j1,
+                               const int n_threads);
+uint32_t CCL_LSL_apply_packed(CCL_data_t* data, const uint64_t** img_in, const uint8_t* img_rows, uint16_t** img_out,
+                              const int n_threads);
+uint32_t _CCL_LSL_apply_packed_with_features(uint16_t** data_er, uint32_t** data_era, uint16_t** data_rlc,
+                                             uint32_t* data_eq, uint32_t* data_ner, const uint64_t** img_in,
+                                             const uint8_t* img_rows, uint16_t** img_out, const int i0,
+                                             const int i1, const int j0, const int j1, const int n_threads,
+                                             uint16_t* ROI_id, uint16_t* ROI_xmin, uint16_t* ROI_xmax,
+                                             uint16_t* ROI_ymin, uint16_t* ROI_ymax, uint32_t* ROI_S,
+                                             uint32_t* ROI_Sx, uint32_t* ROI_Sy, uint64_t* ROI_Sxx, uint64_t* ROI_Syy,
+                                             uint64_t* ROI_Sxy, float* ROI_x, float* ROI_y);
+uint32_t CCL_LSL_apply_packed_with_features(CCL_data_t* data, const uint64_t** img_in, const uint8_t* img_rows,
+                                            uint16_t** img_out, ROI_t* ROI_array, const int n_threads);
+// fused front end: thresholds 'img_in' (grayscale) and labels the CCs of 'threshold_min' by bands of 'band_size'
+// lines that stay in the cache, the binary image of 'threshold_max' is written in 'img_max_out'. The empty lines are
+// skipped (same convention as 'img_rows'), 'rows_min' and 'rows_max' are the same as in 'threshold_dual'.
+uint32_t _CCL_LSL_threshold_apply_with_features(uint16_t** data_er, uint32_t** data_era, uint16_t** data_rlc,
+                                                uint32_t* data_eq, uint32_t* data_ner, uint8_t** data_band,
+                                                uint8_t* data_band_rows, const uint8_t** img_in,
+                                                uint8_t** img_max_out, uint16_t** img_out, uint8_t* rows_min,
+                                                uint8_t* rows_max, const int i0, const int i1, const int j0,
+                                                const int j1, const uint8_t threshold_min,
+                                                const uint8_t threshold_max, const int band_size,
+                                                const int n_threads, uint16_t* ROI_id, uint16_t* ROI_xmin,
+                                                uint16_t* ROI_xmax, uint16_t* ROI_ymin, uint16_t* ROI_ymax,
+                                                uint32_t* ROI_S, uint32_t* ROI_Sx, uint32_t* ROI_Sy, uint64_t* ROI_Sxx,
+                                                uint64_t* ROI_Syy, uint64_t* ROI_Sxy, float* ROI_x, float* ROI_y);
+uint32_t CCL_LSL_threshold_apply_with_features(CCL_data_t* data, const uint8_t** img_in, uint8_t** img_max_out,
+                                               uint16_t** img_out, uint8_t* rows_min, uint8_t* rows_max,
+                                               const uint8_t threshold_min, const uint8_t threshold_max,
+                                               const int band_size, ROI_t* ROI_array, const int n_threads);
 void CCL_LSL_free_data(CCL_data_t* data);
+
+CCL_block_data_t* CCL_block_alloc_and_init_data(int i0, int i1, int j0, int j1);
+// the labels are the same as with 'CCL_LSL_apply' (the CCs are numbered in the raster order of their first pixel),
+// 'img_out' is fully written
+uint32_t _CCL_block_apply(uint32_t** data_blk, uint8_t** data_msk, uint32_t* data_eq, uint32_t* data_lut,
+                          const uint8_t** img_in, uint16_t** img_out, const int i0, const int i1, const int j0,
+                          const int j1);
+uint32_t CCL_block_apply(CCL_block_data_t* data, const uint8_t** img_in, uint16_t** img_out);
+void CCL_block_free_data(CCL_block_data_t* data);
+
+// engine interface: the implementation is selected at the allocation and the 'CCL_*' functions call it, the
+// unsupported parameters are ignored (see 'CCL_impl_caps'). With all the implementations, at most 'MAX_ROI_SIZE' CCs
+// are labeled (in the raster order of their first pixel), the pixels of the next CCs are set to 0 with a warning.
+enum ccl_impl_e CCL_string_to_impl(const char* string);
+uint32_t CCL_impl_caps(const enum ccl_impl_e impl);
+// 'n_threads' is the number of threads of the features extraction in 'CCL_apply_with_features' (ignored with
+// 'CCL_CAP_FEATURES')
+CCL_gen_data_t* CCL_alloc_and_init_data(const enum ccl_impl_e impl, int i0, int i1, int j0, int j1,
+                                        const int n_threads);
+uint32_t CCL_apply(CCL_gen_data_t* data, const uint8_t** img_in, const uint8_t* img_rows, uint16_t** img_out,
+                   const int n_threads);
+// without 'CCL_CAP_FEATURES', the features are computed from 'img_out' by 'features_extract'
+uint32_t CCL_apply_with_features(CCL_gen_data_t* data, const uint8_t** img_in, const uint8_t* img_rows,
+                                 uint16_t** img_out, ROI_t* ROI_array, const int n_threads);
+void CCL_free_data(CCL_gen_data_t* data);
@@ -4,21 +4,56 @@
 
 #include "fmdt/features.h"
 
+// association solvers (= how the conflicts between the k-nearest neighbours are resolved)
+// - ASSO_RANK: a ROI0 takes its nearest free ROI1 unless a next ROI0 has the same ROI1 at the same rank and closer
+// - ASSO_GREEDY: the candidate pairs are associated by increasing distance (priority queue)
+// - ASSO_AUCTION: auction algorithm, maximizes the sum of (max_dist - distance) over the associated pairs
+enum asso_e { ASSO_RANK = 0, ASSO_GREEDY, ASSO_AUCTION, N_ASSO };
+
+#define ASSO_RANK_STR "rank"
+#define ASSO_GREEDY_STR "greedy"
+#define ASSO_AUCTION_STR "auction"
+
+// the side of the grid cells is doubled until there is no more than KPPV_GRID_CELLS_PER_ROI cells per ROI1
+#define KPPV_GRID_CELLS_PER_ROI 4
+
 typedef struct {
-    int i0, i1, j0, j1;
-    uint32_t** nearest;
-    float** distances;
+    int max_k; // maximum number of neighbours per ROI0
+    size_t max_ROI_size; // maximum number of ROIs per frame
+    size_t max_n_pairs; // = max_k * max_ROI_size
+    // k-nearest neighbours of each ROI0 (= candidate pairs closer than max_dist), stored in a CSR way: the pairs of the
+    // ROI0 'i' are in [pairs_start[i], pairs_start[i + 1]) and sorted by increasing rank
+    uint32_t* pairs_start;
+    uint32_t* pairs_ROI0; // index of the ROI0 in the pair (starts from 0)
+    uint32_t* pairs_ROI1; // index of the ROI1 in the pair (starts from 0)
+    float* pairs_dist; // squared distance between the ROI0 and the ROI1
+    uint32_t* pairs_rank; // rank of the ROI1 in the k-nearest neighbours of the ROI0 (starts from 1)
     uint32_t* conflicts;
+    uint32_t* grid_cells; // CSR offsets of the spatial grid over the ROI1 centroids
+    uint32_t* grid_ROI1; // ROI1 indices sorted by grid cell
+    uint32_t* candidates; // ROI1 indices close to the current ROI0 (temporary buffer)
+    float* candidates_dist; // distances of the candidates (temporary buffer)
+    uint32_t* candidates_rank; // ranks of the candidates (temporary buffer)
+    uint32_t* rev_start; // CSR offsets of the pairs per ROI1 (temporary buffer)
+    uint32_t* rev_pairs; // pair indices sorted by ROI1 (temporary buffer)
+    uint32_t* heap; // priority queue of pairs for the greedy solver (temporary buffer)
+    float* price; // price of each ROI1 for the auction solver (temporary buffer)
+    int32_t* owner; // ROI0 index that holds each ROI1 for the auction solver (temporary buffer)
+    int32_t* assigned; // pair held by each ROI0 for the auction solver (temporary buffer)
+    uint32_t* queue; // ROI0 waiting to bid for the auction solver (temporary buffer)
 } KKPV_data_t;
 
-KKPV_data_t* KPPV_alloc_and_init_data(int i0, int i1, int j0, int j1);
-void _KPPV_match(uint32_t** data_nearest, float** data_distances, uint32_t* data_conflicts, const uint16_t* ROI0_id,
-                 const float* ROI0_x, const float* ROI0_y, int32_t* ROI0_next_id, const size_t n_ROI0,
-                 const uint16_t* ROI1_id, const float* ROI1_x, const float* ROI1_y, int32_t* ROI1_prev_id, const
-                 size_t n_ROI1, const int k);
-void KPPV_match(KKPV_data_t* data, ROI_t* ROI_array0, ROI_t* ROI_array1, const int k);
+KKPV_data_t* KPPV_alloc_and_init_data(const int max_k, const size_t max_ROI_size);
+enum asso_e KPPV_string_to_asso(const char* string);
+void _KPPV_match(KKPV_data_t* data, const uint16_t* ROI0_id, const float* ROI0_x, const float* ROI0_y,
+                 int32_t* ROI0_next_id, const size_t n_ROI0, const uint16_t* ROI1_id, const float* ROI1_x,
+                 const float* ROI1_y, int32_t* ROI1_prev_id, const size_t n_ROI1, const int k, const float max_dist,
+                 const double theta, const double tx, const double ty, const enum asso_e asso);
+void KPPV_match(KKPV_data_t* data, ROI_t* ROI_array0, ROI_t* ROI_array1, const int k, const float max_dist,
+                const double theta, const double tx, const double ty, const enum asso_e asso);
 void KPPV_free_data(KKPV_data_t* data);
-void _KPPV_asso_conflicts_write(FILE* f, const uint32_t** KPPV_data_nearest, const float** KPPV_data_distances,
-                                const uint16_t* ROI_id, const uint32_t* ROI_S, const float* ROI_dx, const float* ROI_dy,
-                                const float* ROI_error, const int32_t* ROI_next_id, const size_t n_ROI);
+void _KPPV_asso_conflicts_write(FILE* f, const uint32_t* KPPV_pairs_start, const uint32_t* KPPV_pairs_ROI1,
+                                const float* KPPV_pairs_dist, const uint32_t* KPPV_pairs_rank, const uint16_t* ROI_id,
+                                const uint32_t* ROI_S, const float* ROI_dx, const float* ROI_dy, const float* ROI_error,
+                                const int32_t* ROI_next_id, const size_t n_ROI);
 void KPPV_asso_conflicts_write(FILE* f, const KKPV_data_t* KPPV_data, const ROI_t* ROI_array);
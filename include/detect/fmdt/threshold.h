@@ -4,6 +4,17 @@
 
 void threshold(const uint8_t** m_in, uint8_t** m_out, const int i0, const int i1, const int j0, const int j1,
                const uint8_t threshold);
+// bit-packed output (1 bit per pixel, see 'tools_alloc_packed_matrix')
+void threshold_packed(const uint8_t** m_in, uint64_t** m_out, const int i0, const int i1, const int j0, const int j1,
+                      const uint8_t threshold);
+// both thresholds in one read of 'm_in' (vectorized with AVX2, SSE2 or NEON when available), 'rows_min[i]' and
+// 'rows_max[i]' are set to 1 if the line 'i' of the corresponding binary image is not empty (can be NULL)
+void threshold_dual(const uint8_t** m_in, uint8_t** m_out_min, uint8_t** m_out_max, uint8_t* rows_min,
+                    uint8_t* rows_max, const int i0, const int i1, const int j0, const int j1,
+                    const uint8_t threshold_min, const uint8_t threshold_max);
+void threshold_dual_packed(const uint8_t** m_in, uint64_t** m_out_min, uint64_t** m_out_max, uint8_t* rows_min,
+                           uint8_t* rows_max, const int i0, const int i1, const int j0, const int j1,
+                           const uint8_t threshold_min, const uint8_t threshold_max);
 void threshold_low(const uint8_t** m_in, uint8_t** m_out, const int i0, const int i1, const int j0, const int j1,
                    const uint8_t threshold);
 void threshold_high(const uint8_t** m_in, uint8_t** m_out, const int i0, const int i1, const int j0, const int j1,
@@ -15,17 +15,18 @@ class CCL_LSL : public aff3ct::module::Module {
 protected:
     const int i0, i1, j0, j1;
     const int b;
+    const int n_threads;
     // CCL_data_t *data;
     const uint8_t** in_img;
-    uint32_t** out_img;
-    uint32_t** out_data_er;
+    uint16_t** out_img;
+    uint16_t** out_data_er;
     uint32_t** out_data_era;
-    uint32_t** out_data_rlc;
+    uint16_t** out_data_rlc;
 public:
-    CCL_LSL(const int i0, const int i1, const int j0, const int j1, const int b);
+    CCL_LSL(const int i0, const int i1, const int j0, const int j1, const int b, const int n_threads = 1);
     virtual ~CCL_LSL();
     virtual CCL_LSL* clone() const;
-    inline uint32_t** get_out_img();
+    inline uint16_t** get_out_img();
     inline aff3ct::module::Task& operator[](const ccl::tsk t);
     inline aff3ct::module::Socket& operator[](const ccl::sck::apply s);
 
@@ -2,7 +2,7 @@
 
 #include "fmdt/CCL_LSL/CCL_LSL.hpp"
 
-uint32_t** CCL_LSL::get_out_img() {
+uint16_t** CCL_LSL::get_out_img() {
     return this->out_img;
 }
 
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+#include <aff3ct.hpp>
+
+#include "fmdt/CCL.h"
+
+namespace ccl_eng {
+    enum class tsk : size_t { apply, SIZE };
+    namespace sck {
+        enum class apply : size_t { in_img, out_img, out_n_ROI, status };
+    }
+}
+
+// CCL with the implementation selected at the construction (see 'CCL_alloc_and_init_data'), the internal data of the
+// labeling are not exposed (contrary to the 'CCL_LSL' module)
+class CCL_engine : public aff3ct::module::Module {
+protected:
+    const int i0, i1, j0, j1;
+    const int b;
+    const enum ccl_impl_e impl;
+    const int n_threads;
+    CCL_gen_data_t* data;
+    const uint8_t** in_img;
+    uint16_t** out_img;
+public:
+    CCL_engine(const int i0, const int i1, const int j0, const int j1, const int b, const enum ccl_impl_e impl,
+               const int n_threads = 1);
+    virtual ~CCL_engine();
+    virtual CCL_engine* clone() const;
+    inline uint16_t** get_out_img();
+    inline aff3ct::module::Task& operator[](const ccl_eng::tsk t);
+    inline aff3ct::module::Socket& operator[](const ccl_eng::sck::apply s);
+
+protected:
+    void init_data();
+    void deep_copy(const CCL_engine &m);
+};
+
+#include "fmdt/CCL_engine/CCL_engine.hxx"
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "fmdt/CCL_engine/CCL_engine.hpp"
+
+uint16_t** CCL_engine::get_out_img() {
+    return this->out_img;
+}
+
+aff3ct::module::Task& CCL_engine::operator[](const ccl_eng::tsk t) {
+    return aff3ct::module::Module::operator[]((size_t)t);
+}
+
+aff3ct::module::Socket& CCL_engine::operator[](const ccl_eng::sck::apply s) {
+    return aff3ct::module::Module::operator[]((size_t)ccl_eng::tsk::apply)[(size_t)s];
+}
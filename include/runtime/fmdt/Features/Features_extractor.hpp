@@ -3,6 +3,8 @@
 #include <stdint.h>
 #include <aff3ct.hpp>
 
+#include "fmdt/features.h"
+
 namespace ftr_ext {
     enum class tsk : size_t { extract, SIZE };
     namespace sck {
@@ -16,9 +18,12 @@ protected:
     const int i0, i1, j0, j1;
     const int b;
     const size_t max_ROI_size;
-    const uint32_t** in_img;
+    const int n_threads;
+    const uint16_t** in_img;
+    features_bands_t* bands; // NULL with 1 thread
 public:
-    Features_extractor(const int i0, const int i1, const int j0, const int j1, const int b, const size_t max_ROI_size);
+    Features_extractor(const int i0, const int i1, const int j0, const int j1, const int b, const size_t max_ROI_size,
+                       const int n_threads = 1);
     virtual ~Features_extractor();
     virtual Features_extractor* clone() const;
     inline aff3ct::module::Task& operator[](const ftr_ext::tsk t);
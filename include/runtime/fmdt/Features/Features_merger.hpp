@@ -19,7 +19,7 @@ protected:
     const int b;
     const int S_min, S_max;
     const size_t max_ROI_size;
-    const uint32_t** in_img1;
+    const uint16_t** in_img1;
     const uint8_t** in_img2;
     uint8_t** out_img;
 public:
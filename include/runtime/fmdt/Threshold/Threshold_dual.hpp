@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include <aff3ct.hpp>
+
+namespace thr_dual {
+    enum class tsk : size_t { apply, SIZE };
+    namespace sck {
+        enum class apply : size_t { in_img, out_img_min, out_img_max, status };
+    }
+}
+
+class Threshold_dual : public aff3ct::module::Module {
+protected:
+    const int i0, i1, j0, j1;
+    const int b;
+    const uint8_t thr_min, thr_max;
+    const uint8_t** in_img;
+    uint8_t** out_img_min;
+    uint8_t** out_img_max;
+public:
+    Threshold_dual(const int i0, const int i1, const int j0, const int j1, const int b, const uint8_t thr_min,
+                   const uint8_t thr_max);
+    virtual ~Threshold_dual();
+    virtual Threshold_dual* clone() const;
+    inline uint8_t** get_out_img_min();
+    inline uint8_t** get_out_img_max();
+    inline aff3ct::module::Task& operator[](const thr_dual::tsk t);
+    inline aff3ct::module::Socket& operator[](const thr_dual::sck::apply s);
+protected:
+    void init_data();
+    void deep_copy(const Threshold_dual &m);
+};
+
+#include "fmdt/Threshold/Threshold_dual.hxx"
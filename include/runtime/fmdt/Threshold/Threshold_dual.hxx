@@ -0,0 +1,19 @@
+#pragma once
+
+#include "fmdt/Threshold/Threshold_dual.hpp"
+
+uint8_t** Threshold_dual::get_out_img_min() {
+    return this->out_img_min;
+}
+
+uint8_t** Threshold_dual::get_out_img_max() {
+    return this->out_img_max;
+}
+
+aff3ct::module::Task& Threshold_dual::operator[](const thr_dual::tsk t) {
+    return aff3ct::module::Module::operator[]((size_t)t);
+}
+
+aff3ct::module::Socket& Threshold_dual::operator[](const thr_dual::sck::apply s) {
+    return aff3ct::module::Module::operator[]((size_t)thr_dual::tsk::apply)[(size_t)s];
+}
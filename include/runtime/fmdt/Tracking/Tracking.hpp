@@ -29,17 +29,16 @@ protected:
     const size_t fra_meteor_max;
     const size_t max_ROI_size;
     const size_t max_tracks_size;
-    const size_t max_n_frames;
     tracking_data_t* tracking_data;
     track_t* track_array;
-    BB_t** BB_array;
+    BB_log_t* BB_log;
 public:
     Tracking(const size_t r_extrapol, const float angle_max, const float diff_dev, const int track_all,
              const size_t fra_star_min, const size_t fra_meteor_min, const size_t fra_meteor_max,
-             const size_t max_ROI_size, const size_t max_tracks_size, const size_t max_n_frames);
+             const size_t max_ROI_size, const size_t max_tracks_size);
     virtual ~Tracking();
     inline track_t* get_track_array();
-    inline BB_t** get_BB_array();
+    inline BB_log_t* get_BB_log();
     inline aff3ct::module::Task& operator[](const trk::tsk t);
     inline aff3ct::module::Socket& operator[](const trk::sck::perform s) ;
 };
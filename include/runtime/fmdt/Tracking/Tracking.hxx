@@ -6,8 +6,8 @@ track_t* Tracking::get_track_array() {
     return this->track_array;
 }
 
-BB_t** Tracking::get_BB_array() {
-    return this->BB_array;
+BB_log_t* Tracking::get_BB_log() {
+    return this->BB_log;
 }
 
 aff3ct::module::Task& Tracking::operator[](const trk::tsk t) {
@@ -5,56 +5,83 @@
 #include <math.h>
 
 #include "fmdt/macros.h"
+#include "fmdt/defines.h"
 #include "fmdt/tools.h"
 #include "fmdt/features.h"
 
+// Sets the entries 'r0' to 'r1 - 1' of all the fields to 0
+static void _features_clear_ROI_array(ROI_t* ROI_array, const size_t r0, const size_t r1) {
+    if (r1 <= r0)
+        return;
+    const size_t n = r1 - r0;
+    memset(ROI_array->id + r0, 0, n * sizeof(uint16_t));
+    memset(ROI_array->frame + r0, 0, n * sizeof(uint64_t));
+    memset(ROI_array->xmin + r0, 0, n * sizeof(uint16_t));
+    memset(ROI_array->xmax + r0, 0, n * sizeof(uint16_t));
+    memset(ROI_array->ymin + r0, 0, n * sizeof(uint16_t));
+    memset(ROI_array->ymax + r0, 0, n * sizeof(uint16_t));
+    memset(ROI_array->S + r0, 0, n * sizeof(uint32_t));
+    memset(ROI_array->Sx + r0, 0, n * sizeof(uint32_t));
+    memset(ROI_array->Sy + r0, 0, n * sizeof(uint32_t));
+    memset(ROI_array->Sxx + r0, 0, n * sizeof(uint64_t));
+    memset(ROI_array->Syy + r0, 0, n * sizeof(uint64_t));
+    memset(ROI_array->Sxy + r0, 0, n * sizeof(uint64_t));
+    memset(ROI_array->x + r0, 0, n * sizeof(float));
+    memset(ROI_array->y + r0, 0, n * sizeof(float));
+    memset(ROI_array->dx + r0, 0, n * sizeof(float));
+    memset(ROI_array->dy + r0, 0, n * sizeof(float));
+    memset(ROI_array->error + r0, 0, n * sizeof(float));
+    memset(ROI_array->time + r0, 0, n * sizeof(int32_t));
+    memset(ROI_array->time_motion + r0, 0, n * sizeof(int32_t));
+    memset(ROI_array->prev_id + r0, 0, n * sizeof(int32_t));
+    memset(ROI_array->next_id + r0, 0, n * sizeof(int32_t));
+    memset(ROI_array->is_moving + r0, 0, n * sizeof(uint8_t));
+    memset(ROI_array->is_extrapolated + r0, 0, n * sizeof(uint8_t));
+}
+
+// Slices the fields in 'arena' (or only computes the size of the arena if 'arena' is NULL), 'id' is the first slice
+static size_t _features_slice_ROI_array(ROI_t* ROI_array, void* arena, const size_t max_size) {
+    size_t size = 0;
+    ROI_array->id = (uint16_t*)tools_arena_slice(arena, &size, max_size * sizeof(uint16_t));
+    ROI_array->frame = (uint64_t*)tools_arena_slice(arena, &size, max_size * sizeof(uint64_t));
+    ROI_array->xmin = (uint16_t*)tools_arena_slice(arena, &size, max_size * sizeof(uint16_t));
+    ROI_array->xmax = (uint16_t*)tools_arena_slice(arena, &size, max_size * sizeof(uint16_t));
+    ROI_array->ymin = (uint16_t*)tools_arena_slice(arena, &size, max_size * sizeof(uint16_t));
+    ROI_array->ymax = (uint16_t*)tools_arena_slice(arena, &size, max_size * sizeof(uint16_t));
+    ROI_array->S = (uint32_t*)tools_arena_slice(arena, &size, max_size * sizeof(uint32_t));
+    ROI_array->Sx = (uint32_t*)tools_arena_slice(arena, &size, max_size * sizeof(uint32_t));
+    ROI_array->Sy = (uint32_t*)tools_arena_slice(arena, &size, max_size * sizeof(uint32_t));
+    ROI_array->Sxx = (uint64_t*)tools_arena_slice(arena, &size, max_size * sizeof(uint64_t));
+    ROI_array->Syy = (uint64_t*)tools_arena_slice(arena, &size, max_size * sizeof(uint64_t));
+    ROI_array->Sxy = (uint64_t*)tools_arena_slice(arena, &size, max_size * sizeof(uint64_t));
+    ROI_array->x = (float*)tools_arena_slice(arena, &size, max_size * sizeof(float));
+    ROI_array->y = (float*)tools_arena_slice(arena, &size, max_size * sizeof(float));
+    ROI_array->dx = (float*)tools_arena_slice(arena, &size, max_size * sizeof(float));
+    ROI_array->dy = (float*)tools_arena_slice(arena, &size, max_size * sizeof(float));
+    ROI_array->error = (float*)tools_arena_slice(arena, &size, max_size * sizeof(float));
+    ROI_array->time = (int32_t*)tools_arena_slice(arena, &size, max_size * sizeof(int32_t));
+    ROI_array->time_motion = (int32_t*)tools_arena_slice(arena, &size, max_size * sizeof(int32_t));
+    ROI_array->prev_id = (int32_t*)tools_arena_slice(arena, &size, max_size * sizeof(int32_t));
+    ROI_array->next_id = (int32_t*)tools_arena_slice(arena, &size, max_size * sizeof(int32_t));
+    ROI_array->is_moving = (uint8_t*)tools_arena_slice(arena, &size, max_size * sizeof(uint8_t));
+    ROI_array->is_extrapolated = (uint8_t*)tools_arena_slice(arena, &size, max_size * sizeof(uint8_t));
+    return size;
+}
+
 ROI_t* features_alloc_ROI_array(const size_t max_size) {
     ROI_t* ROI_array = (ROI_t*)malloc(sizeof(ROI_t));
-    ROI_array->id = (uint16_t*)malloc(max_size * sizeof(uint16_t));
-    ROI_array->frame = (uint32_t*)malloc(max_size * sizeof(uint32_t));
-    ROI_array->xmin = (uint16_t*)malloc(max_size * sizeof(uint16_t));
-    ROI_array->xmax = (uint16_t*)malloc(max_size * sizeof(uint16_t));
-    ROI_array->ymin = (uint16_t*)malloc(max_size * sizeof(uint16_t));
-    ROI_array->ymax = (uint16_t*)malloc(max_size * sizeof(uint16_t));
-    ROI_array->S = (uint32_t*)malloc(max_size * sizeof(uint32_t));
-    ROI_array->Sx = (uint32_t*)malloc(max_size * sizeof(uint32_t));
-    ROI_array->Sy = (uint32_t*)malloc(max_size * sizeof(uint32_t));
-    ROI_array->x = (float*)malloc(max_size * sizeof(float));
-    ROI_array->y = (float*)malloc(max_size * sizeof(float));
-    ROI_array->dx = (float*)malloc(max_size * sizeof(float));
-    ROI_array->dy = (float*)malloc(max_size * sizeof(float));
-    ROI_array->error = (float*)malloc(max_size * sizeof(float));
-    ROI_array->time = (int32_t*)malloc(max_size * sizeof(int32_t));
-    ROI_array->time_motion = (int32_t*)malloc(max_size * sizeof(int32_t));
-    ROI_array->prev_id = (int32_t*)malloc(max_size * sizeof(int32_t));
-    ROI_array->next_id = (int32_t*)malloc(max_size * sizeof(int32_t));
-    ROI_array->is_moving = (uint8_t*)malloc(max_size * sizeof(uint8_t));
-    ROI_array->is_extrapolated = (uint8_t*)malloc(max_size * sizeof(uint8_t));
+    // all the fields are in a single aligned arena
+    void* arena = tools_arena_alloc(_features_slice_ROI_array(ROI_array, NULL, max_size));
+    _features_slice_ROI_array(ROI_array, arena, max_size);
     ROI_array->_max_size = max_size;
+    ROI_array->_size = 0;
+    _features_clear_ROI_array(ROI_array, 0, max_size);
     return ROI_array;
 }
 
+// Only the entries in use are cleared: the entries after '_size' are always 0 (see 'ROI_t')
 void features_init_ROI_array(ROI_t* ROI_array) {
-    memset(ROI_array->id, 0, ROI_array->_max_size * sizeof(uint16_t));
-    memset(ROI_array->frame, 0, ROI_array->_max_size * sizeof(uint32_t));
-    memset(ROI_array->xmin, 0, ROI_array->_max_size * sizeof(uint16_t));
-    memset(ROI_array->xmax, 0, ROI_array->_max_size * sizeof(uint16_t));
-    memset(ROI_array->ymin, 0, ROI_array->_max_size * sizeof(uint16_t));
-    memset(ROI_array->ymax, 0, ROI_array->_max_size * sizeof(uint16_t));
-    memset(ROI_array->S, 0, ROI_array->_max_size * sizeof(uint32_t));
-    memset(ROI_array->Sx, 0, ROI_array->_max_size * sizeof(uint32_t));
-    memset(ROI_array->Sy, 0, ROI_array->_max_size * sizeof(uint32_t));
-    memset(ROI_array->x, 0, ROI_array->_max_size * sizeof(float));
-    memset(ROI_array->y, 0, ROI_array->_max_size * sizeof(float));
-    memset(ROI_array->dx, 0, ROI_array->_max_size * sizeof(float));
-    memset(ROI_array->dy, 0, ROI_array->_max_size * sizeof(float));
-    memset(ROI_array->error, 0, ROI_array->_max_size * sizeof(float));
-    memset(ROI_array->time, 0, ROI_array->_max_size * sizeof(int32_t));
-    memset(ROI_array->time_motion, 0, ROI_array->_max_size * sizeof(int32_t));
-    memset(ROI_array->prev_id, 0, ROI_array->_max_size * sizeof(int32_t));
-    memset(ROI_array->next_id, 0, ROI_array->_max_size * sizeof(int32_t));
-    memset(ROI_array->is_moving, 0, ROI_array->_max_size * sizeof(uint8_t));
-    memset(ROI_array->is_extrapolated, 0, ROI_array->_max_size * sizeof(uint8_t));
+    _features_clear_ROI_array(ROI_array, 0, ROI_array->_size);
     ROI_array->_size = 0;
 }
 
@@ -69,6 +96,9 @@ void features_copy_elmt_ROI_array(const ROI_t* ROI_array_src, ROI_t* ROI_array_d
     ROI_array_dest->S[i_dest] = ROI_array_src->S[i_src];
     ROI_array_dest->Sx[i_dest] = ROI_array_src->Sx[i_src];
     ROI_array_dest->Sy[i_dest] = ROI_array_src->Sy[i_src];
+    ROI_array_dest->Sxx[i_dest] = ROI_array_src->Sxx[i_src];
+    ROI_array_dest->Syy[i_dest] = ROI_array_src->Syy[i_src];
+    ROI_array_dest->Sxy[i_dest] = ROI_array_src->Sxy[i_src];
     ROI_array_dest->x[i_dest] = ROI_array_src->x[i_src];
     ROI_array_dest->y[i_dest] = ROI_array_src->y[i_src];
     ROI_array_dest->dx[i_dest] = ROI_array_src->dx[i_src];
@@ -83,9 +113,10 @@ void features_copy_elmt_ROI_array(const ROI_t* ROI_array_src, ROI_t* ROI_array_d
 }
 
 void features_copy_ROI_array(const ROI_t* ROI_array_src, ROI_t* ROI_array_dest) {
+    _features_clear_ROI_array(ROI_array_dest, ROI_array_src->_size, ROI_array_dest->_size);
     ROI_array_dest->_size = ROI_array_src->_size;
     memcpy(ROI_array_dest->id, ROI_array_src->id, ROI_array_dest->_size * sizeof(uint16_t));
-    memcpy(ROI_array_dest->frame, ROI_array_src->frame, ROI_array_dest->_size * sizeof(uint32_t));
+    memcpy(ROI_array_dest->frame, ROI_array_src->frame, ROI_array_dest->_size * sizeof(uint64_t));
     memcpy(ROI_array_dest->xmin, ROI_array_src->xmin, ROI_array_dest->_size * sizeof(uint16_t));
     memcpy(ROI_array_dest->xmax, ROI_array_src->xmax, ROI_array_dest->_size * sizeof(uint16_t));
     memcpy(ROI_array_dest->ymin, ROI_array_src->ymin, ROI_array_dest->_size * sizeof(uint16_t));
@@ -93,6 +124,9 @@ void features_copy_ROI_array(const ROI_t* ROI_array_src, ROI_t* ROI_array_dest)
     memcpy(ROI_array_dest->S, ROI_array_src->S, ROI_array_dest->_size * sizeof(uint32_t));
     memcpy(ROI_array_dest->Sx, ROI_array_src->Sx, ROI_array_dest->_size * sizeof(uint32_t));
     memcpy(ROI_array_dest->Sy, ROI_array_src->Sy, ROI_array_dest->_size * sizeof(uint32_t));
+    memcpy(ROI_array_dest->Sxx, ROI_array_src->Sxx, ROI_array_dest->_size * sizeof(uint64_t));
+    memcpy(ROI_array_dest->Syy, ROI_array_src->Syy, ROI_array_dest->_size * sizeof(uint64_t));
+    memcpy(ROI_array_dest->Sxy, ROI_array_src->Sxy, ROI_array_dest->_size * sizeof(uint64_t));
     memcpy(ROI_array_dest->x, ROI_array_src->x, ROI_array_dest->_size * sizeof(float));
     memcpy(ROI_array_dest->y, ROI_array_src->y, ROI_array_dest->_size * sizeof(float));
     memcpy(ROI_array_dest->dx, ROI_array_src->dx, ROI_array_dest->_size * sizeof(float));
@@ -107,26 +141,7 @@ void features_copy_ROI_array(const ROI_t* ROI_array_src, ROI_t* ROI_array_dest)
 }
 
 void features_free_ROI_array(ROI_t* ROI_array) {
-    free(ROI_array->id);
-    free(ROI_array->frame);
-    free(ROI_array->xmin);
-    free(ROI_array->xmax);
-    free(ROI_array->ymin);
-    free(ROI_array->ymax);
-    free(ROI_array->S);
-    free(ROI_array->Sx);
-    free(ROI_array->Sy);
-    free(ROI_array->x);
-    free(ROI_array->y);
-    free(ROI_array->dx);
-    free(ROI_array->dy);
-    free(ROI_array->error);
-    free(ROI_array->time);
-    free(ROI_array->time_motion);
-    free(ROI_array->prev_id);
-    free(ROI_array->next_id);
-    free(ROI_array->is_moving);
-    free(ROI_array->is_extrapolated);
+    tools_arena_free(ROI_array->id); // 'id' is the beginning of the arena
     free(ROI_array);
 }
 
@@ -140,6 +155,9 @@ void features_clear_index_ROI_array(ROI_t* ROI_array, const size_t r) {
     ROI_array->S[r] = 0;
     ROI_array->Sx[r] = 0;
     ROI_array->Sy[r] = 0;
+    ROI_array->Sxx[r] = 0;
+    ROI_array->Syy[r] = 0;
+    ROI_array->Sxy[r] = 0;
     ROI_array->x[r] = 0;
     ROI_array->y[r] = 0;
     ROI_array->dx[r] = 0;
@@ -158,34 +176,179 @@ void features_init_ROI(ROI_t* stats, int n) {
         memset(stats + i, 0, sizeof(ROI_t));
 }
 
-void _features_extract(const uint32_t** img, const int i0, const int i1, const int j0, const int j1, uint16_t* ROI_id,
-                       uint16_t* ROI_xmin, uint16_t* ROI_xmax, uint16_t* ROI_ymin, uint16_t* ROI_ymax, uint32_t* ROI_S,
-                       uint32_t* ROI_Sx, uint32_t* ROI_Sy, float* ROI_x, float* ROI_y, const size_t n_ROI) {
-    memset(ROI_xmin, j1, n_ROI * sizeof(uint16_t));
-    memset(ROI_xmax, j0, n_ROI * sizeof(uint16_t));
-    memset(ROI_ymin, i1, n_ROI * sizeof(uint16_t));
-    memset(ROI_ymax, i0, n_ROI * sizeof(uint16_t));
-    memset(ROI_S, 0, n_ROI * sizeof(uint32_t));
-    memset(ROI_Sx, 0, n_ROI * sizeof(uint32_t));
-    memset(ROI_Sy, 0, n_ROI * sizeof(uint32_t));
-
-    for (int i = i0; i <= i1; i++) {
+// Accumulates the features of the rows 'r0' to 'r1' in 'ROI_*' ('ROI_S' has to be 0 for all the labels). The other
+// fields of a label are initialized when the label is met for the first time, the met labels are listed in 'ids'.
+// Returns the number of met labels.
+static size_t _features_accumulate_band(const uint16_t** img, const int r0, const int r1, const int j0, const int j1,
+                                        uint16_t* ROI_xmin, uint16_t* ROI_xmax, uint16_t* ROI_ymin,
+                                        uint16_t* ROI_ymax, uint32_t* ROI_S, uint32_t* ROI_Sx, uint32_t* ROI_Sy,
+                                        uint64_t* ROI_Sxx, uint64_t* ROI_Syy, uint64_t* ROI_Sxy, uint32_t* ids) {
+    size_t n_ids = 0;
+    for (int i = r0; i <= r1; i++) {
         for (int j = j0; j <= j1; j++) {
             uint32_t e = (uint32_t)img[i][j];
             if (e > 0) {
                 uint32_t r = e - 1;
+                if (!ROI_S[r]) {
+                    ids[n_ids++] = r;
+                    ROI_Sx[r] = 0;
+                    ROI_Sy[r] = 0;
+                    if (ROI_Sxx) {
+                        ROI_Sxx[r] = 0;
+                        ROI_Syy[r] = 0;
+                        ROI_Sxy[r] = 0;
+                    }
+                    ROI_xmin[r] = j;
+                    ROI_xmax[r] = j;
+                    ROI_ymin[r] = i;
+                    ROI_ymax[r] = i;
+                }
                 ROI_S[r] += 1;
-                ROI_id[r] = e;
                 ROI_Sx[r] += j;
                 ROI_Sy[r] += i;
+                if (ROI_Sxx) {
+                    ROI_Sxx[r] += (uint64_t)j * j;
+                    ROI_Syy[r] += (uint64_t)i * i;
+                    ROI_Sxy[r] += (uint64_t)i * j;
+                }
                 if (j < ROI_xmin[r])
                     ROI_xmin[r] = j;
                 if (j > ROI_xmax[r])
                     ROI_xmax[r] = j;
-                if (i < ROI_ymin[r])
-                    ROI_ymin[r] = i;
-                if (i > ROI_ymax[r])
-                    ROI_ymax[r] = i;
+                ROI_ymax[r] = i; // the rows are scanned in increasing order
+            }
+        }
+    }
+    return n_ids;
+}
+
+// Slices the arrays of the bands in 'arena' (or only computes the size of the arena if 'arena' is NULL), the 'xmin'
+// array of the first band is the first slice
+static size_t _features_slice_bands(features_band_t* bands, void* arena, const int n_bands, const size_t max_size) {
+    size_t size = 0;
+    for (int b = 0; b < n_bands; b++) {
+        features_band_t* band = &bands[b];
+        band->xmin = (uint16_t*)tools_arena_slice(arena, &size, max_size * sizeof(uint16_t));
+        band->xmax = (uint16_t*)tools_arena_slice(arena, &size, max_size * sizeof(uint16_t));
+        band->ymin = (uint16_t*)tools_arena_slice(arena, &size, max_size * sizeof(uint16_t));
+        band->ymax = (uint16_t*)tools_arena_slice(arena, &size, max_size * sizeof(uint16_t));
+        band->S = (uint32_t*)tools_arena_slice(arena, &size, max_size * sizeof(uint32_t));
+        band->Sx = (uint32_t*)tools_arena_slice(arena, &size, max_size * sizeof(uint32_t));
+        band->Sy = (uint32_t*)tools_arena_slice(arena, &size, max_size * sizeof(uint32_t));
+        band->Sxx = (uint64_t*)tools_arena_slice(arena, &size, max_size * sizeof(uint64_t));
+        band->Syy = (uint64_t*)tools_arena_slice(arena, &size, max_size * sizeof(uint64_t));
+        band->Sxy = (uint64_t*)tools_arena_slice(arena, &size, max_size * sizeof(uint64_t));
+        band->ids = (uint32_t*)tools_arena_slice(arena, &size, max_size * sizeof(uint32_t));
+        band->n_ids = 0;
+    }
+    return size;
+}
+
+features_bands_t* features_alloc_bands(const int n_threads, const size_t max_size) {
+    features_bands_t* bands = (features_bands_t*)malloc(sizeof(features_bands_t));
+#ifdef _OPENMP
+    bands->n_bands = MAX(1, n_threads);
+#else
+    (void)n_threads;
+    bands->n_bands = 1;
+#endif
+    bands->_max_size = max_size;
+    bands->bands = (features_band_t*)malloc(bands->n_bands * sizeof(features_band_t));
+    void* arena = tools_arena_alloc(_features_slice_bands(bands->bands, NULL, bands->n_bands, max_size));
+    _features_slice_bands(bands->bands, arena, bands->n_bands, max_size);
+    for (int b = 0; b < bands->n_bands; b++)
+        memset(bands->bands[b].S, 0, max_size * sizeof(uint32_t));
+    return bands;
+}
+
+void features_free_bands(features_bands_t* bands) {
+    tools_arena_free(bands->bands[0].xmin); // 'xmin' of the first band is the beginning of the arena
+    free(bands->bands);
+    free(bands);
+}
+
+void _features_extract(const uint16_t** img, const int i0, const int i1, const int j0, const int j1, uint16_t* ROI_id,
+                       uint16_t* ROI_xmin, uint16_t* ROI_xmax, uint16_t* ROI_ymin, uint16_t* ROI_ymax, uint32_t* ROI_S,
+                       uint32_t* ROI_Sx, uint32_t* ROI_Sy, uint64_t* ROI_Sxx, uint64_t* ROI_Syy, uint64_t* ROI_Sxy,
+                       float* ROI_x, float* ROI_y, const size_t n_ROI, features_bands_t* bands) {
+    // 'memset' can't be used here: the bounds are on 16 bits
+    for (size_t r = 0; r < n_ROI; r++) {
+        ROI_xmin[r] = j1;
+        ROI_xmax[r] = j0;
+        ROI_ymin[r] = i1;
+        ROI_ymax[r] = i0;
+    }
+    memset(ROI_S, 0, n_ROI * sizeof(uint32_t));
+    memset(ROI_Sx, 0, n_ROI * sizeof(uint32_t));
+    memset(ROI_Sy, 0, n_ROI * sizeof(uint32_t));
+    if (ROI_Sxx) {
+        memset(ROI_Sxx, 0, n_ROI * sizeof(uint64_t));
+        memset(ROI_Syy, 0, n_ROI * sizeof(uint64_t));
+        memset(ROI_Sxy, 0, n_ROI * sizeof(uint64_t));
+    }
+
+    const int n_bands = bands ? MIN(bands->n_bands, (i1 - i0) + 1) : 1;
+
+    if (n_bands == 1 || n_ROI == 0) {
+        for (int i = i0; i <= i1; i++) {
+            for (int j = j0; j <= j1; j++) {
+                uint32_t e = (uint32_t)img[i][j];
+                if (e > 0) {
+                    uint32_t r = e - 1;
+                    ROI_S[r] += 1;
+                    ROI_id[r] = e;
+                    ROI_Sx[r] += j;
+                    ROI_Sy[r] += i;
+                    if (ROI_Sxx) {
+                        ROI_Sxx[r] += (uint64_t)j * j;
+                        ROI_Syy[r] += (uint64_t)i * i;
+                        ROI_Sxy[r] += (uint64_t)i * j;
+                    }
+                    if (j < ROI_xmin[r])
+                        ROI_xmin[r] = j;
+                    if (j > ROI_xmax[r])
+                        ROI_xmax[r] = j;
+                    if (i < ROI_ymin[r])
+                        ROI_ymin[r] = i;
+                    if (i > ROI_ymax[r])
+                        ROI_ymax[r] = i;
+                }
+            }
+        }
+    } else {
+        // each thread accumulates a horizontal band in its own arrays, then only the labels met in each band are
+        // reduced (the result is the same as the sequential version)
+        assert(n_ROI <= bands->_max_size);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(n_bands) schedule(static, 1)
+#endif
+        for (int b = 0; b < n_bands; b++) {
+            const int r0 = i0 + (b * ((i1 - i0) + 1)) / n_bands;
+            const int r1 = i0 + ((b + 1) * ((i1 - i0) + 1)) / n_bands - 1;
+            features_band_t* band = &bands->bands[b];
+            band->n_ids = _features_accumulate_band(img, r0, r1, j0, j1, band->xmin, band->xmax, band->ymin,
+                                                    band->ymax, band->S, band->Sx, band->Sy,
+                                                    ROI_Sxx ? band->Sxx : NULL, band->Syy, band->Sxy, band->ids);
+        }
+
+        for (int b = 0; b < n_bands; b++) {
+            features_band_t* band = &bands->bands[b];
+            for (size_t k = 0; k < band->n_ids; k++) {
+                const uint32_t r = band->ids[k];
+                ROI_id[r] = r + 1;
+                ROI_S[r] += band->S[r];
+                band->S[r] = 0; // 'S' is back to 0 for the next call (see '_features_accumulate_band')
+                ROI_Sx[r] += band->Sx[r];
+                ROI_Sy[r] += band->Sy[r];
+                if (ROI_Sxx) {
+                    ROI_Sxx[r] += band->Sxx[r];
+                    ROI_Syy[r] += band->Syy[r];
+                    ROI_Sxy[r] += band->Sxy[r];
+                }
+                ROI_xmin[r] = MIN(ROI_xmin[r], band->xmin[r]);
+                ROI_xmax[r] = MAX(ROI_xmax[r], band->xmax[r]);
+                ROI_ymin[r] = MIN(ROI_ymin[r], band->ymin[r]);
+                ROI_ymax[r] = MAX(ROI_ymax[r], band->ymax[r]);
             }
         }
     }
@@ -196,70 +359,127 @@ void _features_extract(const uint32_t** img, const int i0, const int i1, const i
     }
 }
 
-void features_extract(const uint32_t** img, const int i0, const int i1, const int j0, const int j1, const size_t n_ROI,
-                      ROI_t* ROI_array) {
+void features_extract(const uint16_t** img, const int i0, const int i1, const int j0, const int j1, const size_t n_ROI,
+                      ROI_t* ROI_array, features_bands_t* bands) {
     features_init_ROI_array(ROI_array);
     ROI_array->_size = n_ROI;
     _features_extract(img, i0, i1, j0, j1, ROI_array->id, ROI_array->xmin, ROI_array->xmax, ROI_array->ymin,
-                      ROI_array->ymax, ROI_array->S, ROI_array->Sx, ROI_array->Sy, ROI_array->x, ROI_array->y,
-                      ROI_array->_size);
+                      ROI_array->ymax, ROI_array->S, ROI_array->Sx, ROI_array->Sy, ROI_array->Sxx, ROI_array->Syy,
+                      ROI_array->Sxy, ROI_array->x, ROI_array->y, ROI_array->_size, bands);
 }
 
-void _features_merge_HI_CCL_v2(const uint32_t** M, const uint8_t** HI_in, uint8_t** HI_out, const int i0, const int i1,
-                               const int j0, const int j1, const uint16_t* ROI_id, const uint16_t* ROI_xmin,
-                               const uint16_t* ROI_xmax, const uint16_t* ROI_ymin, const uint16_t* ROI_ymax,
-                               uint32_t* ROI_S, const size_t n_ROI, const uint32_t S_min, const uint32_t S_max) {
-    if ((void*)HI_in != (void*)HI_out)
-        for (int i = i0; i <= i1; i++)
-            memcpy(HI_out[i] + j0, HI_in[i] + j0, sizeof(uint8_t) * ((j1 - j0) + 1));
-
-    int x0, x1, y0, y1, id;
+// Surface filtering: the LUT contains the "has a high pixel" flags of the labels and is converted to the output value of
+// the pixels of each label (0 = removed)
+static void _features_merge_LUT(uint8_t* LUT, const uint16_t* ROI_id, uint32_t* ROI_S, const size_t n_ROI,
+                                const uint32_t S_min, const uint32_t S_max) {
     for (size_t i = 0; i < n_ROI; i++) {
-        if (ROI_S[i]) {
-            id = ROI_id[i];
-            x0 = ROI_ymin[i];
-            x1 = ROI_ymax[i];
-            y0 = ROI_xmin[i];
-            y1 = ROI_xmax[i];
-            if (S_min > ROI_S[i] || ROI_S[i] > S_max) {
-                ROI_S[i] = 0;
-                // JUSTE POUR DEBUG (Affichage frames)
-                for (int k = x0; k <= x1; k++) {
-                    for (int l = y0; l <= y1; l++) {
-                        if ((uint32_t)M[k][l] == (uint32_t)id)
-                            HI_out[k][l] = (uint8_t)0;
-                    }
-                }
-                continue;
-            }
-            for (int k = x0; k <= x1; k++) {
-                for (int l = y0; l <= y1; l++) {
-                    if (HI_out[k][l]) {
-                        for (k = x0; k <= x1; k++) {
-                            for (l = y0; l <= y1; l++) {
-                                if ((uint32_t)M[k][l] == (uint32_t)id) {
-                                    HI_out[k][l] = (uint8_t)MAX(MIN(i + 1, 255), 80);
-                                }
-                            }
-                        }
-                        goto next;
-                    }
-                }
-            }
+        const uint16_t id = ROI_id[i];
+        if (!ROI_S[i]) { // already removed (see 'features_filter_hot_pixels')
+            LUT[id] = 0;
+            continue;
+        }
+        if (S_min <= ROI_S[i] && ROI_S[i] <= S_max && LUT[id]) {
+            LUT[id] = (uint8_t)MAX(MIN(i + 1, 255), 80);
+        } else {
             ROI_S[i] = 0;
-        next:;
+            LUT[id] = 0;
+        }
+    }
+}
+
+// Copies the line 'i' of the high threshold image in 'HI_out' when the line 'i' of the labels is empty (the line is
+// set to 0 without reading 'HI_in' if it is also empty), returns 1 in this case
+static int _features_merge_empty_line(const uint8_t* M_rows, const uint8_t* HI_rows, const uint8_t* line_HI_in,
+                                      const uint64_t* line_HI_in_packed, uint8_t* line_HI_out, const int i,
+                                      const int j0, const int j1) {
+    if (!M_rows || M_rows[i])
+        return 0;
+    if (HI_rows && !HI_rows[i])
+        memset(line_HI_out + j0, 0, ((j1 - j0) + 1) * sizeof(uint8_t));
+    else if (line_HI_in)
+        memcpy(line_HI_out + j0, line_HI_in + j0, ((j1 - j0) + 1) * sizeof(uint8_t));
+    else
+        for (int j = j0; j <= j1; j++)
+            line_HI_out[j] = (uint8_t)(((line_HI_in_packed[(j - j0) / 64] >> ((j - j0) % 64)) & 1) * 255);
+    return 1;
+}
+
+void _features_merge_HI_CCL_v2(const uint16_t** M, const uint8_t** HI_in, uint8_t** HI_out, const uint8_t* M_rows,
+                               const uint8_t* HI_rows, const int i0, const int i1, const int j0, const int j1,
+                               const uint16_t* ROI_id, uint32_t* ROI_S, const size_t n_ROI, const uint32_t S_min,
+                               const uint32_t S_max) {
+    assert(n_ROI <= MAX_ROI_SIZE);
+    // per label: first a "has a high pixel" flag, then the output value of the label pixels (0 = removed)
+    uint8_t LUT[MAX_ROI_SIZE + 1];
+    memset(LUT, 0, (n_ROI + 1) * sizeof(uint8_t));
+
+    // hysteresis: flags the labels that contain at least one pixel of the high threshold image
+    for (int i = i0; i <= i1; i++) {
+        if ((M_rows && !M_rows[i]) || (HI_rows && !HI_rows[i]))
+            continue;
+        for (int j = j0; j <= j1; j++)
+            LUT[M[i][j]] |= HI_in[i][j] != 0;
+    }
+
+    _features_merge_LUT(LUT, ROI_id, ROI_S, n_ROI, S_min, S_max);
+
+    // the pixels outside of the CCs are copied from the high threshold image
+    for (int i = i0; i <= i1; i++) {
+        if (_features_merge_empty_line(M_rows, HI_rows, HI_in[i], NULL, HI_out[i], i, j0, j1))
+            continue;
+        for (int j = j0; j <= j1; j++) {
+            const uint32_t e = M[i][j];
+            HI_out[i][j] = e ? LUT[e] : HI_in[i][j];
         }
     }
 }
 
-void features_merge_HI_CCL_v2(const uint32_t** M, const uint8_t** HI_in, uint8_t** HI_out, const int i0, const int i1,
-                              const int j0, const int j1, ROI_t* ROI_array, const uint32_t S_min, const uint32_t S_max)
-{
-    _features_merge_HI_CCL_v2(M, HI_in, HI_out, i0,i1, j0, j1, ROI_array->id, ROI_array->xmin, ROI_array->xmax,
-                              ROI_array->ymin, ROI_array->ymax, ROI_array->S,  ROI_array->_size, S_min, S_max);
+void _features_merge_HI_CCL_packed(const uint16_t** M, const uint64_t** HI_in, uint8_t** HI_out,
+                                   const uint8_t* M_rows, const uint8_t* HI_rows, const int i0, const int i1,
+                                   const int j0, const int j1, const uint16_t* ROI_id, uint32_t* ROI_S,
+                                   const size_t n_ROI, const uint32_t S_min, const uint32_t S_max) {
+    assert(n_ROI <= MAX_ROI_SIZE);
+    uint8_t LUT[MAX_ROI_SIZE + 1];
+    memset(LUT, 0, (n_ROI + 1) * sizeof(uint8_t));
+
+    // hysteresis: only the high pixels are visited (word by word, the empty words are skipped)
+    const size_t n_words = PACKED_N_WORDS(j0, j1);
+    for (int i = i0; i <= i1; i++) {
+        if ((M_rows && !M_rows[i]) || (HI_rows && !HI_rows[i]))
+            continue;
+        for (size_t w = 0; w < n_words; w++)
+            for (uint64_t word = HI_in[i][w]; word; word &= word - 1)
+                LUT[M[i][j0 + 64 * w + CTZ64(word)]] = 1;
+    }
+
+    _features_merge_LUT(LUT, ROI_id, ROI_S, n_ROI, S_min, S_max);
+
+    for (int i = i0; i <= i1; i++) {
+        if (_features_merge_empty_line(M_rows, HI_rows, NULL, HI_in[i], HI_out[i], i, j0, j1))
+            continue;
+        for (int j = j0; j <= j1; j++) {
+            const uint32_t e = M[i][j];
+            HI_out[i][j] = e ? LUT[e] : (uint8_t)(((HI_in[i][(j - j0) / 64] >> ((j - j0) % 64)) & 1) * 255);
+        }
+    }
+}
+
+void features_merge_HI_CCL_v2(const uint16_t** M, const uint8_t** HI_in, uint8_t** HI_out, const uint8_t* M_rows,
+                              const uint8_t* HI_rows, const int i0, const int i1, const int j0, const int j1,
+                              ROI_t* ROI_array, const uint32_t S_min, const uint32_t S_max) {
+    _features_merge_HI_CCL_v2(M, HI_in, HI_out, M_rows, HI_rows, i0, i1, j0, j1, ROI_array->id, ROI_array->S,
+                              ROI_array->_size, S_min, S_max);
 }
 
-void features_filter_surface(ROI_t* ROI_array, uint32_t** img, uint32_t threshold_min, uint32_t threshold_max) {
+void features_merge_HI_CCL_packed(const uint16_t** M, const uint64_t** HI_in, uint8_t** HI_out,
+                                  const uint8_t* M_rows, const uint8_t* HI_rows, const int i0, const int i1,
+                                  const int j0, const int j1, ROI_t* ROI_array, const uint32_t S_min,
+                                  const uint32_t S_max) {
+    _features_merge_HI_CCL_packed(M, HI_in, HI_out, M_rows, HI_rows, i0, i1, j0, j1, ROI_array->id, ROI_array->S,
+                                  ROI_array->_size, S_min, S_max);
+}
+
+void features_filter_surface(ROI_t* ROI_array, uint16_t** img, uint32_t threshold_min, uint32_t threshold_max) {
     // Doit on vraiment modifier l'image de départ? ou juste les stats.
     uint32_t S, e;
     int i0, i1, j0, j1;
@@ -295,11 +515,13 @@ void features_filter_surface(ROI_t* ROI_array, uint32_t** img, uint32_t threshol
 size_t _features_shrink_ROI_array(const uint16_t* ROI_src_id, const uint16_t* ROI_src_xmin,
                                   const uint16_t* ROI_src_xmax, const uint16_t* ROI_src_ymin,
                                   const uint16_t* ROI_src_ymax, const uint32_t* ROI_src_S, const uint32_t* ROI_src_Sx,
-                                  const uint32_t* ROI_src_Sy, const float* ROI_src_x, const float* ROI_src_y,
-                                  const size_t n_ROI_src, uint16_t* ROI_dest_id, uint16_t* ROI_dest_xmin,
-                                  uint16_t* ROI_dest_xmax, uint16_t* ROI_dest_ymin, uint16_t* ROI_dest_ymax,
-                                  uint32_t* ROI_dest_S, uint32_t* ROI_dest_Sx, uint32_t* ROI_dest_Sy, float* ROI_dest_x,
-                                  float* ROI_dest_y) {
+                                  const uint32_t* ROI_src_Sy, const uint64_t* ROI_src_Sxx,
+                                  const uint64_t* ROI_src_Syy, const uint64_t* ROI_src_Sxy, const float* ROI_src_x,
+                                  const float* ROI_src_y, const size_t n_ROI_src, uint16_t* ROI_dest_id,
+                                  uint16_t* ROI_dest_xmin, uint16_t* ROI_dest_xmax, uint16_t* ROI_dest_ymin,
+                                  uint16_t* ROI_dest_ymax, uint32_t* ROI_dest_S, uint32_t* ROI_dest_Sx,
+                                  uint32_t* ROI_dest_Sy, uint64_t* ROI_dest_Sxx, uint64_t* ROI_dest_Syy,
+                                  uint64_t* ROI_dest_Sxy, float* ROI_dest_x, float* ROI_dest_y) {
     size_t cpt = 0;
     for (size_t i = 0; i < n_ROI_src; i++) {
         if (ROI_src_S[i] > 0) {
@@ -311,6 +533,11 @@ size_t _features_shrink_ROI_array(const uint16_t* ROI_src_id, const uint16_t* RO
             ROI_dest_S[cpt] = ROI_src_S[i];
             ROI_dest_Sx[cpt] = ROI_src_Sx[i];
             ROI_dest_Sy[cpt] = ROI_src_Sy[i];
+            if (ROI_src_Sxx && ROI_dest_Sxx) {
+                ROI_dest_Sxx[cpt] = ROI_src_Sxx[i];
+                ROI_dest_Syy[cpt] = ROI_src_Syy[i];
+                ROI_dest_Sxy[cpt] = ROI_src_Sxy[i];
+            }
             ROI_dest_x[cpt] = ROI_src_x[i];
             ROI_dest_y[cpt] = ROI_src_y[i];
             cpt++;
@@ -320,152 +547,180 @@ size_t _features_shrink_ROI_array(const uint16_t* ROI_src_id, const uint16_t* RO
 }
 
 void features_shrink_ROI_array(const ROI_t* ROI_array_src, ROI_t* ROI_array_dest) {
+    features_init_ROI_array(ROI_array_dest); // the fields that are not copied are set to 0
     ROI_array_dest->_size = _features_shrink_ROI_array(ROI_array_src->id, ROI_array_src->xmin, ROI_array_src->xmax,
                                                        ROI_array_src->ymin, ROI_array_src->ymax, ROI_array_src->S,
-                                                       ROI_array_src->Sx, ROI_array_src->Sy, ROI_array_src->x,
+                                                       ROI_array_src->Sx, ROI_array_src->Sy, ROI_array_src->Sxx,
+                                                       ROI_array_src->Syy, ROI_array_src->Sxy, ROI_array_src->x,
                                                        ROI_array_src->y, ROI_array_src->_size, ROI_array_dest->id,
                                                        ROI_array_dest->xmin, ROI_array_dest->xmax, ROI_array_dest->ymin,
                                                        ROI_array_dest->ymax, ROI_array_dest->S, ROI_array_dest->Sx,
-                                                       ROI_array_dest->Sy, ROI_array_dest->x,
-                                                       ROI_array_dest->y);
+                                                       ROI_array_dest->Sy, ROI_array_dest->Sxx, ROI_array_dest->Syy,
+                                                       ROI_array_dest->Sxy, ROI_array_dest->x, ROI_array_dest->y);
 }
 
-void _features_rigid_registration(const int32_t* ROI0_next_id, const float* ROI0_x, const float* ROI0_y,
-                                  const size_t n_ROI0, const float* ROI1_x, const float* ROI1_y, double* theta,
-                                  double* tx, double* ty) {
-    double Sx, Sxp, Sy, Syp, Sx_xp, Sxp_y, Sx_yp, Sy_yp;
-    double x0, y0, x1, y1;
-    double a, b;
-    double xg, yg, xpg, ypg;
-    int asso;
-    int cpt;
+void _features_compute_shape(const uint32_t S, const uint32_t Sx, const uint32_t Sy, const uint64_t Sxx,
+                             const uint64_t Syy, const uint64_t Sxy, float* a, float* b, float* theta) {
+    if (!S) {
+        *a = *b = *theta = 0.f;
+        return;
+    }
+    // central moments (covariance matrix of the pixel coordinates)
+    const double x = (double)Sx / (double)S;
+    const double y = (double)Sy / (double)S;
+    const double mxx = (double)Sxx / (double)S - x * x;
+    const double myy = (double)Syy / (double)S - y * y;
+    const double mxy = (double)Sxy / (double)S - x * y;
+    // eigenvalues of the covariance matrix
+    const double half_trace = (mxx + myy) / 2.;
+    const double delta = sqrt(((mxx - myy) / 2.) * ((mxx - myy) / 2.) + mxy * mxy);
+    *a = (float)(2. * sqrt(MAX(half_trace + delta, 0.)));
+    *b = (float)(2. * sqrt(MAX(half_trace - delta, 0.)));
+    *theta = (float)(0.5 * atan2(2. * mxy, mxx - myy));
+}
 
-    Sx = 0;
-    Sxp = 0;
-    Sy = 0;
-    Syp = 0;
-    Sx_xp = 0;
-    Sxp_y = 0;
-    Sx_yp = 0;
-    Sy_yp = 0;
-    cpt = 0;
+void features_compute_shape(const ROI_t* ROI_array, const size_t r, float* a, float* b, float* theta) {
+    _features_compute_shape(ROI_array->S[r], ROI_array->Sx[r], ROI_array->Sy[r], ROI_array->Sxx[r], ROI_array->Syy[r],
+                            ROI_array->Sxy[r], a, b, theta);
+}
 
-    // parcours tab assos
-    for (size_t i = 0; i < n_ROI0; i++) {
-        asso = ROI0_next_id[i];
-        if (asso) {
-            cpt++;
-            Sx += ROI0_x[i];
-            Sy += ROI0_y[i];
-            Sxp += ROI1_x[asso - 1];
-            Syp += ROI1_y[asso - 1];
-        }
+void features_filter_hot_pixels(ROI_t* ROI_array, const float a_min) {
+    for (size_t r = 0; r < ROI_array->_size; r++) {
+        if (!ROI_array->S[r])
+            continue;
+        float a, b, theta;
+        features_compute_shape(ROI_array, r, &a, &b, &theta);
+        if (a < a_min)
+            ROI_array->S[r] = 0;
     }
+}
 
-    xg = Sx / cpt;
-    yg = Sy / cpt;
-    xpg = Sxp / cpt;
-    ypg = Syp / cpt;
+// TODO: Pour l'optimisation : faire une version errorMoy_corrected()
+double _features_compute_mean_error(const int32_t* ROI_next_id, const float* ROI_error, const uint8_t* ROI_is_moving,
+                                    const size_t n_ROI) {
+    double S = 0.0;
+    int cpt = 0;
+    for (size_t i = 0; i < n_ROI; i++) {
+        if (ROI_is_moving[i] || !ROI_next_id[i])
+            continue;
+        S += ROI_error[i];
+        cpt++;
+    }
+    return S / cpt;
+}
 
-    Sx = 0;
-    Sxp = 0;
-    Sy = 0;
-    Syp = 0;
+double features_compute_mean_error(const ROI_t* ROI_array) {
+    return _features_compute_mean_error(ROI_array->next_id, ROI_array->error, ROI_array->is_moving, ROI_array->_size);
+}
 
-    // parcours tab assos
+// TODO: Pour l'optimisation : faire une version ecartType_corrected()
+double _features_compute_std_deviation(const int32_t* ROI_next_id, const float* ROI_error, const uint8_t* ROI_is_moving,
+                                       const size_t n_ROI, const double mean_error) {
+    double S = 0.0;
+    int cpt = 0;
+    for (size_t i = 0; i < n_ROI; i++) {
+        if (ROI_is_moving[i] || !ROI_next_id[i])
+            continue;
+        float e = ROI_error[i];
+        S += ((e - mean_error) * (e - mean_error));
+        cpt++;
+    }
+    return sqrt(S / cpt);
+}
+
+double features_compute_std_deviation(const ROI_t* ROI_array, const double mean_error) {
+    return _features_compute_std_deviation(ROI_array->next_id, ROI_array->error, ROI_array->is_moving, ROI_array->_size,
+                                           mean_error);
+}
+
+// Associated pairs of 'ROI0' and 'ROI1' in structure of arrays (in the order of 'ROI0')
+typedef struct {
+    float* x0;
+    float* y0;
+    float* x1;
+    float* y1;
+    uint32_t* S; // surface of the CC in 'ROI0' (NULL if not gathered)
+    uint32_t* idx; // index of the pair in 'ROI0'
+    uint8_t* keep; // the pair is used by the rigid registration
+    size_t n;
+} features_pairs_t;
+
+// Gathers the associated pairs in 'pairs' (all kept), 'ROI0_S' can be NULL
+static void _features_pairs_gather(features_pairs_t* pairs, const int32_t* ROI0_next_id, const uint32_t* ROI0_S,
+                                   const float* ROI0_x, const float* ROI0_y, const size_t n_ROI0, const float* ROI1_x,
+                                   const float* ROI1_y) {
+    pairs->x0 = (float*)malloc(n_ROI0 * sizeof(float));
+    pairs->y0 = (float*)malloc(n_ROI0 * sizeof(float));
+    pairs->x1 = (float*)malloc(n_ROI0 * sizeof(float));
+    pairs->y1 = (float*)malloc(n_ROI0 * sizeof(float));
+    pairs->S = ROI0_S ? (uint32_t*)malloc(n_ROI0 * sizeof(uint32_t)) : NULL;
+    pairs->idx = (uint32_t*)malloc(n_ROI0 * sizeof(uint32_t));
+    pairs->keep = (uint8_t*)malloc(n_ROI0 * sizeof(uint8_t));
+    pairs->n = 0;
     for (size_t i = 0; i < n_ROI0; i++) {
-        asso = ROI0_next_id[i];
+        const int32_t asso = ROI0_next_id[i];
         if (asso) {
-            // cpt++;
-            x0 = ROI0_x[i] - xg;
-            y0 = ROI0_y[i] - yg;
-            x1 = ROI1_x[asso - 1] - xpg;
-            y1 = ROI1_y[asso - 1] - ypg;
-
-            Sx += x0;
-            Sy += y0;
-            Sxp += x1;
-            Syp += y1;
-            Sx_xp += x0 * x1;
-            Sxp_y += x1 * y0;
-            Sx_yp += x0 * y1;
-            Sy_yp += y0 * y1;
+            pairs->x0[pairs->n] = ROI0_x[i];
+            pairs->y0[pairs->n] = ROI0_y[i];
+            pairs->x1[pairs->n] = ROI1_x[asso - 1];
+            pairs->y1[pairs->n] = ROI1_y[asso - 1];
+            if (ROI0_S)
+                pairs->S[pairs->n] = ROI0_S[i];
+            pairs->idx[pairs->n] = (uint32_t)i;
+            pairs->keep[pairs->n] = 1;
+            pairs->n++;
         }
     }
-    a = cpt * cpt * (Sx_yp - Sxp_y) + (1 - 2 * cpt) * (Sx * Syp - Sxp * Sy);
-    b = cpt * cpt * (Sx_xp + Sy_yp) + (1 - 2 * cpt) * (Sx * Sxp + Syp * Sy);
-
-    *theta = atan2(a, b);
-    *tx = xpg - cos(*theta) * xg + sin(*theta) * yg;
-    *ty = ypg - sin(*theta) * xg - cos(*theta) * yg;
 }
 
-void features_rigid_registration(const ROI_t* ROI_array0, const ROI_t* ROI_array1, double* theta, double* tx,
-                                 double* ty) {
-    _features_rigid_registration(ROI_array0->next_id, ROI_array0->x, ROI_array0->y, ROI_array0->_size, ROI_array1->x,
-                                 ROI_array1->y, theta, tx, ty);
+static void _features_pairs_free(features_pairs_t* pairs) {
+    free(pairs->x0);
+    free(pairs->y0);
+    free(pairs->x1);
+    free(pairs->y1);
+    free(pairs->S);
+    free(pairs->idx);
+    free(pairs->keep);
 }
 
-void _features_rigid_registration_corrected(const int32_t* ROI0_next_id, const float* ROI0_x, const float* ROI0_y,
-                                            const float* ROI0_error, uint8_t* ROI0_is_moving, const size_t n_ROI0,
-                                            const float* ROI1_x, const float* ROI1_y, double* theta, double* tx,
-                                            double* ty, double mean_error, double std_deviation) {
-    double Sx, Sxp, Sy, Syp, Sx_xp, Sxp_y, Sx_yp, Sy_yp;
-    double x0, y0, x1, y1;
-    double a, b;
-    double xg, yg, xpg, ypg;
-    int asso;
-    int cpt;
+// Rigid registration (rotation + translation) of the kept pairs, the motion is the identity without kept pairs
+static void _features_pairs_registration(const features_pairs_t* pairs, double* theta, double* tx, double* ty) {
+    double Sx = 0, Sxp = 0, Sy = 0, Syp = 0, Sx_xp = 0, Sxp_y = 0, Sx_yp = 0, Sy_yp = 0;
+    int cpt = 0;
 
-    Sx = 0;
-    Sxp = 0;
-    Sy = 0;
-    Syp = 0;
-    Sx_xp = 0;
-    Sxp_y = 0;
-    Sx_yp = 0;
-    Sy_yp = 0;
-    cpt = 0;
-
-    int cpt1 = 0;
-    // parcours tab assos
-    for (size_t i = 0; i < n_ROI0; i++) {
-        if (fabs(ROI0_error[i] - mean_error) > std_deviation) {
-            ROI0_is_moving[i] = 1;
-            cpt1++;
-            continue;
-        }
-        asso = ROI0_next_id[i];
-        if (asso) {
-            Sx += ROI0_x[i];
-            Sy += ROI0_y[i];
-            Sxp += ROI1_x[asso - 1];
-            Syp += ROI1_y[asso - 1];
+    for (size_t k = 0; k < pairs->n; k++) {
+        if (pairs->keep[k]) {
+            Sx += pairs->x0[k];
+            Sy += pairs->y0[k];
+            Sxp += pairs->x1[k];
+            Syp += pairs->y1[k];
             cpt++;
         }
     }
 
-    xg = Sx / cpt;
-    yg = Sy / cpt;
-    xpg = Sxp / cpt;
-    ypg = Syp / cpt;
+    if (!cpt) {
+        *theta = 0.;
+        *tx = 0.;
+        *ty = 0.;
+        return;
+    }
+
+    const double xg = Sx / cpt;
+    const double yg = Sy / cpt;
+    const double xpg = Sxp / cpt;
+    const double ypg = Syp / cpt;
 
     Sx = 0;
     Sxp = 0;
     Sy = 0;
     Syp = 0;
 
-    // parcours tab assos
-    for (size_t i = 0; i < n_ROI0; i++) {
-        if (fabs(ROI0_error[i] - mean_error) > std_deviation)
-            continue;
-        asso = ROI0_next_id[i];
-        if (asso) {
-            // cpt++;
-            x0 = ROI0_x[i] - xg;
-            y0 = ROI0_y[i] - yg;
-            x1 = ROI1_x[asso - 1] - xpg;
-            y1 = ROI1_y[asso - 1] - ypg;
+    for (size_t k = 0; k < pairs->n; k++) {
+        if (pairs->keep[k]) {
+            const double x0 = pairs->x0[k] - xg;
+            const double y0 = pairs->y0[k] - yg;
+            const double x1 = pairs->x1[k] - xpg;
+            const double y1 = pairs->y1[k] - ypg;
 
             Sx += x0;
             Sy += y0;
@@ -477,113 +732,288 @@ void _features_rigid_registration_corrected(const int32_t* ROI0_next_id, const f
             Sy_yp += y0 * y1;
         }
     }
-    a = cpt * cpt * (Sx_yp - Sxp_y) + (1 - 2 * cpt) * (Sx * Syp - Sxp * Sy);
-    b = cpt * cpt * (Sx_xp + Sy_yp) + (1 - 2 * cpt) * (Sx * Sxp + Syp * Sy);
+    const double a = cpt * cpt * (Sx_yp - Sxp_y) + (1 - 2 * cpt) * (Sx * Syp - Sxp * Sy);
+    const double b = cpt * cpt * (Sx_xp + Sy_yp) + (1 - 2 * cpt) * (Sx * Sxp + Syp * Sy);
 
     *theta = atan2(a, b);
     *tx = xpg - cos(*theta) * xg + sin(*theta) * yg;
     *ty = ypg - sin(*theta) * xg - cos(*theta) * yg;
 }
 
-void features_rigid_registration_corrected(ROI_t* ROI_array0, const ROI_t* ROI_array1, double* theta, double* tx,
-                                           double* ty, double mean_error, double std_deviation) {
-    _features_rigid_registration_corrected(ROI_array0->next_id, ROI_array0->x, ROI_array0->y, ROI_array0->error,
-                                           ROI_array0->is_moving, ROI_array0->_size, ROI_array1->x, ROI_array1->y,
-                                           theta, tx, ty, mean_error, std_deviation);
+// Residual errors of the pairs after the inverse motion (written in 'ROI0_dx', 'ROI0_dy' and 'ROI0_error'), the mean
+// and the standard deviation of the errors of the pairs that are not moving are computed in the same pass (Welford)
+static void _features_pairs_residuals(const features_pairs_t* pairs, const uint8_t* ROI0_is_moving, float* ROI0_dx,
+                                      float* ROI0_dy, float* ROI0_error, const double theta, const double tx,
+                                      const double ty, double* mean_error, double* std_deviation) {
+    const double cos_theta = cos(theta);
+    const double sin_theta = sin(theta);
+    double mean = 0., M2 = 0.;
+    size_t cpt = 0;
+
+    for (size_t k = 0; k < pairs->n; k++) {
+        const uint32_t i = pairs->idx[k];
+        // position in the image I of the point of the image I+1
+        const double x = cos_theta * (pairs->x1[k] - tx) + sin_theta * (pairs->y1[k] - ty);
+        const double y = cos_theta * (pairs->y1[k] - ty) - sin_theta * (pairs->x1[k] - tx);
+        const float dx = x - pairs->x0[k];
+        const float dy = y - pairs->y0[k];
+        const float e = sqrt(dx * dx + dy * dy);
+        ROI0_dx[i] = dx;
+        ROI0_dy[i] = dy;
+        ROI0_error[i] = e;
+
+        if (!ROI0_is_moving[i]) {
+            cpt++;
+            const double delta = e - mean;
+            mean += delta / cpt;
+            M2 += delta * (e - mean);
+        }
+    }
+
+    // undefined without pairs that are not moving
+    *mean_error = cpt ? mean : NAN;
+    *std_deviation = cpt ? sqrt(M2 / cpt) : NAN;
 }
 
+void _features_compute_motion(const int32_t* ROI0_next_id, const float* ROI0_x, const float* ROI0_y, float* ROI0_dx,
+                              float* ROI0_dy, float* ROI0_error, uint8_t* ROI0_is_moving, const size_t n_ROI0,
+                              const float* ROI1_x, const float* ROI1_y, double* first_theta, double* first_tx,
+                              double* first_ty, double* first_mean_error, double* first_std_deviation, double* theta,
+                              double* tx, double* ty, double* mean_error, double* std_deviation) {
+    // gathers the associated pairs once, the next passes are on contiguous arrays
+    features_pairs_t pairs;
+    _features_pairs_gather(&pairs, ROI0_next_id, NULL, ROI0_x, ROI0_y, n_ROI0, ROI1_x, ROI1_y);
+
+    // first estimation with all the pairs
+    _features_pairs_registration(&pairs, first_theta, first_tx, first_ty);
+    _features_pairs_residuals(&pairs, ROI0_is_moving, ROI0_dx, ROI0_dy, ROI0_error, *first_theta, *first_tx,
+                              *first_ty, first_mean_error, first_std_deviation);
+
+    // the CCs with an abnormal error are moving, second estimation without them
+    for (size_t i = 0; i < n_ROI0; i++)
+        if (fabs(ROI0_error[i] - *first_mean_error) > *first_std_deviation)
+            ROI0_is_moving[i] = 1;
+    for (size_t k = 0; k < pairs.n; k++)
+        pairs.keep[k] = !(fabs(ROI0_error[pairs.idx[k]] - *first_mean_error) > *first_std_deviation);
+    _features_pairs_registration(&pairs, theta, tx, ty);
+    _features_pairs_residuals(&pairs, ROI0_is_moving, ROI0_dx, ROI0_dy, ROI0_error, *theta, *tx, *ty, mean_error,
+                              std_deviation);
 
-// TODO: Pour l'optimisation : faire une version errorMoy_corrected()
-double _features_compute_mean_error(const int32_t* ROI_next_id, const float* ROI_error, const uint8_t* ROI_is_moving,
-                                    const size_t n_ROI) {
-    double S = 0.0;
-    int cpt = 0;
-    for (size_t i = 0; i < n_ROI; i++) {
-        if (ROI_is_moving[i] || !ROI_next_id[i])
-            continue;
-        S += ROI_error[i];
-        cpt++;
-    }
-    return S / cpt;
+    _features_pairs_free(&pairs);
 }
 
-double features_compute_mean_error(const ROI_t* ROI_array) {
-    return _features_compute_mean_error(ROI_array->next_id, ROI_array->error, ROI_array->is_moving, ROI_array->_size);
+// Sort key of the pairs of a cell: by decreasing surface, then by increasing index
+static int _features_pairs_key_cmp(const void* a, const void* b) {
+    const uint64_t ka = *(const uint64_t*)a;
+    const uint64_t kb = *(const uint64_t*)b;
+    return (ka > kb) - (ka < kb);
 }
 
-// TODO: Pour l'optimisation : faire une version ecartType_corrected()
-double _features_compute_std_deviation(const int32_t* ROI_next_id, const float* ROI_error, const uint8_t* ROI_is_moving,
-                                       const size_t n_ROI, const double mean_error) {
-    double S = 0.0;
-    int cpt = 0;
-    for (size_t i = 0; i < n_ROI; i++) {
-        if (ROI_is_moving[i] || !ROI_next_id[i])
-            continue;
-        float e = ROI_error[i];
-        S += ((e - mean_error) * (e - mean_error));
-        cpt++;
+// Subset of 'max_pairs' pairs (all the pairs if there are fewer) for the robust registration: the pairs are
+// stratified on a grid of 'FEATURES_REG_GRID' x 'FEATURES_REG_GRID' cells (bounding box of the pairs in 'ROI0') and
+// each cell gives its largest CCs, so the fit is not dominated by a dense region. The budget is shared round-robin
+// between the cells, the share of the cells with too few pairs goes to the other cells. Returns the number of
+// selected pairs (indices in 'sel', at most 'max_pairs').
+static size_t _features_pairs_select(const features_pairs_t* pairs, const size_t max_pairs, uint32_t* sel) {
+    if (pairs->n <= max_pairs) {
+        for (size_t k = 0; k < pairs->n; k++)
+            sel[k] = (uint32_t)k;
+        return pairs->n;
     }
-    return sqrt(S / cpt);
+
+    const int n_cells = FEATURES_REG_GRID * FEATURES_REG_GRID;
+    float xmin = pairs->x0[0], xmax = pairs->x0[0], ymin = pairs->y0[0], ymax = pairs->y0[0];
+    for (size_t k = 1; k < pairs->n; k++) {
+        xmin = MIN(xmin, pairs->x0[k]);
+        xmax = MAX(xmax, pairs->x0[k]);
+        ymin = MIN(ymin, pairs->y0[k]);
+        ymax = MAX(ymax, pairs->y0[k]);
+    }
+    const float cw = (xmax - xmin) / FEATURES_REG_GRID + 1e-3f;
+    const float ch = (ymax - ymin) / FEATURES_REG_GRID + 1e-3f;
+
+    // the pairs are bucketed by cell (counting sort), then each cell is sorted by decreasing surface
+    uint16_t* cell = (uint16_t*)malloc(pairs->n * sizeof(uint16_t));
+    size_t cell_n[FEATURES_REG_GRID * FEATURES_REG_GRID] = {0};
+    for (size_t k = 0; k < pairs->n; k++) {
+        const int cx = MIN((int)((pairs->x0[k] - xmin) / cw), FEATURES_REG_GRID - 1);
+        const int cy = MIN((int)((pairs->y0[k] - ymin) / ch), FEATURES_REG_GRID - 1);
+        cell[k] = (uint16_t)(cx + cy * FEATURES_REG_GRID);
+        cell_n[cell[k]]++;
+    }
+    size_t cell_start[FEATURES_REG_GRID * FEATURES_REG_GRID];
+    size_t cell_pos[FEATURES_REG_GRID * FEATURES_REG_GRID];
+    size_t start = 0;
+    for (int c = 0; c < n_cells; c++) {
+        cell_start[c] = cell_pos[c] = start;
+        start += cell_n[c];
+    }
+    uint64_t* keys = (uint64_t*)malloc(pairs->n * sizeof(uint64_t));
+    for (size_t k = 0; k < pairs->n; k++)
+        keys[cell_pos[cell[k]]++] = ((uint64_t)(UINT32_MAX - pairs->S[k]) << 32) | (uint64_t)k;
+    for (int c = 0; c < n_cells; c++)
+        qsort(keys + cell_start[c], cell_n[c], sizeof(uint64_t), _features_pairs_key_cmp);
+
+    // one more pair per cell and per round until the budget is spent (there are more pairs than 'max_pairs')
+    size_t cell_m[FEATURES_REG_GRID * FEATURES_REG_GRID] = {0};
+    size_t m = 0;
+    while (m < max_pairs)
+        for (int c = 0; c < n_cells && m < max_pairs; c++)
+            if (cell_m[c] < cell_n[c]) {
+                cell_m[c]++;
+                m++;
+            }
+
+    m = 0;
+    for (int c = 0; c < n_cells; c++)
+        for (size_t q = 0; q < cell_m[c]; q++)
+            sel[m++] = (uint32_t)keys[cell_start[c] + q];
+    free(keys);
+    free(cell);
+    return m;
 }
 
-double features_compute_std_deviation(const ROI_t* ROI_array, const double mean_error) {
-    return _features_compute_std_deviation(ROI_array->next_id, ROI_array->error, ROI_array->is_moving, ROI_array->_size,
-                                           mean_error);
+// Residual errors of the selected pairs after the inverse motion
+static void _features_pairs_sel_residuals(const features_pairs_t* pairs, const uint32_t* sel, const size_t m,
+                                          const double theta, const double tx, const double ty, double* r) {
+    const double cos_theta = cos(theta);
+    const double sin_theta = sin(theta);
+    for (size_t s = 0; s < m; s++) {
+        const uint32_t k = sel[s];
+        const double dx = cos_theta * (pairs->x1[k] - tx) + sin_theta * (pairs->y1[k] - ty) - pairs->x0[k];
+        const double dy = cos_theta * (pairs->y1[k] - ty) - sin_theta * (pairs->x1[k] - tx) - pairs->y0[k];
+        r[s] = sqrt(dx * dx + dy * dy);
+    }
 }
 
-void _features_motion_extraction(const int32_t* ROI0_next_id, const float* ROI0_x, const float* ROI0_y,
-                                 float* ROI0_dx, float* ROI0_dy, float* ROI0_error, const size_t n_ROI0,
-                                 const float* ROI1_x, const float* ROI1_y, double theta, double tx, double ty) {
-    int cc1;
-    double x, y, xp, yp;
-    float dx, dy;
-    float e;
+// Weighted least squares rigid registration of the selected pairs, the motion is not modified if all the weights are 0
+static void _features_pairs_weighted_fit(const features_pairs_t* pairs, const uint32_t* sel, const double* w,
+                                         const size_t m, double* theta, double* tx, double* ty) {
+    double W = 0, xg = 0, yg = 0, xpg = 0, ypg = 0;
+    for (size_t s = 0; s < m; s++) {
+        const uint32_t k = sel[s];
+        W += w[s];
+        xg += w[s] * pairs->x0[k];
+        yg += w[s] * pairs->y0[k];
+        xpg += w[s] * pairs->x1[k];
+        ypg += w[s] * pairs->y1[k];
+    }
+    if (W <= 0)
+        return;
+    xg /= W;
+    yg /= W;
+    xpg /= W;
+    ypg /= W;
+
+    double a = 0, b = 0;
+    for (size_t s = 0; s < m; s++) {
+        const uint32_t k = sel[s];
+        const double x0 = pairs->x0[k] - xg;
+        const double y0 = pairs->y0[k] - yg;
+        const double x1 = pairs->x1[k] - xpg;
+        const double y1 = pairs->y1[k] - ypg;
+        a += w[s] * (x0 * y1 - y0 * x1);
+        b += w[s] * (x0 * x1 + y0 * y1);
+    }
 
-    for (size_t i = 0; i < n_ROI0; i++) {
-        cc1 = ROI0_next_id[i];
-        if (cc1) {
-            // coordonees du point dans l'image I+1
-            xp = ROI1_x[cc1 - 1];
-            yp = ROI1_y[cc1 - 1];
-            // calcul de (x,y) pour l'image I
-            x = cos(theta) * (xp - tx) + sin(theta) * (yp - ty);
-            y = cos(theta) * (yp - ty) - sin(theta) * (xp - tx);
-
-            // pas besoin de stocker dx et dy (juste pour l'affichage du debug)
-            dx = x - ROI0_x[i];
-            dy = y - ROI0_y[i];
-            ROI0_dx[i] = dx;
-            ROI0_dy[i] = dy;
-
-            e = sqrt(dx * dx + dy * dy);
-            ROI0_error[i] = e;
+    *theta = atan2(a, b);
+    *tx = xpg - cos(*theta) * xg + sin(*theta) * yg;
+    *ty = ypg - sin(*theta) * xg - cos(*theta) * yg;
+}
+
+// k-th smallest value of 'v' (quickselect, 'v' is reordered)
+static double _features_select_kth(double* v, const size_t n, const size_t k) {
+    size_t lo = 0, hi = n - 1;
+    while (lo < hi) {
+        const double pivot = v[(lo + hi) / 2];
+        size_t i = lo, j = hi;
+        while (i <= j) {
+            while (v[i] < pivot)
+                i++;
+            while (v[j] > pivot)
+                j--;
+            if (i <= j) {
+                const double tmp = v[i];
+                v[i] = v[j];
+                v[j] = tmp;
+                i++;
+                if (j == 0)
+                    break;
+                j--;
+            }
         }
+        if (k <= j)
+            hi = j;
+        else if (k >= i)
+            lo = i;
+        else
+            break;
     }
+    return v[k];
 }
 
-void features_motion_extraction(ROI_t* ROI_array0, const ROI_t* ROI_array1, double theta, double tx, double ty) {
-    _features_motion_extraction(ROI_array0->next_id, ROI_array0->x, ROI_array0->y, ROI_array0->dx, ROI_array0->dy,
-                                ROI_array0->error, ROI_array0->_size, ROI_array1->x, ROI_array1->y, theta, tx, ty);
-}
+void _features_compute_motion_robust(const int32_t* ROI0_next_id, const uint32_t* ROI0_S, const float* ROI0_x,
+                                     const float* ROI0_y, float* ROI0_dx, float* ROI0_dy, float* ROI0_error,
+                                     uint8_t* ROI0_is_moving, const size_t n_ROI0, const float* ROI1_x,
+                                     const float* ROI1_y, const size_t max_pairs, const int n_iters,
+                                     const double prev_theta, const double prev_tx, const double prev_ty,
+                                     double* first_theta, double* first_tx, double* first_ty,
+                                     double* first_mean_error, double* first_std_deviation, double* theta, double* tx,
+                                     double* ty, double* mean_error, double* std_deviation) {
+    features_pairs_t pairs;
+    _features_pairs_gather(&pairs, ROI0_next_id, ROI0_S, ROI0_x, ROI0_y, n_ROI0, ROI1_x, ROI1_y);
+    const size_t max_m = MIN(pairs.n, max_pairs); // the selection never returns more pairs
+    uint32_t* sel = (uint32_t*)malloc(max_m * sizeof(uint32_t));
+    double* r = (double*)malloc(max_m * sizeof(double));
+    double* w = (double*)malloc(max_m * sizeof(double));
+    const size_t m = _features_pairs_select(&pairs, max_pairs, sel);
+
+    // initial motion: the motion of the previous frame (warm start) or a least squares fit of the subset
+    if (isfinite(prev_theta) && isfinite(prev_tx) && isfinite(prev_ty)) {
+        *first_theta = prev_theta;
+        *first_tx = prev_tx;
+        *first_ty = prev_ty;
+    } else {
+        *first_theta = *first_tx = *first_ty = 0.; // identity without pairs (as '_features_compute_motion')
+        for (size_t s = 0; s < m; s++)
+            w[s] = 1.;
+        _features_pairs_weighted_fit(&pairs, sel, w, m, first_theta, first_tx, first_ty);
+    }
+    _features_pairs_residuals(&pairs, ROI0_is_moving, ROI0_dx, ROI0_dy, ROI0_error, *first_theta, *first_tx,
+                              *first_ty, first_mean_error, first_std_deviation);
 
-void _features_compute_motion(const int32_t* ROI0_next_id, const float* ROI0_x, const float* ROI0_y, float* ROI0_dx,
-                              float* ROI0_dy, float* ROI0_error, uint8_t* ROI0_is_moving, const size_t n_ROI0,
-                              const float* ROI1_x, const float* ROI1_y, double* first_theta, double* first_tx,
-                              double* first_ty, double* first_mean_error, double* first_std_deviation, double* theta,
-                              double* tx, double* ty, double* mean_error, double* std_deviation) {
-    _features_rigid_registration(ROI0_next_id, ROI0_x, ROI0_y, n_ROI0, ROI1_x, ROI1_y, first_theta, first_tx, first_ty);
-    _features_motion_extraction(ROI0_next_id, ROI0_x, ROI0_y, ROI0_dx, ROI0_dy, ROI0_error, n_ROI0, ROI1_x, ROI1_y,
-                                *first_theta, *first_tx, *first_ty);
-    *first_mean_error = _features_compute_mean_error(ROI0_next_id, ROI0_error, ROI0_is_moving, n_ROI0);
-    *first_std_deviation = _features_compute_std_deviation(ROI0_next_id, ROI0_error, ROI0_is_moving, n_ROI0,
-                                                           *first_mean_error);
-    // saveErrorMoy("first_error.txt", mean_error, std_deviation);
-    _features_rigid_registration_corrected(ROI0_next_id, ROI0_x, ROI0_y, ROI0_error, ROI0_is_moving, n_ROI0, ROI1_x,
-                                           ROI1_y, theta, tx, ty, *first_mean_error, *first_std_deviation);
-    _features_motion_extraction(ROI0_next_id, ROI0_x, ROI0_y, ROI0_dx, ROI0_dy, ROI0_error, n_ROI0, ROI1_x, ROI1_y,
-                                *theta, *tx, *ty);
-    *mean_error = _features_compute_mean_error(ROI0_next_id, ROI0_error, ROI0_is_moving, n_ROI0);
-    *std_deviation = _features_compute_std_deviation(ROI0_next_id, ROI0_error, ROI0_is_moving, n_ROI0, *mean_error);
+    // the CCs with an abnormal error are moving (same criterion as '_features_compute_motion')
+    for (size_t i = 0; i < n_ROI0; i++)
+        if (fabs(ROI0_error[i] - *first_mean_error) > *first_std_deviation)
+            ROI0_is_moving[i] = 1;
+
+    // bounded number of iteratively reweighted least squares (Tukey biweight, the scale is estimated from the median
+    // of the residuals), the cost only depends on 'max_pairs' and 'n_iters'
+    *theta = *first_theta;
+    *tx = *first_tx;
+    *ty = *first_ty;
+    for (int it = 0; it < n_iters && m; it++) {
+        _features_pairs_sel_residuals(&pairs, sel, m, *theta, *tx, *ty, r);
+        for (size_t s = 0; s < m; s++)
+            w[s] = r[s];
+        const double scale = MAX(1.4826 * _features_select_kth(w, m, m / 2), FEATURES_REG_MIN_SCALE);
+        const double c = 4.685 * scale;
+        for (size_t s = 0; s < m; s++) {
+            const double u = r[s] / c;
+            w[s] = (u < 1. && !ROI0_is_moving[pairs.idx[sel[s]]]) ? (1. - u * u) * (1. - u * u) : 0.;
+        }
+        const double old_theta = *theta, old_tx = *tx, old_ty = *ty;
+        _features_pairs_weighted_fit(&pairs, sel, w, m, theta, tx, ty);
+        if (fabs(*theta - old_theta) < 1e-9 && fabs(*tx - old_tx) < 1e-6 && fabs(*ty - old_ty) < 1e-6)
+            break;
+    }
+    _features_pairs_residuals(&pairs, ROI0_is_moving, ROI0_dx, ROI0_dy, ROI0_error, *theta, *tx, *ty, mean_error,
+                              std_deviation);
+
+    free(sel);
+    free(r);
+    free(w);
+    _features_pairs_free(&pairs);
 }
 
 void features_compute_motion(const ROI_t* ROI_array1, ROI_t* ROI_array0, double* first_theta, double* first_tx,
@@ -595,6 +1025,18 @@ void features_compute_motion(const ROI_t* ROI_array1, ROI_t* ROI_array0, double*
                              mean_error, std_deviation);
 }
 
+void features_compute_motion_robust(const ROI_t* ROI_array1, ROI_t* ROI_array0, const size_t max_pairs,
+                                    const int n_iters, const double prev_theta, const double prev_tx,
+                                    const double prev_ty, double* first_theta, double* first_tx, double* first_ty,
+                                    double* first_mean_error, double* first_std_deviation, double* theta, double* tx,
+                                    double* ty, double* mean_error, double* std_deviation) {
+    _features_compute_motion_robust(ROI_array0->next_id, ROI_array0->S, ROI_array0->x, ROI_array0->y, ROI_array0->dx,
+                                    ROI_array0->dy, ROI_array0->error, ROI_array0->is_moving, ROI_array0->_size,
+                                    ROI_array1->x, ROI_array1->y, max_pairs, n_iters, prev_theta, prev_tx, prev_ty,
+                                    first_theta, first_tx, first_ty, first_mean_error, first_std_deviation, theta, tx,
+                                    ty, mean_error, std_deviation);
+}
+
 void features_print_stats(ROI_t* stats, int n) {
     int cpt = 0;
     for (int i = 0; i < n; i++) {
@@ -658,12 +1100,13 @@ void features_parse_stats(const char* filename, ROI_t* stats, int* n) {
     fclose(file);
 }
 
-int _find_corresponding_track(const uint16_t* track_id, const ROI_light_t* track_end, const size_t n_tracks,
+int _find_corresponding_track(const uint32_t* track_id, const ROI_light_t* track_end, const size_t n_tracks,
                               const uint16_t* ROI_id, const int sel_ROI_id, const unsigned age) {
     assert(age == 0 || age == 1);
     for (size_t t = 0; t < n_tracks; t++) {
         if (track_id[t]) {
-            int cur_ROI_id = (age == 0) ? track_end[t].id : ROI_id[track_end[t].prev_id - 1];
+            int cur_ROI_id = (age == 0) ? track_end[t].id
+                                        : (track_end[t].prev_id ? ROI_id[track_end[t].prev_id - 1] : 0);
             if (cur_ROI_id <= 0)
                 continue;
             if (sel_ROI_id == cur_ROI_id)
@@ -683,7 +1126,7 @@ void _features_ROI_write(FILE* f, const uint16_t* ROI_id, const uint16_t* ROI_xm
                          const uint16_t* ROI_ymin, const uint16_t* ROI_ymax, const uint32_t* ROI_S,
                          const uint32_t* ROI_Sx, const uint32_t* ROI_Sy, const float* ROI_x, const float* ROI_y,
                          const int32_t* ROI_time, const int32_t* ROI_time_motion, const size_t n_ROI,
-                         const uint16_t* track_id, const ROI_light_t* track_end, const enum obj_e* track_obj_type,
+                         const uint32_t* track_id, const ROI_light_t* track_end, const enum obj_e* track_obj_type,
                          const size_t n_tracks, const unsigned age) {
     int cpt = 0;
     for (size_t i = 0; i < n_ROI; i++)
@@ -752,7 +1195,7 @@ void _features_ROI0_ROI1_write(FILE* f, const int frame, const uint16_t* ROI0_id
                                const uint16_t* ROI1_ymax, const uint32_t* ROI1_S, const uint32_t* ROI1_Sx,
                                const uint32_t* ROI1_Sy, const float* ROI1_x, const float* ROI1_y,
                                const int32_t* ROI1_time, const int32_t* ROI1_time_motion, const size_t n_ROI1,
-                               const uint16_t* track_id, const ROI_light_t* track_end, const enum obj_e* track_obj_type,
+                               const uint32_t* track_id, const ROI_light_t* track_end, const enum obj_e* track_obj_type,
                                const size_t n_tracks) {
     // stats
     fprintf(f, "# Frame n°%05d (cur)\n", frame - 1);
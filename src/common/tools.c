@@ -3,6 +3,9 @@
 #include <string.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
 #ifdef OPENCV_LINK
 #include <tuple>
 #include <vector>
@@ -724,3 +727,46 @@ void tools_write_PNM_row(const uint8* line, const int width, FILE* file) {
     /* Le fichier est deja ouvert et ne sera pas ferme a la fin */
     fwrite(&(line[0]), sizeof(byte), 3 * sizeof(byte) * width, file);
 }
+
+uint64_t** tools_alloc_packed_matrix(const int i0, const int i1, const int j0, const int j1) {
+    const size_t n_rows = (size_t)((i1 - i0) + 1);
+    const size_t n_words = PACKED_N_WORDS(j0, j1);
+    uint64_t** M = (uint64_t**)malloc(n_rows * sizeof(uint64_t*));
+    M[0] = (uint64_t*)calloc(n_rows * n_words, sizeof(uint64_t));
+    for (size_t i = 1; i < n_rows; i++)
+        M[i] = M[i - 1] + n_words;
+    return M - i0;
+}
+
+void tools_free_packed_matrix(uint64_t** M, const int i0) {
+    free(M[i0]);
+    free(M + i0);
+}
+
+// huge page size (x86-64 and AArch64 with 4 KB pages): the arenas larger than this size are aligned on it
+#define TOOLS_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+void* tools_arena_alloc(const size_t size) {
+    const size_t align = size >= TOOLS_HUGE_PAGE_SIZE ? TOOLS_HUGE_PAGE_SIZE : TOOLS_ARENA_ALIGN;
+    void* arena = NULL;
+    if (posix_memalign(&arena, align, size ? size : TOOLS_ARENA_ALIGN)) {
+        fprintf(stderr, "(EE) Can't allocate an arena of %lu bytes.\n", (unsigned long)size);
+        exit(1);
+    }
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    // only a hint: without transparent huge pages the arena stays on regular pages
+    if (align == TOOLS_HUGE_PAGE_SIZE)
+        madvise(arena, size, MADV_HUGEPAGE);
+#endif
+    return arena;
+}
+
+void tools_arena_free(void* arena) {
+    free(arena);
+}
+
+void* tools_arena_slice(void* arena, size_t* offset, const size_t size) {
+    void* slice = arena ? (void*)((uint8_t*)arena + *offset) : NULL;
+    *offset += (size + TOOLS_ARENA_ALIGN - 1) & ~(size_t)(TOOLS_ARENA_ALIGN - 1);
+    return slice;
+}
@@ -63,7 +63,7 @@ size_t tracking_get_track_time(const track_t* track_array, const size_t t) {
     return _tracking_get_track_time(track_array->begin, track_array->end, t);
 }
 
-size_t _tracking_count_objects(const uint16_t* track_id, const enum obj_e* track_obj_type, unsigned* n_stars,
+size_t _tracking_count_objects(const uint32_t* track_id, const enum obj_e* track_obj_type, unsigned* n_stars,
                                unsigned* n_meteors, unsigned* n_noise, const size_t n_tracks) {
     (*n_stars) = (*n_meteors) = (*n_noise) = 0;
     for (size_t i = 0; i < n_tracks; i++)
@@ -88,26 +88,39 @@ size_t _tracking_count_objects(const uint16_t* track_id, const enum obj_e* track
 
 size_t tracking_count_objects(const track_t* track_array, unsigned* n_stars, unsigned* n_meteors,
                               unsigned* n_noise) {
-    return _tracking_count_objects(track_array->id, track_array->obj_type, n_stars, n_meteors, n_noise,
-                                   track_array->_size);
+    _tracking_count_objects(track_array->id, track_array->obj_type, n_stars, n_meteors, n_noise, track_array->_size);
+    (*n_stars) += track_array->_n_flushed_objects[STAR];
+    (*n_meteors) += track_array->_n_flushed_objects[METEOR];
+    (*n_noise) += track_array->_n_flushed_objects[NOISE];
+    return (*n_stars) + (*n_meteors) + (*n_noise);
+}
+
+// Slices the fields in 'arena' (or only computes the size of the arena if 'arena' is NULL), 'id' is the first slice
+static size_t _tracking_slice_track_array(track_t* track_array, void* arena, const size_t max_size) {
+    size_t size = 0;
+    track_array->id = (uint32_t*)tools_arena_slice(arena, &size, max_size * sizeof(uint32_t));
+    track_array->begin = (ROI_light_t*)tools_arena_slice(arena, &size, max_size * sizeof(ROI_light_t));
+    track_array->end = (ROI_light_t*)tools_arena_slice(arena, &size, max_size * sizeof(ROI_light_t));
+    track_array->extrapol_x = (float*)tools_arena_slice(arena, &size, max_size * sizeof(float));
+    track_array->extrapol_y = (float*)tools_arena_slice(arena, &size, max_size * sizeof(float));
+    track_array->state = (enum state_e*)tools_arena_slice(arena, &size, max_size * sizeof(enum state_e));
+    track_array->obj_type = (enum obj_e*)tools_arena_slice(arena, &size, max_size * sizeof(enum obj_e));
+    track_array->change_state_reason = (enum change_state_reason_e*)tools_arena_slice(
+        arena, &size, max_size * sizeof(enum change_state_reason_e));
+    return size;
 }
 
 track_t* tracking_alloc_track_array(const size_t max_size) {
     track_t* track_array = (track_t*)malloc(sizeof(track_t));
-    track_array->id = (uint16_t*)malloc(max_size * sizeof(uint16_t));
-    track_array->begin = (ROI_light_t*)malloc(max_size * sizeof(ROI_light_t));
-    track_array->end = (ROI_light_t*)malloc(max_size * sizeof(ROI_light_t));
-    track_array->extrapol_x = (float*)malloc(max_size * sizeof(float));
-    track_array->extrapol_y = (float*)malloc(max_size * sizeof(float));
-    track_array->state = (enum state_e*)malloc(max_size * sizeof(enum state_e));
-    track_array->obj_type = (enum obj_e*)malloc(max_size * sizeof(enum obj_e));
-    track_array->change_state_reason = (enum change_state_reason_e*)malloc(max_size * sizeof(enum change_state_reason_e));
+    // all the fields are in a single aligned arena
+    void* arena = tools_arena_alloc(_tracking_slice_track_array(track_array, NULL, max_size));
+    _tracking_slice_track_array(track_array, arena, max_size);
     track_array->_max_size = max_size;
     return track_array;
 }
 
 void tracking_init_track_array(track_t* track_array) {
-    memset(track_array->id, 0, track_array->_max_size * sizeof(uint16_t));
+    memset(track_array->id, 0, track_array->_max_size * sizeof(uint32_t));
     memset(track_array->begin, 0, track_array->_max_size * sizeof(ROI_light_t));
     memset(track_array->end, 0, track_array->_max_size * sizeof(ROI_light_t));
     memset(track_array->extrapol_x, 0, track_array->_max_size * sizeof(float));
@@ -117,9 +130,11 @@ void tracking_init_track_array(track_t* track_array) {
     memset(track_array->change_state_reason, 0, track_array->_max_size * sizeof(enum change_state_reason_e));
     track_array->_size = 0;
     track_array->_offset = 0;
+    track_array->_n_flushed = 0;
+    memset(track_array->_n_flushed_objects, 0, sizeof(track_array->_n_flushed_objects));
 }
 
-void _tracking_clear_index_track_array(uint16_t* track_id, const size_t t) {
+void _tracking_clear_index_track_array(uint32_t* track_id, const size_t t) {
     track_id[t] = 0;
 }
 
@@ -128,57 +143,331 @@ void tracking_clear_index_track_array(track_t* track_array, const size_t t) {
 }
 
 void tracking_free_track_array(track_t* track_array) {
-    free(track_array->id);
-    free(track_array->begin);
-    free(track_array->end);
-    free(track_array->extrapol_x);
-    free(track_array->extrapol_y);
-    free(track_array->state);
-    free(track_array->obj_type);
-    free(track_array->change_state_reason);
+    tools_arena_free(track_array->id); // 'id' is the beginning of the arena
     free(track_array);
 }
 
-void tracking_init_BB_array(BB_t** BB_array) {
-    for (int i = 0; i < MAX_N_FRAMES; i++)
-        BB_array[i] = NULL;
+// Records of the bounding boxes log: the tag (1 byte), the position + 1 of the next record of the track (4 bytes) and
+// the track id (2 bytes) are common to the two formats
+#define BB_LOG_TAG_FULL 0
+#define BB_LOG_TAG_DELTA 1
+#define BB_LOG_FULL_SIZE 23 // + frame (8 bytes) + 'bb_x', 'bb_y', 'rx' and 'ry' (4 x 2 bytes)
+#define BB_LOG_DELTA_SIZE 12 // + deltas of frame, 'bb_x' and 'bb_y' (3 x 1 byte) + 'rx' and 'ry' (2 x 1 byte)
+
+BB_log_t* tracking_alloc_BB_log(const size_t max_tracks, const int delta) {
+    BB_log_t* BB_log = (BB_log_t*)malloc(sizeof(BB_log_t));
+    BB_log->_max_chunks = 16;
+    BB_log->chunks = (uint8_t**)malloc(BB_log->_max_chunks * sizeof(uint8_t*));
+    BB_log->chunks_size = (uint32_t*)malloc(BB_log->_max_chunks * sizeof(uint32_t));
+    BB_log->n_chunks = 0;
+    BB_log->_max_tracks = max_tracks;
+    BB_log->track_head = (uint32_t*)malloc((max_tracks + 1) * sizeof(uint32_t));
+    BB_log->track_tail = (uint32_t*)malloc((max_tracks + 1) * sizeof(uint32_t));
+    BB_log->track_n_BB = (uint32_t*)malloc((max_tracks + 1) * sizeof(uint32_t));
+    BB_log->track_last = (BB_t*)malloc((max_tracks + 1) * sizeof(BB_t));
+    BB_log->delta = delta;
+    return BB_log;
+}
+
+void tracking_init_BB_log(BB_log_t* BB_log) {
+    for (size_t c = 0; c < BB_log->n_chunks; c++)
+        tools_arena_free(BB_log->chunks[c]);
+    BB_log->n_chunks = 0;
+    memset(BB_log->track_head, 0, (BB_log->_max_tracks + 1) * sizeof(uint32_t));
+    memset(BB_log->track_tail, 0, (BB_log->_max_tracks + 1) * sizeof(uint32_t));
+    memset(BB_log->track_n_BB, 0, (BB_log->_max_tracks + 1) * sizeof(uint32_t));
+    memset(BB_log->track_last, 0, (BB_log->_max_tracks + 1) * sizeof(BB_t));
+    BB_log->max_frame = 0;
+    BB_log->_size = 0;
+    BB_log->_n_dropped = 0;
+}
+
+void tracking_free_BB_log(BB_log_t* BB_log) {
+    for (size_t c = 0; c < BB_log->n_chunks; c++)
+        tools_arena_free(BB_log->chunks[c]);
+    free(BB_log->chunks);
+    free(BB_log->chunks_size);
+    free(BB_log->track_head);
+    free(BB_log->track_tail);
+    free(BB_log->track_n_BB);
+    free(BB_log->track_last);
+    free(BB_log);
+}
+
+static uint8_t* _tracking_BB_log_at(const BB_log_t* BB_log, const uint32_t pos) {
+    return BB_log->chunks[pos / BB_LOG_CHUNK_SIZE] + pos % BB_LOG_CHUNK_SIZE;
 }
 
-void tracking_free_BB_array(BB_t** BB_array) {
-    unsigned i = 0;
-    while (BB_array[i] != NULL) {
-        BB_t* cur = BB_array[i];
-        while (cur != NULL) {
-            BB_t* next = cur->next;
-            free(cur);
-            cur = NULL;
-            cur = next;
+// Returns the place of a new record of 'size' bytes at the end of the log ('pos' is its position), the records never
+// straddle two chunks
+static uint8_t* _tracking_BB_log_reserve(BB_log_t* BB_log, const uint32_t size, uint32_t* pos) {
+    if (!BB_log->n_chunks || BB_log->chunks_size[BB_log->n_chunks - 1] + size > BB_LOG_CHUNK_SIZE) {
+        if ((uint64_t)(BB_log->n_chunks + 1) * BB_LOG_CHUNK_SIZE > UINT32_MAX) {
+            fprintf(stderr, "(EE) The bounding boxes log is full ('n_chunks' = %lu)\n", BB_log->n_chunks);
+            exit(1);
+        }
+        if (BB_log->n_chunks == BB_log->_max_chunks) {
+            BB_log->_max_chunks *= 2;
+            BB_log->chunks = (uint8_t**)realloc(BB_log->chunks, BB_log->_max_chunks * sizeof(uint8_t*));
+            BB_log->chunks_size = (uint32_t*)realloc(BB_log->chunks_size, BB_log->_max_chunks * sizeof(uint32_t));
         }
-        i++;
+        BB_log->chunks[BB_log->n_chunks] = (uint8_t*)tools_arena_alloc(BB_LOG_CHUNK_SIZE);
+        BB_log->chunks_size[BB_log->n_chunks] = 0;
+        BB_log->n_chunks++;
+    }
+    const size_t c = BB_log->n_chunks - 1;
+    *pos = (uint32_t)(c * BB_LOG_CHUNK_SIZE + BB_log->chunks_size[c]);
+    uint8_t* rec = BB_log->chunks[c] + BB_log->chunks_size[c];
+    BB_log->chunks_size[c] += size;
+    return rec;
+}
+
+void tracking_add_BB(BB_log_t* BB_log, const uint16_t rx, const uint16_t ry, const uint16_t bb_x, const uint16_t bb_y,
+                     const uint16_t track, const uint64_t frame) {
+    assert(track && track <= BB_log->_max_tracks);
+    BB_t* last = &BB_log->track_last[track];
+    const int64_t dframe = (int64_t)(frame - last->frame);
+    const int dbb_x = (int)bb_x - (int)last->bb_x;
+    const int dbb_y = (int)bb_y - (int)last->bb_y;
+    const int is_delta = BB_log->delta && BB_log->track_head[track] && dframe >= INT8_MIN && dframe <= INT8_MAX &&
+                         dbb_x >= INT8_MIN && dbb_x <= INT8_MAX && dbb_y >= INT8_MIN && dbb_y <= INT8_MAX &&
+                         rx <= UINT8_MAX && ry <= UINT8_MAX;
+
+    uint32_t pos;
+    uint8_t* rec = _tracking_BB_log_reserve(BB_log, is_delta ? BB_LOG_DELTA_SIZE : BB_LOG_FULL_SIZE, &pos);
+    const uint32_t next = 0;
+    rec[0] = is_delta ? BB_LOG_TAG_DELTA : BB_LOG_TAG_FULL;
+    memcpy(rec + 1, &next, sizeof(uint32_t));
+    memcpy(rec + 5, &track, sizeof(uint16_t));
+    if (is_delta) {
+        rec[7] = (uint8_t)(int8_t)dframe;
+        rec[8] = (uint8_t)(int8_t)dbb_x;
+        rec[9] = (uint8_t)(int8_t)dbb_y;
+        rec[10] = (uint8_t)rx;
+        rec[11] = (uint8_t)ry;
+    } else {
+        memcpy(rec + 7, &frame, sizeof(uint64_t));
+        memcpy(rec + 15, &bb_x, sizeof(uint16_t));
+        memcpy(rec + 17, &bb_y, sizeof(uint16_t));
+        memcpy(rec + 19, &rx, sizeof(uint16_t));
+        memcpy(rec + 21, &ry, sizeof(uint16_t));
+    }
+
+    // chains the record to the previous one of the track
+    const uint32_t pos1 = pos + 1;
+    if (BB_log->track_tail[track])
+        memcpy(_tracking_BB_log_at(BB_log, BB_log->track_tail[track] - 1) + 1, &pos1, sizeof(uint32_t));
+    else
+        BB_log->track_head[track] = pos1;
+    BB_log->track_tail[track] = pos1;
+    BB_log->track_n_BB[track]++;
+
+    last->frame = frame;
+    last->track_id = track;
+    last->bb_x = bb_x;
+    last->bb_y = bb_y;
+    last->rx = rx;
+    last->ry = ry;
+    BB_log->max_frame = MAX(BB_log->max_frame, frame);
+    BB_log->_size++;
+}
+
+// Decodes the record 'rec', 'ref' is the previous bounding box of the same track. Returns the size of the record
+static uint32_t _tracking_BB_log_decode(const uint8_t* rec, const BB_t* ref, BB_t* BB, uint32_t* next) {
+    memcpy(next, rec + 1, sizeof(uint32_t));
+    memcpy(&BB->track_id, rec + 5, sizeof(uint16_t));
+    if (rec[0] == BB_LOG_TAG_DELTA) {
+        BB->frame = ref->frame + (int64_t)(int8_t)rec[7];
+        BB->bb_x = (uint16_t)((int)ref->bb_x + (int8_t)rec[8]);
+        BB->bb_y = (uint16_t)((int)ref->bb_y + (int8_t)rec[9]);
+        BB->rx = rec[10];
+        BB->ry = rec[11];
+        return BB_LOG_DELTA_SIZE;
+    }
+    memcpy(&BB->frame, rec + 7, sizeof(uint64_t));
+    memcpy(&BB->bb_x, rec + 15, sizeof(uint16_t));
+    memcpy(&BB->bb_y, rec + 17, sizeof(uint16_t));
+    memcpy(&BB->rx, rec + 19, sizeof(uint16_t));
+    memcpy(&BB->ry, rec + 21, sizeof(uint16_t));
+    return BB_LOG_FULL_SIZE;
+}
+
+// Decodes the record at the position ('c', 'off') of the log and moves to the next one (insertion order), 'last'
+// contains the last decoded bounding box of each track. Returns 0 at the end of the log
+static int _tracking_BB_log_next(const BB_log_t* BB_log, size_t* c, uint32_t* off, BB_t* last, BB_t* BB) {
+    while (*c < BB_log->n_chunks && *off >= BB_log->chunks_size[*c]) {
+        (*c)++;
+        *off = 0;
+    }
+    if (*c >= BB_log->n_chunks)
+        return 0;
+    const uint8_t* rec = BB_log->chunks[*c] + *off;
+    uint16_t track;
+    memcpy(&track, rec + 5, sizeof(uint16_t));
+    uint32_t next;
+    *off += _tracking_BB_log_decode(rec, &last[track], BB, &next);
+    last[track] = *BB;
+    return 1;
+}
+
+size_t tracking_get_track_n_BB(const BB_log_t* BB_log, const uint16_t track) {
+    return track <= BB_log->_max_tracks ? BB_log->track_n_BB[track] : 0;
+}
+
+size_t tracking_get_track_BB(const BB_log_t* BB_log, const uint16_t track, BB_t* BBs) {
+    if (track > BB_log->_max_tracks)
+        return 0;
+    size_t n = 0;
+    BB_t ref = {0};
+    for (uint32_t pos1 = BB_log->track_head[track]; pos1; n++) {
+        _tracking_BB_log_decode(_tracking_BB_log_at(BB_log, pos1 - 1), &ref, &BBs[n], &pos1);
+        ref = BBs[n];
     }
+    return n;
 }
 
-void add_to_BB_array(BB_t** BB_array, uint16_t rx, uint16_t ry, uint16_t bb_x, uint16_t bb_y, uint16_t track_id,
-                     int frame) {
-    assert(frame < MAX_N_FRAMES);
-    BB_t* newE = (BB_t*)malloc(sizeof(BB_t));
-    newE->rx = rx;
-    newE->ry = ry;
-    newE->bb_x = bb_x;
-    newE->bb_y = bb_y;
-    newE->track_id = track_id;
-    newE->next = BB_array[frame];
-    BB_array[frame] = newE;
+void tracking_track_array_write_header(FILE* f) {
+    fprintf(f, "# -------||---------------------------||---------------------------||---------\n");
+    fprintf(f, "#  Track ||           Begin           ||            End            ||  Object \n");
+    fprintf(f, "# -------||---------------------------||---------------------------||---------\n");
+    fprintf(f, "# -------||---------|--------|--------||---------|--------|--------||---------\n");
+    fprintf(f, "#     Id || Frame # |      x |      y || Frame # |      x |      y ||    Type \n");
+    fprintf(f, "# -------||---------|--------|--------||---------|--------|--------||---------\n");
+}
+
+static void _tracking_track_write(FILE* f, const uint32_t* track_id, const ROI_light_t* track_begin,
+                                  const ROI_light_t* track_end, const enum obj_e* track_obj_type, const size_t i) {
+    fprintf(f, "   %5u || %7lu | %6.1f | %6.1f || %7lu | %6.1f | %6.1f || %s \n", track_id[i], track_begin[i].frame,
+            track_begin[i].x, track_begin[i].y, track_end[i].frame, track_end[i].x, track_end[i].y,
+            g_obj_to_string_with_spaces[track_obj_type[i]]);
+}
+
+// Forgets the bounding boxes of 'track', their records stay in the chunks until the log is compacted
+static void _tracking_BB_log_drop(BB_log_t* BB_log, const uint16_t track) {
+    BB_log->_n_dropped += BB_log->track_n_BB[track];
+    BB_log->track_head[track] = 0;
+    BB_log->track_tail[track] = 0;
+    BB_log->track_n_BB[track] = 0;
+    memset(&BB_log->track_last[track], 0, sizeof(BB_t));
+}
+
+// Gives the bounding boxes of 'track_src' to 'track_dst' (the records keep their key, the chains are not modified)
+static void _tracking_BB_log_move(BB_log_t* BB_log, const uint16_t track_src, const uint16_t track_dst) {
+    BB_log->track_head[track_dst] = BB_log->track_head[track_src];
+    BB_log->track_tail[track_dst] = BB_log->track_tail[track_src];
+    BB_log->track_n_BB[track_dst] = BB_log->track_n_BB[track_src];
+    BB_log->track_last[track_dst] = BB_log->track_last[track_src];
+    BB_log->track_head[track_src] = 0;
+    BB_log->track_tail[track_src] = 0;
+    BB_log->track_n_BB[track_src] = 0;
+    memset(&BB_log->track_last[track_src], 0, sizeof(BB_t));
+}
+
+// Rewrites the chains of the tracks [1, 'n_tracks'] in new chunks and frees the old ones (the dropped records are
+// reclaimed)
+static void _tracking_BB_log_compact(BB_log_t* BB_log, const size_t n_tracks) {
+    BB_log_t old = *BB_log;
+    BB_log->chunks = (uint8_t**)malloc(BB_log->_max_chunks * sizeof(uint8_t*));
+    BB_log->chunks_size = (uint32_t*)malloc(BB_log->_max_chunks * sizeof(uint32_t));
+    BB_log->n_chunks = 0;
+    BB_log->track_head = (uint32_t*)calloc(BB_log->_max_tracks + 1, sizeof(uint32_t));
+    BB_log->track_tail = (uint32_t*)calloc(BB_log->_max_tracks + 1, sizeof(uint32_t));
+    BB_log->track_n_BB = (uint32_t*)calloc(BB_log->_max_tracks + 1, sizeof(uint32_t));
+    BB_log->track_last = (BB_t*)calloc(BB_log->_max_tracks + 1, sizeof(BB_t));
+    BB_log->_size = 0;
+    BB_log->_n_dropped = 0;
+
+    for (size_t t = 1; t <= n_tracks; t++) {
+        BB_t BB, ref = {0};
+        for (uint32_t pos1 = old.track_head[t]; pos1; ref = BB) {
+            _tracking_BB_log_decode(_tracking_BB_log_at(&old, pos1 - 1), &ref, &BB, &pos1);
+            tracking_add_BB(BB_log, BB.rx, BB.ry, BB.bb_x, BB.bb_y, (uint16_t)t, BB.frame);
+        }
+    }
+    BB_log->max_frame = old.max_frame;
+
+    for (size_t c = 0; c < old.n_chunks; c++)
+        tools_arena_free(old.chunks[c]);
+    free(old.chunks);
+    free(old.chunks_size);
+    free(old.track_head);
+    free(old.track_tail);
+    free(old.track_n_BB);
+    free(old.track_last);
+}
+
+size_t tracking_flush_tracks(track_t* track_array, BB_log_t* BB_log, const size_t frame, FILE* f_tracks, FILE* f_BB,
+                             const int track_all, const int all) {
+    size_t n_removed = 0, n_removed_offset = 0;
+    size_t max_BBs = 0;
+    BB_t* BBs = NULL;
+    for (size_t i = 0; i < track_array->_size; i++) {
+        // the tracks ended in the two last frames are kept for the duplicates check of 'create_new_tracks'
+        const int is_done = (!track_array->id[i] || track_array->state[i] == TRACK_FINISHED) &&
+                            track_array->end[i].frame + 1 < frame;
+        if (all || is_done) {
+            if (track_array->id[i]) {
+                if (f_tracks)
+                    _tracking_track_write(f_tracks, track_array->id, track_array->begin, track_array->end,
+                                          track_array->obj_type, i);
+                track_array->_n_flushed_objects[track_array->obj_type[i]]++;
+                if (f_BB && (track_all || track_array->obj_type[i] == METEOR)) {
+                    const size_t n_BBs = tracking_get_track_n_BB(BB_log, (uint16_t)(i + 1));
+                    if (n_BBs > max_BBs) {
+                        max_BBs = n_BBs;
+                        BBs = (BB_t*)realloc(BBs, max_BBs * sizeof(BB_t));
+                    }
+                    tracking_get_track_BB(BB_log, (uint16_t)(i + 1), BBs);
+                    // sorted by frame, in a frame from the last inserted to the first one (as 'tracking_save_array_BB')
+                    for (size_t b = 1; b < n_BBs; b++) {
+                        const BB_t BB = BBs[b];
+                        size_t k = b;
+                        for (; k > 0 && BBs[k - 1].frame >= BB.frame; k--)
+                            BBs[k] = BBs[k - 1];
+                        BBs[k] = BB;
+                    }
+                    for (size_t b = 0; b < n_BBs; b++)
+                        fprintf(f_BB, "%lu %d %d %d %d %u \n", BBs[b].frame, BBs[b].rx, BBs[b].ry, BBs[b].bb_x,
+                                BBs[b].bb_y, track_array->id[i]);
+                }
+            }
+            _tracking_BB_log_drop(BB_log, (uint16_t)(i + 1));
+            n_removed++;
+            if (i < track_array->_offset)
+                n_removed_offset++;
+        } else if (n_removed) {
+            const size_t j = i - n_removed;
+            track_array->id[j] = track_array->id[i];
+            track_array->begin[j] = track_array->begin[i];
+            track_array->end[j] = track_array->end[i];
+            track_array->extrapol_x[j] = track_array->extrapol_x[i];
+            track_array->extrapol_y[j] = track_array->extrapol_y[i];
+            track_array->state[j] = track_array->state[i];
+            track_array->obj_type[j] = track_array->obj_type[i];
+            track_array->change_state_reason[j] = track_array->change_state_reason[i];
+            _tracking_BB_log_move(BB_log, (uint16_t)(i + 1), (uint16_t)(j + 1));
+        }
+    }
+    free(BBs);
+
+    track_array->_size -= n_removed;
+    track_array->_offset -= n_removed_offset;
+    track_array->_n_flushed += n_removed;
+    if (BB_log->_n_dropped * 2 > BB_log->_size)
+        _tracking_BB_log_compact(BB_log, track_array->_size);
+    return n_removed;
 }
 
 ROI_history_t* alloc_ROI_history(const size_t max_history_size, const size_t max_ROI_size) {
     ROI_history_t* ROI_hist = (ROI_history_t*)malloc(sizeof(ROI_history_t));
-    ROI_hist->_max_size = max_history_size;
-    ROI_hist->array = (ROI_light_t**)malloc(ROI_hist->_max_size * sizeof(ROI_light_t*));
-    ROI_hist->n_ROI = (uint32_t*)malloc(ROI_hist->_max_size * sizeof(uint32_t));
+    // the angle check reads the frame 't - 2'
+    ROI_hist->_max_size = MAX(max_history_size, 3);
+    ROI_hist->array = (ROI_hist_elmt_t**)calloc(ROI_hist->_max_size, sizeof(ROI_hist_elmt_t*));
+    ROI_hist->n_ROI = (uint32_t*)calloc(ROI_hist->_max_size, sizeof(uint32_t));
+    ROI_hist->_max_n_ROI_slot = (uint32_t*)calloc(ROI_hist->_max_size, sizeof(uint32_t));
     ROI_hist->_max_n_ROI = max_ROI_size;
-    for (size_t i = 0; i < ROI_hist->_max_size; i++)
-        ROI_hist->array[i] = (ROI_light_t*)malloc(max_ROI_size * sizeof(ROI_light_t));
+    ROI_hist->_head = 0;
+    ROI_hist->_size = 0;
     return ROI_hist;
 }
 
@@ -186,36 +475,185 @@ void free_ROI_history(ROI_history_t* ROI_hist) {
     for (size_t i = 0; i < ROI_hist->_max_size; i++)
         free(ROI_hist->array[i]);
     free(ROI_hist->array);
+    free(ROI_hist->n_ROI);
+    free(ROI_hist->_max_n_ROI_slot);
     free(ROI_hist);
 }
 
+static inline const ROI_hist_elmt_t* _ROI_history_get(const ROI_history_t* ROI_hist, const size_t age) {
+    return ROI_hist->array[(ROI_hist->_head + age) % ROI_hist->_max_size];
+}
+
+// Stores the ROIs of the current frame in the slot of age 0, the slot is only reallocated when it is too small
+static void _ROI_history_push(ROI_history_t* ROI_hist, const uint64_t* ROI_frame, const uint16_t* ROI_xmin,
+                              const uint16_t* ROI_xmax, const uint16_t* ROI_ymin, const uint16_t* ROI_ymax,
+                              const float* ROI_x, const float* ROI_y, const int32_t* ROI_prev_id, const size_t n_ROI) {
+    assert(n_ROI <= ROI_hist->_max_n_ROI);
+    const size_t h = ROI_hist->_head;
+    if (n_ROI > ROI_hist->_max_n_ROI_slot[h]) {
+        const uint32_t max_n_ROI = (uint32_t)MIN(MAX(n_ROI, 2 * (size_t)ROI_hist->_max_n_ROI_slot[h]),
+                                                 (size_t)ROI_hist->_max_n_ROI);
+        free(ROI_hist->array[h]);
+        ROI_hist->array[h] = (ROI_hist_elmt_t*)malloc(max_n_ROI * sizeof(ROI_hist_elmt_t));
+        ROI_hist->_max_n_ROI_slot[h] = max_n_ROI;
+    }
+    ROI_hist_elmt_t* slot = ROI_hist->array[h];
+    for (size_t i = 0; i < n_ROI; i++) {
+        slot[i].frame = ROI_frame[i];
+        slot[i].xmin = ROI_xmin[i];
+        slot[i].xmax = ROI_xmax[i];
+        slot[i].ymin = ROI_ymin[i];
+        slot[i].ymax = ROI_ymax[i];
+        slot[i].x = ROI_x[i];
+        slot[i].y = ROI_y[i];
+        slot[i].prev_id = ROI_prev_id[i];
+    }
+    ROI_hist->n_ROI[h] = n_ROI;
+    if (ROI_hist->_size < ROI_hist->_max_size)
+        ROI_hist->_size++;
+}
+
+// The slot of the oldest frame becomes the slot of the next frame
 void rotate_ROI_history(ROI_history_t* ROI_hist) {
-    ROI_light_t* last_ROI_tmp = ROI_hist->array[ROI_hist->_max_size -1];
-    for (int i = (int)(ROI_hist->_max_size -2); i >= 0; i--)
-        ROI_hist->array[i + 1] = ROI_hist->array[i];
-    ROI_hist->array[0] = last_ROI_tmp;
+    ROI_hist->_head = (ROI_hist->_head + ROI_hist->_max_size - 1) % ROI_hist->_max_size;
+}
+
+static ROI_grid_t* _ROI_grid_alloc() {
+    return (ROI_grid_t*)calloc(1, sizeof(ROI_grid_t)); // the buffers are allocated by the first build
+}
+
+static void _ROI_grid_free(ROI_grid_t* grid) {
+    free(grid->cell_start);
+    free(grid->ROI_ids);
+    free(grid->matches);
+    free(grid);
+}
+
+// Converts a coordinate to a column (or a row) of the grid, clamped to [0, 'n' - 1]
+static inline size_t _ROI_grid_coord(const float v, const float v0, const float inv_cell_size, const size_t n) {
+    const float c = (v - v0) * inv_cell_size;
+    if (!(c > 0.f))
+        return 0;
+    return c < (float)(n - 1) ? (size_t)c : n - 1;
+}
+
+// Builds the grid over the ROIs of centroids ('ROI_x', 'ROI_y') (only the ROIs without predecessor if 'ROI_prev_id' is
+// not NULL), the cells are at least 'cell_size' large and there are about as many cells as ROIs
+static void _ROI_grid_build(ROI_grid_t* grid, const float* ROI_x, const float* ROI_y, const int32_t* ROI_prev_id,
+                            const size_t n_ROI, const float cell_size) {
+    float x0 = 0.f, y0 = 0.f, x1 = 0.f, y1 = 0.f;
+    size_t n = 0;
+    for (size_t i = 0; i < n_ROI; i++)
+        if (!ROI_prev_id || !ROI_prev_id[i]) {
+            x0 = n ? MIN(x0, ROI_x[i]) : ROI_x[i];
+            y0 = n ? MIN(y0, ROI_y[i]) : ROI_y[i];
+            x1 = n ? MAX(x1, ROI_x[i]) : ROI_x[i];
+            y1 = n ? MAX(y1, ROI_y[i]) : ROI_y[i];
+            n++;
+        }
+
+    float size = MAX(cell_size, 1.f);
+    size_t n_cols, n_rows;
+    for (;;) {
+        n_cols = (size_t)((x1 - x0) * (1.f / size)) + 1;
+        n_rows = (size_t)((y1 - y0) * (1.f / size)) + 1;
+        if (n_cols * n_rows <= 2 * n + 16)
+            break;
+        size *= 2.f;
+    }
+    grid->x0 = x0;
+    grid->y0 = y0;
+    grid->inv_cell_size = 1.f / size;
+    grid->n_cols = n_cols;
+    grid->n_rows = n_rows;
+
+    const size_t n_cells = n_cols * n_rows;
+    if (n_cells + 1 > grid->_max_cells) {
+        grid->_max_cells = MAX(n_cells + 1, 2 * grid->_max_cells);
+        free(grid->cell_start);
+        grid->cell_start = (uint32_t*)malloc(grid->_max_cells * sizeof(uint32_t));
+    }
+    if (n_ROI > grid->_max_ROI) {
+        grid->_max_ROI = MAX(n_ROI, 2 * grid->_max_ROI);
+        free(grid->ROI_ids);
+        free(grid->matches);
+        grid->ROI_ids = (uint32_t*)malloc(grid->_max_ROI * sizeof(uint32_t));
+        grid->matches = (uint32_t*)malloc(grid->_max_ROI * sizeof(uint32_t));
+    }
+
+    // counting sort of the ROIs by cell
+    memset(grid->cell_start, 0, (n_cells + 1) * sizeof(uint32_t));
+    for (size_t i = 0; i < n_ROI; i++)
+        if (!ROI_prev_id || !ROI_prev_id[i]) {
+            const size_t c = _ROI_grid_coord(ROI_y[i], y0, grid->inv_cell_size, n_rows) * n_cols +
+                             _ROI_grid_coord(ROI_x[i], x0, grid->inv_cell_size, n_cols);
+            grid->cell_start[c + 1]++;
+        }
+    for (size_t c = 0; c < n_cells; c++)
+        grid->cell_start[c + 1] += grid->cell_start[c];
+    for (size_t i = 0; i < n_ROI; i++)
+        if (!ROI_prev_id || !ROI_prev_id[i]) {
+            const size_t c = _ROI_grid_coord(ROI_y[i], y0, grid->inv_cell_size, n_rows) * n_cols +
+                             _ROI_grid_coord(ROI_x[i], x0, grid->inv_cell_size, n_cols);
+            grid->ROI_ids[grid->cell_start[c]++] = (uint32_t)i;
+        }
+    for (size_t c = n_cells; c > 0; c--)
+        grid->cell_start[c] = grid->cell_start[c - 1];
+    grid->cell_start[0] = 0;
+    grid->is_built = 1;
 }
 
+// Finds the ROIs strictly inside the box ]'x_min', 'x_max'[ x ]'y_min', 'y_max'[ (as the linear scans of
+// '_update_existing_tracks'), 'grid->matches' contains their ids in increasing order. Returns their number
+static size_t _ROI_grid_query(ROI_grid_t* grid, const float* ROI_x, const float* ROI_y, const float x_min,
+                              const float x_max, const float y_min, const float y_max) {
+    if (!(x_min < x_max) || !(y_min < y_max))
+        return 0;
+    const size_t c0 = _ROI_grid_coord(x_min, grid->x0, grid->inv_cell_size, grid->n_cols);
+    const size_t c1 = _ROI_grid_coord(x_max, grid->x0, grid->inv_cell_size, grid->n_cols);
+    const size_t r0 = _ROI_grid_coord(y_min, grid->y0, grid->inv_cell_size, grid->n_rows);
+    const size_t r1 = _ROI_grid_coord(y_max, grid->y0, grid->inv_cell_size, grid->n_rows);
+    size_t n = 0;
+    for (size_t r = r0; r <= r1; r++)
+        for (size_t k = grid->cell_start[r * grid->n_cols + c0]; k < grid->cell_start[r * grid->n_cols + c1 + 1];
+             k++) {
+            const uint32_t j = grid->ROI_ids[k];
+            if (ROI_x[j] > x_min && ROI_x[j] < x_max && ROI_y[j] > y_min && ROI_y[j] < y_max) {
+                size_t m = n++;
+                for (; m > 0 && grid->matches[m - 1] > j; m--)
+                    grid->matches[m] = grid->matches[m - 1];
+                grid->matches[m] = j;
+            }
+        }
+    return n;
+}
 
 tracking_data_t* tracking_alloc_data(const size_t max_history_size, const size_t max_ROI_size) {
     tracking_data_t* tracking_data = (tracking_data_t*)malloc(sizeof(tracking_data_t));
     tracking_data->ROI_history = alloc_ROI_history(max_history_size, max_ROI_size);
     // tracking_data->ROI_list = features_alloc_ROI_array(max_history_size);
-    tracking_data->ROI_list = (ROI_light_t*)malloc(max_history_size * sizeof(ROI_light_t));
+    tracking_data->ROI_list = (ROI_light_t*)malloc(tracking_data->ROI_history->_max_size * sizeof(ROI_light_t));
+    tracking_data->ROI0_grid = _ROI_grid_alloc();
+    tracking_data->ROI1_grid = _ROI_grid_alloc();
     return tracking_data;
 }
 
 void tracking_init_data(tracking_data_t* tracking_data) {
     memset(tracking_data->ROI_list, 0, tracking_data->ROI_history->_max_size * sizeof(ROI_light_t));
-    for (size_t i = 0; i < tracking_data->ROI_history->_max_size; i++)
-        memset(tracking_data->ROI_history->array[i], 0, tracking_data->ROI_history->_max_n_ROI * sizeof(ROI_light_t));
+    // the slots are not cleared: a ROI of the history is only read through the 'prev_id' of a ROI of the next frame
+    memset(tracking_data->ROI_history->n_ROI, 0, tracking_data->ROI_history->_max_size * sizeof(uint32_t));
+    tracking_data->ROI_history->_head = 0;
     tracking_data->ROI_history->_size = 0;
+    tracking_data->ROI0_grid->is_built = 0;
+    tracking_data->ROI1_grid->is_built = 0;
 }
 
 void tracking_free_data(tracking_data_t* tracking_data) {
     free_ROI_history(tracking_data->ROI_history);
     // features_free_ROI_array(tracking_data->ROI_list);
     free(tracking_data->ROI_list);
+    _ROI_grid_free(tracking_data->ROI0_grid);
+    _ROI_grid_free(tracking_data->ROI1_grid);
     free(tracking_data);
 }
 
@@ -236,8 +674,8 @@ void track_extrapolate(track_t* track_array, const size_t t, double theta, doubl
     _track_extrapolate(&track_array->end[t], &track_array->extrapol_x[t], &track_array->extrapol_y[t], theta, tx, ty);
 }
 
-void _update_bounding_box(BB_t** BB_array, const int track_id, const uint16_t ROI_xmin, const uint16_t ROI_xmax,
-                          const uint16_t ROI_ymin, const uint16_t ROI_ymax, int frame) {
+void _update_bounding_box(BB_log_t* BB_log, const int track, const uint16_t ROI_xmin, const uint16_t ROI_xmax,
+                          const uint16_t ROI_ymin, const uint16_t ROI_ymax, const size_t frame) {
     assert(ROI_xmin || ROI_xmax || ROI_ymin || ROI_ymax);
 
     uint16_t bb_x = (uint16_t)ceil((double)((ROI_xmin + ROI_xmax)) / 2);
@@ -245,15 +683,16 @@ void _update_bounding_box(BB_t** BB_array, const int track_id, const uint16_t RO
     uint16_t rx = (bb_x - ROI_xmin);
     uint16_t ry = (bb_y - ROI_ymin);
 
-    add_to_BB_array(BB_array, rx, ry, bb_x, bb_y, track_id, frame - 1);
+    tracking_add_BB(BB_log, rx, ry, bb_x, bb_y, track, frame - 1);
 }
 
-void update_bounding_box(BB_t** BB_array, const int track_id, const ROI_t* ROI_array, const size_t r, int frame) {
-    _update_bounding_box(BB_array, track_id, ROI_array->xmin[r], ROI_array->xmax[r], ROI_array->ymin[r],
+void update_bounding_box(BB_log_t* BB_log, const int track, const ROI_t* ROI_array, const size_t r,
+                         const size_t frame) {
+    _update_bounding_box(BB_log, track, ROI_array->xmin[r], ROI_array->xmax[r], ROI_array->ymin[r],
                          ROI_array->ymax[r], frame);
 }
 
-void _light_copy_elmt_ROI_array(const uint16_t* ROI_src_id, const uint32_t* ROI_src_frame, const uint16_t* ROI_src_xmin,
+void _light_copy_elmt_ROI_array(const uint16_t* ROI_src_id, const uint64_t* ROI_src_frame, const uint16_t* ROI_src_xmin,
                                 const uint16_t* ROI_src_xmax, const uint16_t* ROI_src_ymin,
                                 const uint16_t* ROI_src_ymax, const float* ROI_src_x, const float* ROI_src_y,
                                 const int32_t* ROI_src_prev_id, const int32_t* ROI_src_next_id, const size_t i_src,
@@ -277,18 +716,19 @@ void light_copy_elmt_ROI_array(const ROI_t* ROI_array_src, ROI_light_t* ROI_arra
                                ROI_array_src->prev_id, ROI_array_src->next_id, i_src, ROI_array_dest, i_dest);
 }
 
-void _update_existing_tracks(const ROI_light_t** ROI_hist, const uint16_t* ROI0_id, const uint32_t* ROI0_frame,
+void _update_existing_tracks(const ROI_history_t* ROI_hist, ROI_grid_t* ROI0_grid, ROI_grid_t* ROI1_grid,
+                             const uint16_t* ROI0_id, const uint64_t* ROI0_frame,
                              const uint16_t* ROI0_xmin, const uint16_t* ROI0_xmax, const uint16_t* ROI0_ymin,
                              const uint16_t* ROI0_ymax, const float* ROI0_x, const float* ROI0_y,
                              const int32_t* ROI0_prev_id, const int32_t* ROI0_next_id, const size_t n_ROI0,
-                             const uint16_t* ROI1_id, const uint32_t* ROI1_frame, const uint16_t* ROI1_xmin,
+                             const uint16_t* ROI1_id, const uint64_t* ROI1_frame, const uint16_t* ROI1_xmin,
                              const uint16_t* ROI1_xmax, const uint16_t* ROI1_ymin, const uint16_t* ROI1_ymax,
                              const float* ROI1_x, const float* ROI1_y, const int32_t* ROI1_prev_id,
-                             uint8_t* ROI1_is_extrapolated, const size_t n_ROI1, uint16_t* track_id,
+                             uint8_t* ROI1_is_extrapolated, const size_t n_ROI1, uint32_t* track_id,
                              const ROI_light_t* track_begin, ROI_light_t* track_end, float* track_extrapol_x,
                              float* track_extrapol_y, enum state_e* track_state, enum obj_e* track_obj_type,
                              enum change_state_reason_e* track_change_state_reason, size_t* offset_tracks,
-                             const size_t n_tracks, BB_t** BB_array, size_t frame, double theta, double tx, double ty,
+                             const size_t n_tracks, BB_log_t* BB_log, size_t frame, double theta, double tx, double ty,
                              size_t r_extrapol, float angle_max, int track_all, size_t fra_meteor_max) {
     for (size_t i = *offset_tracks; i < n_tracks; i++) {
         int next_id = track_end[i].next_id;
@@ -299,32 +739,30 @@ void _update_existing_tracks(const ROI_light_t** ROI_hist, const uint16_t* ROI0_
     }
     for (size_t i = *offset_tracks; i < n_tracks; i++) {
         if (track_id[i] && track_state[i] != TRACK_FINISHED) {
+            // the ROIs around the extrapolated position are found with a grid instead of scanning all the ROIs
+            const float x_min = track_extrapol_x[i] - r_extrapol, x_max = track_extrapol_x[i] + r_extrapol;
+            const float y_min = track_extrapol_y[i] - r_extrapol, y_max = track_extrapol_y[i] + r_extrapol;
             if (track_state[i] == TRACK_EXTRAPOLATED) {
-                for (size_t j = 0; j < n_ROI0; j++) {
-                    if ((ROI0_x[j] > track_extrapol_x[i] - r_extrapol) &&
-                        (ROI0_x[j] < track_extrapol_x[i] + r_extrapol) &&
-                        (ROI0_y[j] < track_extrapol_y[i] + r_extrapol) &&
-                        (ROI0_y[j] > track_extrapol_y[i] - r_extrapol)) {
-                        _light_copy_elmt_ROI_array(ROI0_id, ROI0_frame, ROI0_xmin, ROI0_xmax, ROI0_ymin, ROI0_ymax,
-                                                   ROI0_x, ROI0_y, ROI0_prev_id, ROI0_next_id, j, track_end, i);
-                        track_state[i] = TRACK_UPDATED;
-                        // update_bounding_box(BB_array, track_id[i], ROI_array0, j, frame - 1);
-                        _update_bounding_box(BB_array, track_id[i], ROI0_xmin[j], ROI0_xmax[j], ROI0_ymin[j],
-                                             ROI0_ymax[j], frame - 1);
-                    }
+                if (!ROI0_grid->is_built)
+                    _ROI_grid_build(ROI0_grid, ROI0_x, ROI0_y, NULL, n_ROI0, (float)r_extrapol);
+                const size_t n_matches = _ROI_grid_query(ROI0_grid, ROI0_x, ROI0_y, x_min, x_max, y_min, y_max);
+                for (size_t m = 0; m < n_matches; m++) {
+                    const size_t j = ROI0_grid->matches[m];
+                    _light_copy_elmt_ROI_array(ROI0_id, ROI0_frame, ROI0_xmin, ROI0_xmax, ROI0_ymin, ROI0_ymax, ROI0_x,
+                                               ROI0_y, ROI0_prev_id, ROI0_next_id, j, track_end, i);
+                    track_state[i] = TRACK_UPDATED;
+                    // update_bounding_box(BB_log, i + 1, ROI_array0, j, frame - 1);
+                    _update_bounding_box(BB_log, i + 1, ROI0_xmin[j], ROI0_xmax[j], ROI0_ymin[j], ROI0_ymax[j],
+                                         frame - 1);
                 }
             }
             if (track_state[i] == TRACK_LOST) {
-                for (size_t j = 0; j < n_ROI1; j++) {
-                    if (!ROI1_prev_id[j]) {
-                        if ((ROI1_x[j] > track_extrapol_x[i] - r_extrapol) &&
-                            (ROI1_x[j] < track_extrapol_x[i] + r_extrapol) &&
-                            (ROI1_y[j] < track_extrapol_y[i] + r_extrapol) &&
-                            (ROI1_y[j] > track_extrapol_y[i] - r_extrapol)) {
-                            track_state[i] = TRACK_EXTRAPOLATED;
-                            ROI1_is_extrapolated[j] = 1;
-                        }
-                    }
+                if (!ROI1_grid->is_built)
+                    _ROI_grid_build(ROI1_grid, ROI1_x, ROI1_y, ROI1_prev_id, n_ROI1, (float)r_extrapol);
+                const size_t n_matches = _ROI_grid_query(ROI1_grid, ROI1_x, ROI1_y, x_min, x_max, y_min, y_max);
+                for (size_t m = 0; m < n_matches; m++) {
+                    track_state[i] = TRACK_EXTRAPOLATED;
+                    ROI1_is_extrapolated[ROI1_grid->matches[m]] = 1;
                 }
                 if (track_state[i] != TRACK_EXTRAPOLATED)
                     track_state[i] = TRACK_FINISHED;
@@ -335,10 +773,11 @@ void _update_existing_tracks(const ROI_light_t** ROI_hist, const uint16_t* ROI0_
                     if (track_obj_type[i] == METEOR) {
                         if (ROI0_prev_id[track_end[i].id - 1]) {
                             int k = ROI0_prev_id[track_end[i].id - 1] - 1;
-                            float u_x = ROI0_x[track_end[i].id - 1] - ROI_hist[0][k].x;
-                            float u_y = ROI0_y[track_end[i].id - 1] - ROI_hist[0][k].y;
-                            float v_x = ROI1_x[next_id - 1] - ROI_hist[0][k].x;
-                            float v_y = ROI1_y[next_id - 1] - ROI_hist[0][k].y;
+                            const ROI_hist_elmt_t* ROI2 = &_ROI_history_get(ROI_hist, 2)[k];
+                            float u_x = ROI0_x[track_end[i].id - 1] - ROI2->x;
+                            float u_y = ROI0_y[track_end[i].id - 1] - ROI2->y;
+                            float v_x = ROI1_x[next_id - 1] - ROI2->x;
+                            float v_y = ROI1_y[next_id - 1] - ROI2->y;
                             float scalar_prod_uv = u_x * v_x + u_y * v_y;
                             float norm_u = sqrtf(u_x * u_x + u_y * u_y);
                             float norm_v = sqrtf(v_x * v_x + v_y * v_y);
@@ -364,8 +803,8 @@ void _update_existing_tracks(const ROI_light_t** ROI_hist, const uint16_t* ROI0_
                                                ROI1_y, ROI1_prev_id, ROI1_next_id, next_id - 1, track_end, i);
                     if (track_state[i] == TRACK_NEW) // because the right time has been set in 'insert_new_track'
                         track_state[i] = TRACK_UPDATED;
-                    // update_bounding_box(BB_array, track_id[i], ROI_array1, next_id - 1, frame + 1);
-                    _update_bounding_box(BB_array, track_id[i], ROI1_xmin[next_id - 1], ROI1_xmax[next_id - 1],
+                    // update_bounding_box(BB_log, i + 1, ROI_array1, next_id - 1, frame + 1);
+                    _update_bounding_box(BB_log, i + 1, ROI1_xmin[next_id - 1], ROI1_xmax[next_id - 1],
                                          ROI1_ymin[next_id - 1], ROI1_ymax[next_id - 1], frame + 1);
                 } else {
                     // on extrapole si pas finished
@@ -385,26 +824,31 @@ void _update_existing_tracks(const ROI_light_t** ROI_hist, const uint16_t* ROI0_
     }
 }
 
-void update_existing_tracks(const ROI_light_t** ROI_hist, const ROI_t* ROI_array0, ROI_t* ROI_array1,
-                            track_t* track_array, BB_t** BB_array, size_t frame, double theta, double tx, double ty,
-                            size_t r_extrapol, float angle_max, int track_all, size_t fra_meteor_max) {
-    _update_existing_tracks(ROI_hist, ROI_array0->id, ROI_array0->frame, ROI_array0->xmin, ROI_array0->xmax,
-                            ROI_array0->ymin, ROI_array0->ymax, ROI_array0->x, ROI_array0->y, ROI_array0->prev_id,
-                            ROI_array0->next_id, ROI_array0->_size, ROI_array1->id, ROI_array1->frame, ROI_array1->xmin,
-                            ROI_array1->xmax, ROI_array1->ymin, ROI_array1->ymax, ROI_array1->x, ROI_array1->y,
-                            ROI_array1->prev_id, ROI_array1->is_extrapolated, ROI_array1->_size, track_array->id,
-                            track_array->begin, track_array->end, track_array->extrapol_x, track_array->extrapol_y,
-                            track_array->state, track_array->obj_type, track_array->change_state_reason,
-                            &track_array->_offset, track_array->_size, BB_array, frame, theta, tx, ty, r_extrapol,
-                            angle_max, track_all, fra_meteor_max);
+void update_existing_tracks(const ROI_history_t* ROI_hist, ROI_grid_t* ROI0_grid, ROI_grid_t* ROI1_grid,
+                            const ROI_t* ROI_array0, ROI_t* ROI_array1, track_t* track_array, BB_log_t* BB_log,
+                            size_t frame, double theta, double tx, double ty, size_t r_extrapol, float angle_max,
+                            int track_all, size_t fra_meteor_max) {
+    _update_existing_tracks(ROI_hist, ROI0_grid, ROI1_grid, ROI_array0->id, ROI_array0->frame, ROI_array0->xmin,
+                            ROI_array0->xmax, ROI_array0->ymin, ROI_array0->ymax, ROI_array0->x, ROI_array0->y,
+                            ROI_array0->prev_id, ROI_array0->next_id, ROI_array0->_size, ROI_array1->id,
+                            ROI_array1->frame, ROI_array1->xmin, ROI_array1->xmax, ROI_array1->ymin, ROI_array1->ymax,
+                            ROI_array1->x, ROI_array1->y, ROI_array1->prev_id, ROI_array1->is_extrapolated,
+                            ROI_array1->_size, track_array->id, track_array->begin, track_array->end,
+                            track_array->extrapol_x, track_array->extrapol_y, track_array->state, track_array->obj_type,
+                            track_array->change_state_reason, &track_array->_offset, track_array->_size, BB_log, frame,
+                            theta, tx, ty, r_extrapol, angle_max, track_all, fra_meteor_max);
 }
 
-void _insert_new_track(const ROI_light_t* ROI_list, unsigned n_ROI, uint16_t* track_id, ROI_light_t* track_begin,
-                       ROI_light_t* track_end, enum state_e* track_state, enum obj_e* track_obj_type, size_t* n_tracks,
-                       BB_t** BB_array, int frame, enum obj_e type) {
+// Returns 0 (and the track is not inserted) if there are already 'max_tracks' tracks
+int _insert_new_track(const ROI_light_t* ROI_list, unsigned n_ROI, uint32_t* track_id, ROI_light_t* track_begin,
+                      ROI_light_t* track_end, enum state_e* track_state, enum obj_e* track_obj_type, size_t* n_tracks,
+                      const size_t max_tracks, const size_t n_flushed_tracks, BB_log_t* BB_log, size_t frame,
+                      enum obj_e type) {
     assert(n_ROI >= 1);
+    if (*n_tracks >= max_tracks)
+        return 0;
     size_t cur_track = *n_tracks;
-    track_id[cur_track] = cur_track + 1;
+    track_id[cur_track] = n_flushed_tracks + cur_track + 1;
     // light_copy_elmt_ROI_array(ROI_list, track_begin, n_ROI - 1, cur_track);
     memcpy(&track_begin[cur_track], &ROI_list[n_ROI - 1], sizeof(ROI_light_t));
     // light_copy_elmt_ROI_array(ROI_list, track_end, 0, cur_track);
@@ -412,47 +856,60 @@ void _insert_new_track(const ROI_light_t* ROI_list, unsigned n_ROI, uint16_t* tr
     track_state[cur_track] = TRACK_NEW;
     track_obj_type[cur_track] = type;
     for (unsigned n = 0; n < n_ROI; n++)
-        _update_bounding_box(BB_array, track_id[cur_track], ROI_list[n].xmin, ROI_list[n].xmax, ROI_list[n].ymin,
+        _update_bounding_box(BB_log, cur_track + 1, ROI_list[n].xmin, ROI_list[n].xmax, ROI_list[n].ymin,
                              ROI_list[n].ymax, frame - n);
     (*n_tracks)++;
+    return 1;
 }
 
-void insert_new_track(const ROI_light_t* ROI_list, unsigned n_ROI, track_t* track_array, BB_t** BB_array,
-                      int frame, enum obj_e type) {
-    assert(track_array->_size < track_array->_max_size);
-    _insert_new_track(ROI_list, n_ROI, track_array->id, track_array->begin, track_array->end, track_array->state,
-                      track_array->obj_type,  &track_array->_size, BB_array, frame, type);
+int insert_new_track(const ROI_light_t* ROI_list, unsigned n_ROI, track_t* track_array, BB_log_t* BB_log,
+                     size_t frame, enum obj_e type) {
+    return _insert_new_track(ROI_list, n_ROI, track_array->id, track_array->begin, track_array->end,
+                             track_array->state, track_array->obj_type, &track_array->_size, track_array->_max_size,
+                             track_array->_n_flushed, BB_log, frame, type);
 }
 
-void _fill_ROI_list(const ROI_light_t** ROI_hist, ROI_light_t* ROI_list, const uint16_t* ROI_id,
-                    const uint32_t* ROI_frame, const uint16_t* ROI_xmin, const uint16_t* ROI_xmax,
+void _fill_ROI_list(const ROI_history_t* ROI_hist, ROI_light_t* ROI_list, const uint16_t* ROI_id,
+                    const uint64_t* ROI_frame, const uint16_t* ROI_xmin, const uint16_t* ROI_xmax,
                     const uint16_t* ROI_ymin, const uint16_t* ROI_ymax, const float* ROI_x, const float* ROI_y,
                     const int32_t* ROI_prev_id, const int32_t* ROI_next_id, const size_t n_ROI, const size_t r) {
     _light_copy_elmt_ROI_array(ROI_id, ROI_frame, ROI_xmin, ROI_xmax, ROI_ymin, ROI_ymax, ROI_x, ROI_y, ROI_prev_id,
                                ROI_next_id, r, ROI_list, 0);
-    for (size_t i = 1; i < n_ROI; i++)
-        // light_copy_elmt_ROI_array(ROI_hist[i - 1], ROI_list, ROI_list->prev_id[i - 1] - 1, i);
-        memcpy(&ROI_list[i], &ROI_hist[i - 1][ROI_list[i - 1].prev_id - 1], sizeof(ROI_light_t));
+    for (size_t i = 1; i < n_ROI; i++) {
+        // 'ROI_list[i - 1]' is in the frame 't - i', its previous ROI in the frame 't - i - 1'
+        const ROI_hist_elmt_t* ROI_prev = &_ROI_history_get(ROI_hist, i + 1)[ROI_list[i - 1].prev_id - 1];
+        memset(&ROI_list[i], 0, sizeof(ROI_light_t));
+        ROI_list[i].frame = ROI_prev->frame;
+        ROI_list[i].xmin = ROI_prev->xmin;
+        ROI_list[i].xmax = ROI_prev->xmax;
+        ROI_list[i].ymin = ROI_prev->ymin;
+        ROI_list[i].ymax = ROI_prev->ymax;
+        ROI_list[i].x = ROI_prev->x;
+        ROI_list[i].y = ROI_prev->y;
+        ROI_list[i].prev_id = ROI_prev->prev_id;
+    }
 }
 
-void fill_ROI_list(const ROI_light_t** ROI_hist, ROI_light_t* ROI_list, const ROI_t* ROI_array, const size_t n_ROI,
+void fill_ROI_list(const ROI_history_t* ROI_hist, ROI_light_t* ROI_list, const ROI_t* ROI_array, const size_t n_ROI,
                    const size_t r) {
     _fill_ROI_list(ROI_hist, ROI_list, ROI_array->id, ROI_array->frame, ROI_array->xmin, ROI_array->xmax,
                    ROI_array->ymin, ROI_array->ymax, ROI_array->x, ROI_array->y, ROI_array->prev_id, ROI_array->next_id,
                    n_ROI, r);
 }
 
-void _create_new_tracks(const ROI_light_t** ROI_hist, ROI_light_t* ROI_list, const uint16_t* ROI0_id,
-                        const uint32_t* ROI0_frame, const uint16_t* ROI0_xmin, const uint16_t* ROI0_xmax,
+void _create_new_tracks(const ROI_history_t* ROI_hist, ROI_light_t* ROI_list, const uint16_t* ROI0_id,
+                        const uint64_t* ROI0_frame, const uint16_t* ROI0_xmin, const uint16_t* ROI0_xmax,
                         const uint16_t* ROI0_ymin, const uint16_t* ROI0_ymax, const float* ROI0_x, const float* ROI0_y,
                         const float* ROI0_error, const int32_t* ROI0_prev_id, const int32_t* ROI0_next_id,
                         const int32_t* ROI0_time, const int32_t* ROI0_time_motion, const uint8_t* ROI0_is_extrapolated,
-                        const size_t n_ROI0, int32_t* ROI1_time, int32_t* ROI1_time_motion, uint16_t* track_id,
+                        const size_t n_ROI0, int32_t* ROI1_time, int32_t* ROI1_time_motion, uint32_t* track_id,
                         ROI_light_t* track_begin, ROI_light_t* track_end, enum state_e* track_state,
-                        enum obj_e* track_obj_type, const size_t offset_tracks, size_t* n_tracks, BB_t** BB_array,
-                        size_t frame, double mean_error, double std_deviation, float diff_dev, int track_all,
-                        size_t fra_star_min, size_t fra_meteor_min)
+                        enum obj_e* track_obj_type, const size_t offset_tracks, size_t* n_tracks,
+                        const size_t max_tracks, const size_t n_flushed_tracks, BB_log_t* BB_log, size_t frame,
+                        double mean_error, double std_deviation, float diff_dev, int track_all, size_t fra_star_min,
+                        size_t fra_meteor_min)
 {
+    unsigned n_refused = 0;
     for (size_t i = 0; i < n_ROI0; i++) {
         float e = ROI0_error[i];
         int asso = ROI0_next_id[i];
@@ -489,94 +946,70 @@ void _create_new_tracks(const ROI_light_t** ROI_hist, ROI_light_t* ROI_list, con
                         // ROI_list->_size = fra_min - 1;
                         _fill_ROI_list(ROI_hist, ROI_list, ROI0_id, ROI0_frame, ROI0_xmin, ROI0_xmax, ROI0_ymin,
                                        ROI0_ymax, ROI0_x, ROI0_y, ROI0_prev_id, ROI0_next_id, fra_min - 1, i);
-                        _insert_new_track(ROI_list, fra_min - 1, track_id, track_begin, track_end, track_state,
-                                          track_obj_type, n_tracks, BB_array, frame, is_new_meteor ? METEOR : STAR);
+                        if (!_insert_new_track(ROI_list, fra_min - 1, track_id, track_begin, track_end,
+                                               track_state, track_obj_type, n_tracks, max_tracks, n_flushed_tracks,
+                                               BB_log, frame, is_new_meteor ? METEOR : STAR))
+                            n_refused++;
                     }
                 }
             }
         }
     }
+    if (n_refused)
+        fprintf(stderr, "(WW) The array of tracks is full (%lu tracks): %u new track(s) ignored in the frame %lu.\n",
+                (unsigned long)max_tracks, n_refused, (unsigned long)frame);
 }
 
-void create_new_tracks(const ROI_light_t** ROI_hist, ROI_light_t* ROI_list, const ROI_t* ROI_array0, ROI_t* ROI_array1,
-                       track_t* track_array, BB_t** BB_array, size_t frame, double mean_error, double std_deviation,
+void create_new_tracks(const ROI_history_t* ROI_hist, ROI_light_t* ROI_list, const ROI_t* ROI_array0, ROI_t* ROI_array1,
+                       track_t* track_array, BB_log_t* BB_log, size_t frame, double mean_error, double std_deviation,
                        float diff_dev, int track_all, size_t fra_star_min, size_t fra_meteor_min) {
     _create_new_tracks(ROI_hist, ROI_list, ROI_array0->id, ROI_array0->frame, ROI_array0->xmin, ROI_array0->xmax,
                        ROI_array0->ymin, ROI_array0->ymax, ROI_array0->x, ROI_array0->y, ROI_array0->error,
                        ROI_array0->prev_id, ROI_array0->next_id, ROI_array0->time, ROI_array0->time_motion,
                        ROI_array0->is_extrapolated, ROI_array0->_size, ROI_array1->time, ROI_array1->time_motion,
                        track_array->id, track_array->begin, track_array->end, track_array->state, track_array->obj_type,
-                       track_array->_offset, &track_array->_size, BB_array, frame, mean_error, std_deviation, diff_dev,
-                       track_all, fra_star_min, fra_meteor_min);
-}
-
-void _light_copy_ROI_array(const uint16_t* ROI_src_id, const uint32_t* ROI_src_frame, const uint16_t* ROI_src_xmin,
-                           const uint16_t* ROI_src_xmax, const uint16_t* ROI_src_ymin, const uint16_t* ROI_src_ymax,
-                           const float* ROI_src_x, const float* ROI_src_y, const int32_t* ROI_src_time,
-                           const int32_t* ROI_src_time_motion, const int32_t* ROI_src_prev_id,
-                           const uint8_t* ROI_src_is_extrapolated, const size_t n_ROI_src, ROI_light_t* ROI_dest) {
-    for (size_t i = 0; i < n_ROI_src; i++) {
-        ROI_dest[i].id = ROI_src_id[i];
-        ROI_dest[i].frame = ROI_src_frame[i];
-        ROI_dest[i].xmin = ROI_src_xmin[i];
-        ROI_dest[i].xmax = ROI_src_xmax[i];
-        ROI_dest[i].ymin = ROI_src_ymin[i];
-        ROI_dest[i].ymax = ROI_src_ymax[i];
-        ROI_dest[i].x = ROI_src_x[i];
-        ROI_dest[i].y = ROI_src_y[i];
-        ROI_dest[i].time = ROI_src_time[i];
-        ROI_dest[i].time_motion = ROI_src_time_motion[i];
-        ROI_dest[i].prev_id = ROI_src_prev_id[i];
-        ROI_dest[i].is_extrapolated = ROI_src_is_extrapolated[i];
-    }
-}
-
-void light_copy_ROI_array(const ROI_t* ROI_array_src, ROI_light_t* ROI_array_dest) {
-    _light_copy_ROI_array(ROI_array_src->id, ROI_array_src->frame, ROI_array_src->xmin, ROI_array_src->xmax,
-                          ROI_array_src->ymin, ROI_array_src->ymax, ROI_array_src->x, ROI_array_src->y,
-                          ROI_array_src->time, ROI_array_src->time_motion, ROI_array_src->prev_id,
-                          ROI_array_src->is_extrapolated, ROI_array_src->_size, ROI_array_dest);
+                       track_array->_offset, &track_array->_size, track_array->_max_size, track_array->_n_flushed,
+                       BB_log, frame, mean_error, std_deviation, diff_dev, track_all, fra_star_min, fra_meteor_min);
 }
 
-void _tracking_perform(tracking_data_t* tracking_data, const uint16_t* ROI0_id, const uint32_t* ROI0_frame,
+void _tracking_perform(tracking_data_t* tracking_data, const uint16_t* ROI0_id, const uint64_t* ROI0_frame,
                        const uint16_t* ROI0_xmin, const uint16_t* ROI0_xmax, const uint16_t* ROI0_ymin,
                        const uint16_t* ROI0_ymax, const float* ROI0_x, const float* ROI0_y, const float* ROI0_error,
                        const int32_t* ROI0_time, const int32_t* ROI0_time_motion, const int32_t* ROI0_prev_id,
                        const int32_t* ROI0_next_id, const uint8_t* ROI0_is_extrapolated, const size_t n_ROI0,
-                       const uint16_t* ROI1_id, const uint32_t* ROI1_frame, const uint16_t* ROI1_xmin,
+                       const uint16_t* ROI1_id, const uint64_t* ROI1_frame, const uint16_t* ROI1_xmin,
                        const uint16_t* ROI1_xmax, const uint16_t* ROI1_ymin, const uint16_t* ROI1_ymax,
                        const float* ROI1_x, const float* ROI1_y, int32_t* ROI1_time, int32_t* ROI1_time_motion,
                        const int32_t* ROI1_prev_id, uint8_t* ROI1_is_extrapolated, const size_t n_ROI1,
-                       uint16_t* track_id, ROI_light_t* track_begin, ROI_light_t* track_end, float* track_extrapol_x,
+                       uint32_t* track_id, ROI_light_t* track_begin, ROI_light_t* track_end, float* track_extrapol_x,
                        float* track_extrapol_y, enum state_e* track_state, enum obj_e* track_obj_type,
                        enum change_state_reason_e* track_change_state_reason, size_t* offset_tracks, size_t* n_tracks,
-                       BB_t** BB_array, size_t frame, double theta, double tx, double ty, double mean_error,
-                       double std_deviation, size_t r_extrapol, float angle_max, float diff_dev, int track_all,
-                       size_t fra_star_min, size_t fra_meteor_min, size_t fra_meteor_max) {
-    tracking_data->ROI_history->n_ROI[0] = n_ROI1;
-    _light_copy_ROI_array(ROI1_id, ROI1_frame, ROI1_xmin, ROI1_xmax, ROI1_ymin, ROI1_ymax, ROI1_x, ROI1_y, ROI1_time,
-                          ROI1_time_motion, ROI1_prev_id, ROI1_is_extrapolated, n_ROI1,
-                          tracking_data->ROI_history->array[0]);
-    if (tracking_data->ROI_history->_size < tracking_data->ROI_history->_max_size)
-        tracking_data->ROI_history->_size++;
-    _create_new_tracks((const ROI_light_t**)&tracking_data->ROI_history->array[2], tracking_data->ROI_list, ROI0_id,
-                       ROI0_frame, ROI0_xmin, ROI0_xmax, ROI0_ymin, ROI0_ymax, ROI0_x, ROI0_y, ROI0_error, ROI0_prev_id,
-                       ROI0_next_id, ROI0_time, ROI0_time_motion, ROI0_is_extrapolated, n_ROI0, ROI1_time,
-                       ROI1_time_motion, track_id, track_begin, track_end, track_state, track_obj_type, *offset_tracks,
-                       n_tracks, BB_array, frame, mean_error, std_deviation, diff_dev, track_all, fra_star_min,
+                       const size_t max_tracks, const size_t n_flushed_tracks, BB_log_t* BB_log, size_t frame,
+                       double theta, double tx, double ty, double mean_error, double std_deviation,
+                       size_t r_extrapol, float angle_max, float diff_dev, int track_all, size_t fra_star_min,
+                       size_t fra_meteor_min, size_t fra_meteor_max) {
+    _ROI_history_push(tracking_data->ROI_history, ROI1_frame, ROI1_xmin, ROI1_xmax, ROI1_ymin, ROI1_ymax, ROI1_x,
+                      ROI1_y, ROI1_prev_id, n_ROI1);
+    _create_new_tracks(tracking_data->ROI_history, tracking_data->ROI_list, ROI0_id, ROI0_frame, ROI0_xmin, ROI0_xmax,
+                       ROI0_ymin, ROI0_ymax, ROI0_x, ROI0_y, ROI0_error, ROI0_prev_id, ROI0_next_id, ROI0_time,
+                       ROI0_time_motion, ROI0_is_extrapolated, n_ROI0, ROI1_time, ROI1_time_motion, track_id,
+                       track_begin, track_end, track_state, track_obj_type, *offset_tracks, n_tracks, max_tracks,
+                       n_flushed_tracks, BB_log, frame, mean_error, std_deviation, diff_dev, track_all, fra_star_min,
                        fra_meteor_min);
-    _update_existing_tracks((const ROI_light_t**)&tracking_data->ROI_history->array[2], ROI0_id, ROI0_frame, ROI0_xmin,
-                            ROI0_xmax, ROI0_ymin, ROI0_ymax, ROI0_x, ROI0_y, ROI0_prev_id, ROI0_next_id, n_ROI0,
-                            ROI1_id, ROI1_frame, ROI1_xmin, ROI1_xmax, ROI1_ymin, ROI1_ymax, ROI1_x, ROI1_y,
-                            ROI1_prev_id, ROI1_is_extrapolated, n_ROI1, track_id, track_begin, track_end,
-                            track_extrapol_x, track_extrapol_y, track_state, track_obj_type, track_change_state_reason,
-                            offset_tracks, *n_tracks, BB_array, frame, theta, tx, ty, r_extrapol, angle_max, track_all,
-                            fra_meteor_max);
+    tracking_data->ROI0_grid->is_built = 0;
+    tracking_data->ROI1_grid->is_built = 0;
+    _update_existing_tracks(tracking_data->ROI_history, tracking_data->ROI0_grid, tracking_data->ROI1_grid, ROI0_id,
+                            ROI0_frame, ROI0_xmin, ROI0_xmax, ROI0_ymin, ROI0_ymax, ROI0_x, ROI0_y, ROI0_prev_id,
+                            ROI0_next_id, n_ROI0, ROI1_id, ROI1_frame, ROI1_xmin, ROI1_xmax, ROI1_ymin, ROI1_ymax,
+                            ROI1_x, ROI1_y, ROI1_prev_id, ROI1_is_extrapolated, n_ROI1, track_id, track_begin,
+                            track_end, track_extrapol_x, track_extrapol_y, track_state, track_obj_type,
+                            track_change_state_reason, offset_tracks, *n_tracks, BB_log, frame, theta, tx, ty,
+                            r_extrapol, angle_max, track_all, fra_meteor_max);
     rotate_ROI_history(tracking_data->ROI_history);
 }
 
 void tracking_perform(tracking_data_t* tracking_data, const ROI_t* ROI_array0, ROI_t* ROI_array1, track_t* track_array,
-                      BB_t** BB_array, size_t frame, double theta, double tx, double ty, double mean_error,
+                      BB_log_t* BB_log, size_t frame, double theta, double tx, double ty, double mean_error,
                       double std_deviation, size_t r_extrapol, float angle_max, float diff_dev, int track_all,
                       size_t fra_star_min, size_t fra_meteor_min, size_t fra_meteor_max) {
     _tracking_perform(tracking_data, ROI_array0->id, ROI_array0->frame, ROI_array0->xmin, ROI_array0->xmax,
@@ -588,22 +1021,12 @@ void tracking_perform(tracking_data_t* tracking_data, const ROI_t* ROI_array0, R
                       ROI_array1->is_extrapolated, ROI_array1->_size, track_array->id, track_array->begin,
                       track_array->end, track_array->extrapol_x, track_array->extrapol_y, track_array->state,
                       track_array->obj_type, track_array->change_state_reason, &track_array->_offset,
-                      &track_array->_size, BB_array, frame, theta, tx, ty, mean_error, std_deviation, r_extrapol,
-                      angle_max, diff_dev, track_all, fra_star_min, fra_meteor_min, fra_meteor_max);
+                      &track_array->_size, track_array->_max_size, track_array->_n_flushed, BB_log, frame, theta,
+                      tx, ty, mean_error, std_deviation, r_extrapol, angle_max, diff_dev, track_all, fra_star_min,
+                      fra_meteor_min, fra_meteor_max);
 }
 
-void tracking_print_array_BB(BB_t** BB_array, int n) {
-    for (int i = 0; i < n; i++) {
-        if (BB_array[i] != NULL) {
-            for (BB_t* current = BB_array[i]; current != NULL; current = current->next) {
-                printf("%d %d %d %d %d %d \n", i, current->rx, current->ry, current->bb_x, current->bb_y,
-                       current->track_id);
-            }
-        }
-    }
-}
-
-void _tracking_track_array_write(FILE* f, const uint16_t* track_id, const ROI_light_t* track_begin,
+void _tracking_track_array_write(FILE* f, const uint32_t* track_id, const ROI_light_t* track_begin,
                                  const ROI_light_t* track_end, const enum obj_e* track_obj_type,
                                  const size_t n_tracks) {
     size_t real_n_tracks = 0;
@@ -612,19 +1035,11 @@ void _tracking_track_array_write(FILE* f, const uint16_t* track_id, const ROI_li
             real_n_tracks++;
 
     fprintf(f, "# Tracks [%lu]:\n", real_n_tracks);
-    fprintf(f, "# -------||---------------------------||---------------------------||---------\n");
-    fprintf(f, "#  Track ||           Begin           ||            End            ||  Object \n");
-    fprintf(f, "# -------||---------------------------||---------------------------||---------\n");
-    fprintf(f, "# -------||---------|--------|--------||---------|--------|--------||---------\n");
-    fprintf(f, "#     Id || Frame # |      x |      y || Frame # |      x |      y ||    Type \n");
-    fprintf(f, "# -------||---------|--------|--------||---------|--------|--------||---------\n");
+    tracking_track_array_write_header(f);
 
     for (size_t i = 0; i < n_tracks; i++)
-        if (track_id[i]) {
-            fprintf(f, "   %5d || %7u | %6.1f | %6.1f || %7u | %6.1f | %6.1f || %s \n", track_id[i],
-                    track_begin[i].frame, track_begin[i].x, track_begin[i].y, track_end[i].frame, track_end[i].x,
-                    track_end[i].y, g_obj_to_string_with_spaces[track_obj_type[i]]);
-        }
+        if (track_id[i])
+            _tracking_track_write(f, track_id, track_begin, track_end, track_obj_type, i);
 }
 
 void tracking_track_array_write(FILE* f, const track_t* track_array) {
@@ -669,22 +1084,45 @@ void tracking_parse_tracks(const char* filename, track_t* track_array) {
         free(line);
 }
 
-void tracking_save_array_BB(const char* filename, BB_t** tabBB, track_t* track_array, int N, int track_all) {
+void tracking_save_array_BB(const char* filename, const BB_log_t* BB_log, const track_t* track_array,
+                            const int track_all) {
+    // after a flush, the log does not contain all the tracks anymore and its track ids have been moved
+    if (track_array->_n_flushed || BB_log->_n_dropped) {
+        fprintf(stderr, "(EE) 'tracking_save_array_BB' can't be used after 'tracking_flush_tracks'.\n");
+        exit(1);
+    }
     FILE* f = fopen(filename, "w");
     if (f == NULL) {
         fprintf(stderr, "(EE) error ouverture %s \n", filename);
         exit(1);
     }
 
-    for (int i = 0; i < N; i++) {
-        if (tabBB[i] != NULL) {
-            for (BB_t* current = tabBB[i]; current != NULL; current = current->next) {
-                if (track_all || (!track_all && track_array->obj_type[(current->track_id) - 1] == METEOR))
-                    fprintf(f, "%d %d %d %d %d %d \n", i, current->rx, current->ry, current->bb_x, current->bb_y,
-                            current->track_id);
-            }
-        }
-    }
+    // the log is streamed twice to sort the bounding boxes by frame (counting sort), in a frame the bounding boxes are
+    // written from the last inserted to the first one
+    const size_t n_frames = BB_log->_size ? (size_t)BB_log->max_frame + 1 : 0;
+    size_t* frame_end = (size_t*)calloc(n_frames + 1, sizeof(size_t));
+    BB_t* last = (BB_t*)calloc(BB_log->_max_tracks + 1, sizeof(BB_t));
+    BB_t* BBs = (BB_t*)malloc((BB_log->_size + 1) * sizeof(BB_t));
+    BB_t BB;
+    size_t c = 0;
+    uint32_t off = 0;
+    while (_tracking_BB_log_next(BB_log, &c, &off, last, &BB))
+        frame_end[BB.frame]++;
+    for (size_t i = 1; i < n_frames; i++)
+        frame_end[i] += frame_end[i - 1];
+    memset(last, 0, (BB_log->_max_tracks + 1) * sizeof(BB_t));
+    c = 0;
+    off = 0;
+    while (_tracking_BB_log_next(BB_log, &c, &off, last, &BB))
+        BBs[--frame_end[BB.frame]] = BB;
+
+    for (size_t i = 0; i < BB_log->_size; i++)
+        if (track_all || (!track_all && track_array->obj_type[BBs[i].track_id - 1] == METEOR))
+            fprintf(f, "%lu %d %d %d %d %d \n", BBs[i].frame, BBs[i].rx, BBs[i].ry, BBs[i].bb_x, BBs[i].bb_y,
+                    BBs[i].track_id);
 
+    free(frame_end);
+    free(last);
+    free(BBs);
     fclose(f);
 }
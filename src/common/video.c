@@ -4,7 +4,7 @@
 
 #include "fmdt/video.h"
 
-video_t* video_init_from_file(const char* filename, const int start, const int end, const int skip,
+video_t* video_init_from_file(const char* filename, const size_t start, const size_t end, const size_t skip,
                               const size_t n_ffmpeg_threads, int* i0, int* i1, int* j0, int* j1) {
     video_t* video = (video_t*)malloc(sizeof(video_t));
     if (!video) {
@@ -55,7 +55,7 @@ static int video_get_frame(video_t* video, uint8_t** I) {
 
 int video_get_next_frame(video_t* video, uint8_t** I) {
     int r;
-    int skip = ((video->frame_current < video->frame_start) ? video->frame_start - 1 : video->frame_skip);
+    size_t skip = ((video->frame_current < video->frame_start) ? video->frame_start - 1 : video->frame_skip);
     do {
         r = video_get_frame(video, I);
     } while (r && skip--);
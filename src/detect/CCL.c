@@ -1,40 +1,79 @@
 #include <assert.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <nrc2.h>
+// the x86 kernels of the segment detection are compiled for their instruction set and selected at runtime
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define LSL_X86_DISPATCH
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #include "fmdt/defines.h"
+#include "fmdt/macros.h"
+#include "fmdt/tools.h"
+#include "fmdt/threshold.h"
 #include "fmdt/CCL.h"
 
+// maximum number of horizontal strips in the multi-threaded labeling
+#define LSL_MAX_STRIPS 256
+// above this number of fronts in 64 pixels, the vectorized segment detection processes the pixels one by one
+#define LSL_DENSE_FRONTS 8
+
+// the label images, the relative labels and the run-length coding are stored on 16 bits
+#if MAX_ROI_SIZE > 65535
+#error "'MAX_ROI_SIZE' has to be smaller than 65536 (the labels are stored on 16 bits)."
+#endif
+
+// final label of the CCs after the 'MAX_ROI_SIZE' first ones: they are dropped (their pixels are set to 0)
+#define CCL_LABEL_DROPPED UINT32_MAX
+
 CCL_data_t* CCL_LSL_alloc_and_init_data(int i0, int i1, int j0, int j1) {
+    if ((j1 - j0) + 2 > UINT16_MAX) {
+        fprintf(stderr, "(EE) The image is too wide for the CCL (%d columns max).\n", UINT16_MAX - 1);
+        exit(1);
+    }
     CCL_data_t* data = (CCL_data_t*)malloc(sizeof(CCL_data_t));
     data->i0 = i0;
     data->i1 = i1;
     data->j0 = j0;
     data->j1 = j1;
     long n = (data->i1 - data->i0 + 1) * (data->j1 - data->j0 + 1);
-    data->er = ui32matrix(data->i0, data->i1, data->j0, data->j1);
+    data->er = ui16matrix(data->i0, data->i1, data->j0, data->j1);
     //data->ea = ui32matrix(data->i0, data->i1, data->j0, data->j1);
-    data->era = ui32matrix(data->i0, data->i1, data->j0, data->j1);
-    data->rlc = ui32matrix(data->i0, data->i1, data->j0, data->j1);
+    // one more column for 'era' and 'rlc': they are indexed by the relative labels, up to (j1 - j0) + 1 (when the
+    // line ends with a CC pixel), this would overflow on the next line (which may be processed in parallel)
+    data->era = ui32matrix(data->i0, data->i1, data->j0, data->j1 + 1);
+    data->rlc = ui16matrix(data->i0, data->i1, data->j0, data->j1 + 1);
     data->eq = ui32vector(0, n);
     data->ner = ui32vector(data->i0, data->i1);
+    zero_ui32vector(data->ner, data->i0, data->i1);
+    CCL_LSL_init_dispatch();
+    // each strip of the fused front end reuses the 'band_size' first lines of its own rows
+    data->band = ui8matrix(data->i0, data->i1, data->j0, data->j1);
+    data->band_rows = ui8vector(data->i0, data->i1);
     return data;
 }
 
 void CCL_LSL_free_data(CCL_data_t* data) {
     long n = (data->i1 - data->i0 + 1) * (data->j1 - data->j0 + 1);
-    free_ui32matrix(data->er, data->i0, data->i1, data->j0, data->j1);
+    free_ui16matrix(data->er, data->i0, data->i1, data->j0, data->j1);
     //free_ui32matrix(data->ea, data->i0, data->i1, data->j0, data->j1);
-    free_ui32matrix(data->era, data->i0, data->i1, data->j0, data->j1);
-    free_ui32matrix(data->rlc, data->i0, data->i1, data->j0, data->j1);
+    free_ui32matrix(data->era, data->i0, data->i1, data->j0, data->j1 + 1);
+    free_ui16matrix(data->rlc, data->i0, data->i1, data->j0, data->j1 + 1);
     free_ui32vector(data->eq, 0, n);
     free_ui32vector(data->ner, data->i0, data->i1);
+    free_ui8matrix(data->band, data->i0, data->i1, data->j0, data->j1);
+    free_ui8vector(data->band_rows, data->i0, data->i1);
     free(data);
 }
 
-void LSL_segment_detection(uint32_t* line_er, uint32_t* line_rlc, uint32_t* line_ner, const uint8_t* line,
-                           const int j0, const int j1, uint32_t* line_cpy_out) {
+void LSL_segment_detection(uint16_t* line_er, uint16_t* line_rlc, uint32_t* line_ner, const uint8_t* line,
+                           const int j0, const int j1, uint16_t* line_cpy_out) {
     uint32_t j_curr;
     uint32_t j_prev = 0;
     uint32_t f = 0; // Front detection
@@ -58,8 +97,245 @@ void LSL_segment_detection(uint32_t* line_er, uint32_t* line_rlc, uint32_t* line
     *line_ner = er;
 }
 
-void _LSL_equivalence_construction(uint32_t* data_eq, const uint32_t* line_rlc, uint32_t* line_era,
-                                   const uint32_t* prevline_er, const uint32_t* prevline_era, const int n, const int x0,
+// Segments of the 64 pixels starting at 'j' ('word' = bit mask of the non-zero pixels, the bits after 'j1' are 0): the
+// fronts are found with count trailing zeros and the relative labels are filled up to the last front. If 'line_out' is
+// not NULL, the pixels outside of the segments are set to 0.
+static inline void _LSL_segments_word(uint16_t* line_er, uint16_t* line_rlc, uint16_t* line_out, const uint64_t word,
+                                      const int j, const int j1, uint32_t* er, int* in_segment, int* j_fill) {
+    // many short segments: the fronts are processed pixel by pixel without branches (as in 'LSL_segment_detection'),
+    // the search with count trailing zeros is only faster when there are a few fronts
+    const uint64_t all_fronts = word ^ ((word << 1) | (uint64_t)*in_segment);
+    if (!line_out && j + 63 <= j1 && POPCNT64(all_fronts) > LSL_DENSE_FRONTS) {
+        uint32_t e = *er;
+        uint32_t b = (uint32_t)*in_segment;
+        for (int jj = *j_fill; jj < j; jj++)
+            line_er[jj] = e;
+        for (int k = 0; k < 64; k++) {
+            const uint32_t f = (uint32_t)(all_fronts >> k) & 1;
+            line_rlc[e] = j + k - b; // Begin/End of segment
+            b ^= f;
+            e += f;
+            line_er[j + k] = e;
+        }
+        *er = e;
+        *in_segment = (int)b;
+        *j_fill = j + 64;
+        return;
+    }
+
+    int k = 0;
+    while (k < 64) {
+        // looks for the next front (a '1' outside of a segment, a '0' inside)
+        const uint64_t fronts = (*in_segment ? ~word : word) & (~(uint64_t)0 << k);
+        if (!fronts)
+            break;
+        k = CTZ64(fronts);
+        const int j_front = j + k;
+        const int j_end = MIN(j_front, j1 + 1);
+        for (int jj = *j_fill; jj < j_end; jj++)
+            line_er[jj] = *er;
+        if (line_out && !*in_segment)
+            for (int jj = *j_fill; jj < j_end; jj++)
+                line_out[jj] = 0;
+        line_rlc[*er] = *in_segment ? j_front - 1 : j_front; // Begin/End of segment
+        (*er)++;
+        *j_fill = j_end;
+        *in_segment = !*in_segment;
+    }
+}
+
+// End of the line after the last word: fills the last relative labels and closes the last segment
+static inline void _LSL_segments_end(uint16_t* line_er, uint16_t* line_rlc, uint32_t* line_ner, uint16_t* line_out,
+                                     const int j1, uint32_t er, const int in_segment, const int j_fill) {
+    for (int jj = j_fill; jj <= j1; jj++)
+        line_er[jj] = er;
+    if (in_segment) {
+        line_rlc[er] = j1; // the last segment ends on the last pixel
+        er++;
+    } else if (line_out) {
+        for (int jj = j_fill; jj <= j1; jj++)
+            line_out[jj] = 0;
+    }
+    *line_ner = er;
+}
+
+// Same as 'LSL_segment_detection' on a bit-packed line: the segments are found word by word with count trailing
+// zeros and the relative labels are filled per segment. The pixels outside of the segments are set to 0 in 'line_out'.
+void LSL_segment_detection_packed(uint16_t* line_er, uint16_t* line_rlc, uint32_t* line_ner, const uint64_t* line,
+                                  const int j0, const int j1, uint16_t* line_out) {
+    const int n_words = (int)PACKED_N_WORDS(j0, j1);
+    uint32_t er = 0;
+    int in_segment = 0;
+    int j_fill = j0; // first pixel without relative label
+
+    for (int w = 0; w < n_words; w++)
+        _LSL_segments_word(line_er, line_rlc, line_out, line[w], j0 + 64 * w, j1, &er, &in_segment, &j_fill);
+    _LSL_segments_end(line_er, line_rlc, line_ner, line_out, j1, er, in_segment, j_fill);
+}
+
+// Vectorized versions of 'LSL_segment_detection' (same 'line_er', 'line_rlc', 'line_ner' and 'line_cpy_out'): the
+// mask of the non-zero pixels is computed 64 pixels at a time with vector compares + movemask and the segments are
+// found in the mask as in 'LSL_segment_detection_packed'. The last pixels (< 64) are processed in scalar.
+static inline void _LSL_segments_tail(uint16_t* line_er, uint16_t* line_rlc, uint32_t* line_ner, const uint8_t* line,
+                                      const int j, const int j1, uint16_t* line_cpy_out, uint32_t er, int in_segment,
+                                      int j_fill) {
+    uint64_t word = 0;
+    for (int jj = j; jj <= j1; jj++) {
+        line_cpy_out[jj] = line[jj];
+        word |= (uint64_t)(line[jj] != 0) << (jj - j);
+    }
+    if (j <= j1)
+        _LSL_segments_word(line_er, line_rlc, NULL, word, j, j1, &er, &in_segment, &j_fill);
+    _LSL_segments_end(line_er, line_rlc, line_ner, NULL, j1, er, in_segment, j_fill);
+    if (!line[j1]) // as in the scalar version
+        line_rlc[*line_ner] = j1 + 1;
+}
+
+#if defined(LSL_X86_DISPATCH) || defined(__SSE2__)
+static void _LSL_segment_detection_sse2(uint16_t* line_er, uint16_t* line_rlc, uint32_t* line_ner,
+                                        const uint8_t* line, const int j0, const int j1, uint16_t* line_cpy_out) {
+    const __m128i zero = _mm_setzero_si128();
+    uint32_t er = 0;
+    int in_segment = 0;
+    int j_fill = j0;
+    int j = j0;
+    for (; j + 63 <= j1; j += 64) {
+        uint64_t word = 0;
+        for (int k = 0; k < 4; k++) {
+            const __m128i x = _mm_loadu_si128((const __m128i*)(line + j + 16 * k));
+            _mm_storeu_si128((__m128i*)(line_cpy_out + j + 16 * k), _mm_unpacklo_epi8(x, zero));
+            _mm_storeu_si128((__m128i*)(line_cpy_out + j + 16 * k + 8), _mm_unpackhi_epi8(x, zero));
+            word |= (uint64_t)(uint16_t)~_mm_movemask_epi8(_mm_cmpeq_epi8(x, zero)) << (16 * k);
+        }
+        _LSL_segments_word(line_er, line_rlc, NULL, word, j, j1, &er, &in_segment, &j_fill);
+    }
+    _LSL_segments_tail(line_er, line_rlc, line_ner, line, j, j1, line_cpy_out, er, in_segment, j_fill);
+}
+#endif
+
+#if defined(LSL_X86_DISPATCH)
+__attribute__((target("avx2")))
+static void _LSL_segment_detection_avx2(uint16_t* line_er, uint16_t* line_rlc, uint32_t* line_ner,
+                                        const uint8_t* line, const int j0, const int j1, uint16_t* line_cpy_out) {
+    const __m256i zero = _mm256_setzero_si256();
+    uint32_t er = 0;
+    int in_segment = 0;
+    int j_fill = j0;
+    int j = j0;
+    for (; j + 63 <= j1; j += 64) {
+        uint64_t word = 0;
+        for (int k = 0; k < 2; k++) {
+            const __m256i x = _mm256_loadu_si256((const __m256i*)(line + j + 32 * k));
+            _mm256_storeu_si256((__m256i*)(line_cpy_out + j + 32 * k),
+                                _mm256_cvtepu8_epi16(_mm256_castsi256_si128(x)));
+            _mm256_storeu_si256((__m256i*)(line_cpy_out + j + 32 * k + 16),
+                                _mm256_cvtepu8_epi16(_mm256_extracti128_si256(x, 1)));
+            word |= (uint64_t)(uint32_t)~_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, zero)) << (32 * k);
+        }
+        _LSL_segments_word(line_er, line_rlc, NULL, word, j, j1, &er, &in_segment, &j_fill);
+    }
+    _LSL_segments_tail(line_er, line_rlc, line_ner, line, j, j1, line_cpy_out, er, in_segment, j_fill);
+}
+
+__attribute__((target("avx512bw")))
+static void _LSL_segment_detection_avx512(uint16_t* line_er, uint16_t* line_rlc, uint32_t* line_ner,
+                                          const uint8_t* line, const int j0, const int j1, uint16_t* line_cpy_out) {
+    uint32_t er = 0;
+    int in_segment = 0;
+    int j_fill = j0;
+    int j = j0;
+    for (; j + 63 <= j1; j += 64) {
+        const __m512i x = _mm512_loadu_si512((const void*)(line + j));
+        _mm512_storeu_si512((void*)(line_cpy_out + j), _mm512_cvtepu8_epi16(_mm512_castsi512_si256(x)));
+        _mm512_storeu_si512((void*)(line_cpy_out + j + 32), _mm512_cvtepu8_epi16(_mm512_extracti64x4_epi64(x, 1)));
+        const uint64_t word = (uint64_t)_mm512_test_epi8_mask(x, x);
+        _LSL_segments_word(line_er, line_rlc, NULL, word, j, j1, &er, &in_segment, &j_fill);
+    }
+    _LSL_segments_tail(line_er, line_rlc, line_ner, line, j, j1, line_cpy_out, er, in_segment, j_fill);
+}
+#endif
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+static void _LSL_segment_detection_neon(uint16_t* line_er, uint16_t* line_rlc, uint32_t* line_ner,
+                                        const uint8_t* line, const int j0, const int j1, uint16_t* line_cpy_out) {
+    static const uint8_t bits[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    const uint8x16_t v_bits = vld1q_u8(bits);
+    uint32_t er = 0;
+    int in_segment = 0;
+    int j_fill = j0;
+    int j = j0;
+    for (; j + 63 <= j1; j += 64) {
+        uint64_t word = 0;
+        for (int k = 0; k < 4; k++) {
+            const uint8x16_t x = vld1q_u8(line + j + 16 * k);
+            vst1q_u16(line_cpy_out + j + 16 * k, vmovl_u8(vget_low_u8(x)));
+            vst1q_u16(line_cpy_out + j + 16 * k + 8, vmovl_u8(vget_high_u8(x)));
+            // no movemask on NEON: the non-zero bytes are weighted by their bit and summed per half
+            const uint8x16_t m = vandq_u8(vtstq_u8(x, x), v_bits);
+            const uint64_t m16 = (uint64_t)vaddv_u8(vget_low_u8(m)) | ((uint64_t)vaddv_u8(vget_high_u8(m)) << 8);
+            word |= m16 << (16 * k);
+        }
+        _LSL_segments_word(line_er, line_rlc, NULL, word, j, j1, &er, &in_segment, &j_fill);
+    }
+    _LSL_segments_tail(line_er, line_rlc, line_ner, line, j, j1, line_cpy_out, er, in_segment, j_fill);
+}
+#endif
+
+typedef void (*LSL_segment_detection_f)(uint16_t*, uint16_t*, uint32_t*, const uint8_t*, const int, const int,
+                                        uint16_t*);
+
+// Selects the fastest segment detection for the CPU (the kernels give the same results)
+static LSL_segment_detection_f _LSL_segment_detection_select(void) {
+#if defined(LSL_X86_DISPATCH)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512bw"))
+        return _LSL_segment_detection_avx512;
+    if (__builtin_cpu_supports("avx2"))
+        return _LSL_segment_detection_avx2;
+    if (__builtin_cpu_supports("sse2"))
+        return _LSL_segment_detection_sse2;
+#elif defined(__SSE2__)
+    return _LSL_segment_detection_sse2;
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    return _LSL_segment_detection_neon;
+#endif
+    return LSL_segment_detection;
+}
+
+// CPU dispatch of the segment detection, resolved only once by 'CCL_LSL_init_dispatch' (before any labeling, so the
+// labelings running in parallel only read it)
+static LSL_segment_detection_f _LSL_segment_detection = NULL;
+
+void CCL_LSL_init_dispatch(void) {
+    if (!_LSL_segment_detection)
+        _LSL_segment_detection = _LSL_segment_detection_select();
+}
+
+static LSL_segment_detection_f _LSL_segment_detection_get(void) {
+    CCL_LSL_init_dispatch(); // no-op after the first initialization
+    return _LSL_segment_detection;
+}
+
+// Skips an empty line: the labels of the previous call are cleared from 'line_out' (the other pixels of the line are
+// already 0)
+static void _LSL_clear_line(uint16_t* line_out, const uint16_t* line_rlc, uint32_t* line_ner) {
+    for (uint32_t k = 0; k < *line_ner; k += 2)
+        memset(line_out + line_rlc[k], 0, (line_rlc[k + 1] - line_rlc[k] + 1) * sizeof(uint16_t));
+    *line_ner = 0;
+}
+
+// Root of the equivalence class of 'e'. The roots are the minimum labels of their class ('data_eq[e]' <= 'e'), the
+// path is halved during the search so the chains stay short whatever the shape of the CCs.
+static inline uint32_t _LSL_find(uint32_t* data_eq, uint32_t e) {
+    while (e != data_eq[e]) {
+        data_eq[e] = data_eq[data_eq[e]];
+        e = data_eq[e];
+    }
+    return e;
+}
+
+void _LSL_equivalence_construction(uint32_t* data_eq, const uint16_t* line_rlc, uint32_t* line_era,
+                                   const uint16_t* prevline_er, const uint32_t* prevline_era, const int n, const int x0,
                                    const int x1, uint32_t* nea) {
     int k, er, j0, j1, er0, er1, ea, erk, eak;
     for (k = 0; k < n; k += 2) {
@@ -84,21 +360,18 @@ void _LSL_equivalence_construction(uint32_t* data_eq, const uint32_t* line_rlc,
 
         if (er1 >= er0) { // Adjacency -> connect components
             ea = prevline_era[er0];
-            uint32_t a = data_eq[ea];
+            uint32_t a = _LSL_find(data_eq, ea);
             for (erk = er0 + 2; erk <= er1; erk += 2) {
                 eak = prevline_era[erk];
-                uint32_t ak = data_eq[eak];
-                while (ak != data_eq[ak]) {
-                    ak = data_eq[ak];
-                }
+                uint32_t ak = _LSL_find(data_eq, eak);
+                // the roots are linked (and not 'ea' / 'eak'), otherwise a part of the CC can be lost
                 if (a < ak) {
-                    data_eq[eak] = a; // Minimum propagation
+                    data_eq[ak] = a; // Minimum propagation
                 }
 
                 if (a > ak) {
+                    data_eq[a] = ak;
                     a = ak;
-                    data_eq[ea] = a;
-                    ea = eak;
                 }
             }
             line_era[er] = a; // Global minimum
@@ -110,65 +383,630 @@ void _LSL_equivalence_construction(uint32_t* data_eq, const uint32_t* line_rlc,
     }
 }
 
-uint32_t _CCL_LSL_apply(uint32_t** data_er, uint32_t** data_era, uint32_t** data_rlc, uint32_t* data_eq,
-                        uint32_t* data_ner, const uint8_t** img_in, uint32_t** img_out, const int i0, const int i1,
-                        const int j0, const int j1) {
-    // if ((void*)img_in != (void*)img_out)
-    //     for (int i = i0; i <= i1; i++)
-    //         memcpy(img_out[i] + j0, img_in[i] + j0, sizeof(uint8_t) * ((j1 - j0) + 1));
+// Merges the CCs of the first line of a strip with the CCs of the last line of the previous strip (the root of the
+// merged CCs is the minimum label, as in the equivalence construction)
+static void _LSL_border_merge(uint32_t* data_eq, const uint16_t* line_rlc, const uint32_t* line_era,
+                              const uint16_t* prevline_er, const uint32_t* prevline_era, const int n, const int x0,
+                              const int x1) {
+    for (int k = 0; k < n; k += 2) {
+        int j0 = line_rlc[k];
+        int j1 = line_rlc[k + 1];
 
-    // Step #1 - Segment detection
-    for (int i = i0; i <= i1; i++) {
-        LSL_segment_detection(data_er[i], data_rlc[i], &data_ner[i], img_in[i], j0, j1, img_out[i]);
-    }
+        // Extends for 8-connected
+        if (j0 > x0)
+            j0 -= 1;
+        if (j1 < x1)
+            j1 += 1;
 
-    // Step #2 - Equivalence construction
-    uint32_t nea = i0;
-    uint32_t n = data_ner[i0];
-    for (uint32_t k = 0; k < n; k += 2) {
-        data_eq[nea] = nea;
-        data_era[i0][k + 1] = nea++;
+        int er0 = prevline_er[j0];
+        int er1 = prevline_er[j1];
+        if ((er0 & 1) == 0) // er0 is even
+            er0 += 1;
+        if ((er1 & 1) == 0) // er1 is even
+            er1 -= 1;
+
+        for (int erk = er0; erk <= er1; erk += 2) {
+            uint32_t a = _LSL_find(data_eq, line_era[k + 1]);
+            uint32_t ak = _LSL_find(data_eq, prevline_era[erk]);
+            if (a < ak)
+                data_eq[ak] = a;
+            if (ak < a)
+                data_eq[a] = ak;
+        }
     }
-    for (int i = i0 + 1; i <= i1; i++) {
-        _LSL_equivalence_construction(data_eq, data_rlc[i], data_era[i], data_er[i - 1], data_era[i - 1], data_ner[i],
-                                      j0, j1, &nea);
+}
+
+// Steps #2 bis and #4 of the LSL algorithm, returns the number of connected components. 'strip_nea' is the next
+// absolute label of each strip after the step #2.
+static uint32_t _LSL_resolve(uint16_t** data_er, uint32_t** data_era, uint16_t** data_rlc, uint32_t* data_eq,
+                             uint32_t* data_ner, const int i0, const int i1, const int j0, const int j1,
+                             const int n_strips, const uint32_t* strip_nea) {
+    const int n_rows = (i1 - i0) + 1;
+    const uint32_t max_labels_per_row = (uint32_t)((j1 - j0) + 2) / 2;
+
+    // Step #2 bis - Equivalences between the strips
+    for (int s = 1; s < n_strips; s++) {
+        const int r0 = i0 + (s * n_rows) / n_strips;
+        if (!data_ner[r0 - 1]) // the relative labels of an empty line are not computed
+            continue;
+        _LSL_border_merge(data_eq, data_rlc[r0], data_era[r0], data_er[r0 - 1], data_era[r0 - 1], data_ner[r0], j0,
+                          j1);
     }
 
     // Step #3 - Relative to Absolute label conversion
 
-    // Step #4 - Resolution of equivalence classes
+    // Step #4 - Resolution of equivalence classes (one level is enough: the parent of 'i' is smaller than 'i' and is
+    // already resolved)
     uint32_t trueN = 0;
-    for (uint32_t i = 0; i < nea; i++) {
-        if (i != data_eq[i]) {
-            data_eq[i] = data_eq[data_eq[i]];
+    for (int s = 0; s < n_strips; s++) {
+        const int r0 = i0 + (s * n_rows) / n_strips;
+        for (uint32_t i = s ? i0 + (uint32_t)(r0 - i0) * max_labels_per_row : 0; i < strip_nea[s]; i++) {
+            if (i != data_eq[i]) {
+                data_eq[i] = data_eq[data_eq[i]];
+            } else {
+                data_eq[i] = trueN < MAX_ROI_SIZE ? trueN : CCL_LABEL_DROPPED;
+                trueN++;
+            }
+        }
+    }
+
+    if (trueN > MAX_ROI_SIZE) {
+        fprintf(stderr, "(WW) %u CCs, only the %d first ones are kept ('MAX_ROI_SIZE').\n", trueN, MAX_ROI_SIZE);
+        trueN = MAX_ROI_SIZE;
+    }
+
+    return trueN;
+}
+
+// Step #2 of the LSL algorithm on the lines 'i' to 'i1' of the strip starting at line 'r0'
+static void _LSL_equivalences(uint16_t** data_er, uint32_t** data_era, uint16_t** data_rlc, uint32_t* data_eq,
+                              uint32_t* data_ner, const int r0, const int i, const int i1, const int j0, const int j1,
+                              uint32_t* nea) {
+    for (int ii = i; ii <= i1; ii++) {
+        if (ii == r0 || !data_ner[ii - 1]) { // no line above: new labels
+            uint32_t n = data_ner[ii];
+            for (uint32_t k = 0; k < n; k += 2) {
+                data_eq[*nea] = *nea;
+                data_era[ii][k + 1] = (*nea)++;
+            }
         } else {
-            data_eq[i] = trueN++;
+            _LSL_equivalence_construction(data_eq, data_rlc[ii], data_era[ii], data_er[ii - 1], data_era[ii - 1],
+                                          data_ner[ii], j0, j1, nea);
+        }
+    }
+}
+
+// Steps #1 to #4 of the LSL algorithm, returns the number of connected components.
+// With 'n_threads' > 1, the steps #1 and #2 are computed on horizontal strips (one strip per thread). The absolute
+// labels of a strip start at the maximum number of labels of the previous strips, so they keep the raster order of
+// the sequential version and the final labels are the same.
+// 'img_in' (1 byte per pixel) or 'img_in_packed' (1 bit per pixel) has to be NULL.
+// The lines 'i' with 'img_rows[i]' = 0 are skipped (if 'img_rows' is not NULL).
+static uint32_t _LSL_label(uint16_t** data_er, uint32_t** data_era, uint16_t** data_rlc, uint32_t* data_eq,
+                           uint32_t* data_ner, const uint8_t** img_in, const uint64_t** img_in_packed,
+                           const uint8_t* img_rows, uint16_t** img_out, const int i0, const int i1, const int j0,
+                           const int j1, const int n_threads) {
+    const LSL_segment_detection_f segment_detection = _LSL_segment_detection_get();
+    const int n_rows = (i1 - i0) + 1;
+    const int n_strips = MAX(1, MIN(MIN(n_threads, n_rows), LSL_MAX_STRIPS));
+    const uint32_t max_labels_per_row = (uint32_t)((j1 - j0) + 2) / 2;
+    uint32_t strip_nea[LSL_MAX_STRIPS];
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(n_strips) schedule(static, 1)
+#endif
+    for (int s = 0; s < n_strips; s++) {
+        const int r0 = i0 + (s * n_rows) / n_strips;
+        const int r1 = i0 + ((s + 1) * n_rows) / n_strips - 1;
+
+        // Step #1 - Segment detection
+        for (int i = r0; i <= r1; i++) {
+            if (img_rows && !img_rows[i])
+                _LSL_clear_line(img_out[i], data_rlc[i], &data_ner[i]);
+            else if (img_in_packed)
+                LSL_segment_detection_packed(data_er[i], data_rlc[i], &data_ner[i], img_in_packed[i], j0, j1,
+                                             img_out[i]);
+            else
+                segment_detection(data_er[i], data_rlc[i], &data_ner[i], img_in[i], j0, j1, img_out[i]);
+        }
+
+        // Step #2 - Equivalence construction
+        uint32_t nea = i0 + (uint32_t)(r0 - i0) * max_labels_per_row;
+        _LSL_equivalences(data_er, data_era, data_rlc, data_eq, data_ner, r0, r0, r1, j0, j1, &nea);
+        strip_nea[s] = nea;
+    }
+
+    return _LSL_resolve(data_er, data_era, data_rlc, data_eq, data_ner, i0, i1, j0, j1, n_strips, strip_nea);
+}
+
+// Same as '_LSL_label' but from the grayscale image: the thresholds, the step #1 and the step #2 are computed band
+// of 'band_size' lines by band of lines, while the thresholded lines are still in the cache. The binary image of
+// 'threshold_min' is never stored, the binary image of 'threshold_max' is stored in 'img_max_out'. The empty lines
+// are skipped.
+static uint32_t _LSL_label_band(uint16_t** data_er, uint32_t** data_era, uint16_t** data_rlc, uint32_t* data_eq,
+                                uint32_t* data_ner, uint8_t** data_band, uint8_t* data_band_rows,
+                                const uint8_t** img_in, uint8_t** img_max_out, uint16_t** img_out, uint8_t* rows_min,
+                                uint8_t* rows_max, const int i0, const int i1, const int j0, const int j1,
+                                const uint8_t threshold_min, const uint8_t threshold_max, const int band_size,
+                                const int n_threads) {
+    const LSL_segment_detection_f segment_detection = _LSL_segment_detection_get();
+    const int n_rows = (i1 - i0) + 1;
+    const int n_strips = MAX(1, MIN(MIN(n_threads, n_rows), LSL_MAX_STRIPS));
+    const uint32_t max_labels_per_row = (uint32_t)((j1 - j0) + 2) / 2;
+    uint32_t strip_nea[LSL_MAX_STRIPS];
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(n_strips) schedule(static, 1)
+#endif
+    for (int s = 0; s < n_strips; s++) {
+        const int r0 = i0 + (s * n_rows) / n_strips;
+        const int r1 = i0 + ((s + 1) * n_rows) / n_strips - 1;
+        // the lines of the bands of the strip are always the same (the first lines of the strip): still in the cache
+        uint8_t** band = data_band + r0;
+        uint8_t* band_rows = data_band_rows + r0;
+
+        uint32_t nea = i0 + (uint32_t)(r0 - i0) * max_labels_per_row;
+        for (int b0 = r0; b0 <= r1; b0 += band_size) {
+            const int b1 = MIN(b0 + band_size - 1, r1);
+
+            // Step #0 - Thresholds
+            for (int i = b0; i <= b1; i++) {
+                threshold_dual(img_in + i, band + (i - b0), img_max_out + i, band_rows + (i - b0),
+                               rows_max ? rows_max + i : NULL, 0, 0, j0, j1, threshold_min, threshold_max);
+            }
+
+            // Step #1 - Segment detection
+            for (int i = b0; i <= b1; i++) {
+                if (rows_min)
+                    rows_min[i] = band_rows[i - b0];
+                if (!band_rows[i - b0])
+                    _LSL_clear_line(img_out[i], data_rlc[i], &data_ner[i]);
+                else
+                    segment_detection(data_er[i], data_rlc[i], &data_ner[i], band[i - b0], j0, j1, img_out[i]);
+            }
+
+            // Step #2 - Equivalence construction
+            _LSL_equivalences(data_er, data_era, data_rlc, data_eq, data_ner, r0, b0, b1, j0, j1, &nea);
         }
+        strip_nea[s] = nea;
     }
 
+    return _LSL_resolve(data_er, data_era, data_rlc, data_eq, data_ner, i0, i1, j0, j1, n_strips, strip_nea);
+}
+
+// Step #5 of the LSL algorithm
+static void _LSL_final_labeling(uint16_t** data_er, uint32_t** data_era, uint16_t** data_rlc, uint32_t* data_eq,
+                                uint32_t* data_ner, uint16_t** img_out, const int i0, const int i1,
+                                const int n_threads) {
     // Step #5 - Final image labeling
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(n_threads) schedule(static) if (n_threads > 1)
+#else
+    (void)n_threads;
+#endif
     for (int i = i0; i <= i1; i++) {
-        n = data_ner[i];
+        uint32_t n = data_ner[i];
         for (uint32_t k = 0; k < n; k += 2) {
             int a = data_rlc[i][k];
             int b = data_rlc[i][k + 1];
 
             // Step #3 merged with step #5
-            uint32_t val = data_era[i][data_er[i][a]];
-            val = data_eq[val] + 1;
+            const uint32_t r = data_eq[data_era[i][data_er[i][a]]];
+            const uint16_t val = r == CCL_LABEL_DROPPED ? 0 : (uint16_t)(r + 1);
 
             for (int j = a; j <= b; j++) {
-                img_out[i][j] = (uint32_t)val;
+                img_out[i][j] = val;
+            }
+        }
+    }
+}
+
+// Steps #1 to #5 of the LSL algorithm
+static uint32_t _LSL_apply(uint16_t** data_er, uint32_t** data_era, uint16_t** data_rlc, uint32_t* data_eq,
+                           uint32_t* data_ner, const uint8_t** img_in, const uint64_t** img_in_packed,
+                           const uint8_t* img_rows, uint16_t** img_out, const int i0, const int i1, const int j0,
+                           const int j1, const int n_threads) {
+    const uint32_t trueN = _LSL_label(data_er, data_era, data_rlc, data_eq, data_ner, img_in, img_in_packed,
+                                      img_rows, img_out, i0, i1, j0, j1, n_threads);
+    _LSL_final_labeling(data_er, data_era, data_rlc, data_eq, data_ner, img_out, i0, i1, n_threads);
+    return trueN;
+}
+
+// Computes the features of the CCs from the segments (instead of from the pixels of the labeled image)
+static void _LSL_features(const uint16_t** data_er, const uint32_t** data_era, const uint16_t** data_rlc,
+                          const uint32_t* data_eq, const uint32_t* data_ner, const int i0, const int i1, const int j0,
+                          const int j1, const uint32_t n_ROI, uint16_t* ROI_id, uint16_t* ROI_xmin,
+                          uint16_t* ROI_xmax, uint16_t* ROI_ymin, uint16_t* ROI_ymax, uint32_t* ROI_S,
+                          uint32_t* ROI_Sx, uint32_t* ROI_Sy, uint64_t* ROI_Sxx, uint64_t* ROI_Syy, uint64_t* ROI_Sxy,
+                          float* ROI_x, float* ROI_y) {
+    for (uint32_t r = 0; r < n_ROI; r++) {
+        ROI_id[r] = r + 1;
+        ROI_xmin[r] = j1;
+        ROI_xmax[r] = j0;
+        ROI_ymin[r] = i1;
+        ROI_ymax[r] = i0;
+    }
+    memset(ROI_S, 0, n_ROI * sizeof(uint32_t));
+    memset(ROI_Sx, 0, n_ROI * sizeof(uint32_t));
+    memset(ROI_Sy, 0, n_ROI * sizeof(uint32_t));
+    if (ROI_Sxx) {
+        memset(ROI_Sxx, 0, n_ROI * sizeof(uint64_t));
+        memset(ROI_Syy, 0, n_ROI * sizeof(uint64_t));
+        memset(ROI_Sxy, 0, n_ROI * sizeof(uint64_t));
+    }
+
+    for (int i = i0; i <= i1; i++) {
+        uint32_t n = data_ner[i];
+        for (uint32_t k = 0; k < n; k += 2) {
+            int a = data_rlc[i][k];
+            int b = data_rlc[i][k + 1];
+
+            const uint32_t r = data_eq[data_era[i][data_er[i][a]]];
+            if (r == CCL_LABEL_DROPPED)
+                continue;
+            const uint32_t len = (uint32_t)(b - a + 1);
+            ROI_S[r] += len;
+            ROI_Sx[r] += ((uint32_t)(a + b) * len) / 2;
+            ROI_Sy[r] += (uint32_t)i * len;
+            if (ROI_Sxx) {
+                // sum of the j^2 of the segment: F(b) - F(a - 1) with F(n) = n (n + 1) (2n + 1) / 6
+                const int64_t sum_j2 = ((int64_t)b * (b + 1) * (2 * b + 1) - (int64_t)(a - 1) * a * (2 * a - 1)) / 6;
+                ROI_Sxx[r] += (uint64_t)sum_j2;
+                ROI_Syy[r] += (uint64_t)i * i * len;
+                ROI_Sxy[r] += (uint64_t)i * (((uint64_t)(a + b) * len) / 2);
             }
+            if (a < ROI_xmin[r])
+                ROI_xmin[r] = a;
+            if (b > ROI_xmax[r])
+                ROI_xmax[r] = b;
+            if (i < ROI_ymin[r])
+                ROI_ymin[r] = i;
+            if (i > ROI_ymax[r])
+                ROI_ymax[r] = i;
         }
     }
 
-    assert(trueN < MAX_ROI_SIZE);
+    for (uint32_t r = 0; r < n_ROI; r++) {
+        ROI_x[r] = (double)ROI_Sx[r] / (double)ROI_S[r];
+        ROI_y[r] = (double)ROI_Sy[r] / (double)ROI_S[r];
+    }
+}
+
+uint32_t _CCL_LSL_apply(uint16_t** data_er, uint32_t** data_era, uint16_t** data_rlc, uint32_t* data_eq,
+                        uint32_t* data_ner, const uint8_t** img_in, const uint8_t* img_rows, uint16_t** img_out,
+                        const int i0, const int i1, const int j0, const int j1, const int n_threads) {
+    // if ((void*)img_in != (void*)img_out)
+    //     for (int i = i0; i <= i1; i++)
+    //         memcpy(img_out[i] + j0, img_in[i] + j0, sizeof(uint8_t) * ((j1 - j0) + 1));
 
+    return _LSL_apply(data_er, data_era, data_rlc, data_eq, data_ner, img_in, NULL, img_rows, img_out, i0, i1, j0,
+                      j1, n_threads);
+}
+
+uint32_t CCL_LSL_apply(CCL_data_t* data, const uint8_t** img_in, const uint8_t* img_rows, uint16_t** img_out,
+                       const int n_threads) {
+    return _CCL_LSL_apply(data->er, data->era, data->rlc, data->eq, data->ner, img_in, img_rows, img_out, data->i0,
+                          data->i1, data->j0, data->j1, n_threads);
+}
+
+uint32_t _CCL_LSL_apply_packed(uint16_t** data_er, uint32_t** data_era, uint16_t** data_rlc, uint32_t* data_eq,
+                               uint32_t* data_ner, const uint64_t** img_in, const uint8_t* img_rows,
+                               uint16_t** img_out, const int i0, const int i1, const int j0, const int j1,
+                               const int n_threads) {
+    return _LSL_apply(data_er, data_era, data_rlc, data_eq, data_ner, NULL, img_in, img_rows, img_out, i0, i1, j0,
+                      j1, n_threads);
+}
+
+uint32_t CCL_LSL_apply_packed(CCL_data_t* data, const uint64_t** img_in, const uint8_t* img_rows, uint16_t** img_out,
+                              const int n_threads) {
+    return _CCL_LSL_apply_packed(data->er, data->era, data->rlc, data->eq, data->ner, img_in, img_rows, img_out,
+                                 data->i0, data->i1, data->j0, data->j1, n_threads);
+}
+
+uint32_t _CCL_LSL_apply_with_features(uint16_t** data_er, uint32_t** data_era, uint16_t** data_rlc,
+                                      uint32_t* data_eq, uint32_t* data_ner, const uint8_t** img_in,
+                                      const uint8_t* img_rows, uint16_t** img_out, const int i0, const int i1,
+                                      const int j0, const int j1, const int n_threads, uint16_t* ROI_id,
+                                      uint16_t* ROI_xmin, uint16_t* ROI_xmax, uint16_t* ROI_ymin, uint16_t* ROI_ymax,
+                                      uint32_t* ROI_S, uint32_t* ROI_Sx, uint32_t* ROI_Sy, uint64_t* ROI_Sxx,
+                                      uint64_t* ROI_Syy, uint64_t* ROI_Sxy, float* ROI_x, float* ROI_y) {
+    const uint32_t trueN = _LSL_apply(data_er, data_era, data_rlc, data_eq, data_ner, img_in, NULL, img_rows,
+                                      img_out, i0, i1, j0, j1, n_threads);
+    _LSL_features((const uint16_t**)data_er, (const uint32_t**)data_era, (const uint16_t**)data_rlc, data_eq,
+                  data_ner, i0, i1, j0, j1, trueN, ROI_id, ROI_xmin, ROI_xmax, ROI_ymin, ROI_ymax, ROI_S, ROI_Sx,
+                  ROI_Sy, ROI_Sxx, ROI_Syy, ROI_Sxy, ROI_x, ROI_y);
     return trueN;
 }
 
-uint32_t CCL_LSL_apply(CCL_data_t* data, const uint8_t** img_in, uint32_t** img_out) {
-    return _CCL_LSL_apply(data->er, data->era, data->rlc, data->eq, data->ner, img_in, img_out, data->i0, data->i1,
-                          data->j0, data->j1);
+uint32_t CCL_LSL_apply_with_features(CCL_data_t* data, const uint8_t** img_in, const uint8_t* img_rows,
+                                     uint16_t** img_out, ROI_t* ROI_array, const int n_threads) {
+    features_init_ROI_array(ROI_array);
+    ROI_array->_size = _CCL_LSL_apply_with_features(data->er, data->era, data->rlc, data->eq, data->ner, img_in,
+                                                    img_rows, img_out, data->i0, data->i1, data->j0, data->j1,
+                                                    n_threads, ROI_array->id, ROI_array->xmin, ROI_array->xmax,
+                                                    ROI_array->ymin, ROI_array->ymax, ROI_array->S, ROI_array->Sx,
+                                                    ROI_array->Sy, ROI_array->Sxx, ROI_array->Syy, ROI_array->Sxy,
+                                                    ROI_array->x, ROI_array->y);
+    return ROI_array->_size;
+}
+
+uint32_t _CCL_LSL_apply_packed_with_features(uint16_t** data_er, uint32_t** data_era, uint16_t** data_rlc,
+                                             uint32_t* data_eq, uint32_t* data_ner, const uint64_t** img_in,
+                                             const uint8_t* img_rows, uint16_t** img_out, const int i0,
+                                             const int i1, const int j0, const int j1, const int n_threads,
+                                             uint16_t* ROI_id, uint16_t* ROI_xmin, uint16_t* ROI_xmax,
+                                             uint16_t* ROI_ymin, uint16_t* ROI_ymax, uint32_t* ROI_S,
+                                             uint32_t* ROI_Sx, uint32_t* ROI_Sy, uint64_t* ROI_Sxx, uint64_t* ROI_Syy,
+                                             uint64_t* ROI_Sxy, float* ROI_x, float* ROI_y) {
+    const uint32_t trueN = _LSL_apply(data_er, data_era, data_rlc, data_eq, data_ner, NULL, img_in, img_rows,
+                                      img_out, i0, i1, j0, j1, n_threads);
+    _LSL_features((const uint16_t**)data_er, (const uint32_t**)data_era, (const uint16_t**)data_rlc, data_eq,
+                  data_ner, i0, i1, j0, j1, trueN, ROI_id, ROI_xmin, ROI_xmax, ROI_ymin, ROI_ymax, ROI_S, ROI_Sx,
+                  ROI_Sy, ROI_Sxx, ROI_Syy, ROI_Sxy, ROI_x, ROI_y);
+    return trueN;
+}
+
+uint32_t CCL_LSL_apply_packed_with_features(CCL_data_t* data, const uint64_t** img_in, const uint8_t* img_rows,
+                                            uint16_t** img_out, ROI_t* ROI_array, const int n_threads) {
+    features_init_ROI_array(ROI_array);
+    ROI_array->_size = _CCL_LSL_apply_packed_with_features(data->er, data->era, data->rlc, data->eq, data->ner,
+                                                           img_in, img_rows, img_out, data->i0, data->i1, data->j0,
+                                                           data->j1, n_threads, ROI_array->id, ROI_array->xmin,
+                                                           ROI_array->xmax, ROI_array->ymin, ROI_array->ymax,
+                                                           ROI_array->S, ROI_array->Sx, ROI_array->Sy, ROI_array->Sxx,
+                                                           ROI_array->Syy, ROI_array->Sxy, ROI_array->x, ROI_array->y);
+    return ROI_array->_size;
+}
+
+uint32_t _CCL_LSL_threshold_apply_with_features(uint16_t** data_er, uint32_t** data_era, uint16_t** data_rlc,
+                                                uint32_t* data_eq, uint32_t* data_ner, uint8_t** data_band,
+                                                uint8_t* data_band_rows, const uint8_t** img_in,
+                                                uint8_t** img_max_out, uint16_t** img_out, uint8_t* rows_min,
+                                                uint8_t* rows_max, const int i0, const int i1, const int j0,
+                                                const int j1, const uint8_t threshold_min,
+                                                const uint8_t threshold_max, const int band_size,
+                                                const int n_threads, uint16_t* ROI_id, uint16_t* ROI_xmin,
+                                                uint16_t* ROI_xmax, uint16_t* ROI_ymin, uint16_t* ROI_ymax,
+                                                uint32_t* ROI_S, uint32_t* ROI_Sx, uint32_t* ROI_Sy, uint64_t* ROI_Sxx,
+                                                uint64_t* ROI_Syy, uint64_t* ROI_Sxy, float* ROI_x, float* ROI_y) {
+    const uint32_t trueN = _LSL_label_band(data_er, data_era, data_rlc, data_eq, data_ner, data_band,
+                                           data_band_rows, img_in, img_max_out, img_out, rows_min, rows_max, i0, i1,
+                                           j0, j1, threshold_min, threshold_max, band_size, n_threads);
+    _LSL_final_labeling(data_er, data_era, data_rlc, data_eq, data_ner, img_out, i0, i1, n_threads);
+    _LSL_features((const uint16_t**)data_er, (const uint32_t**)data_era, (const uint16_t**)data_rlc, data_eq,
+                  data_ner, i0, i1, j0, j1, trueN, ROI_id, ROI_xmin, ROI_xmax, ROI_ymin, ROI_ymax, ROI_S, ROI_Sx,
+                  ROI_Sy, ROI_Sxx, ROI_Syy, ROI_Sxy, ROI_x, ROI_y);
+    return trueN;
+}
+
+uint32_t CCL_LSL_threshold_apply_with_features(CCL_data_t* data, const uint8_t** img_in, uint8_t** img_max_out,
+                                               uint16_t** img_out, uint8_t* rows_min, uint8_t* rows_max,
+                                               const uint8_t threshold_min, const uint8_t threshold_max,
+                                               const int band_size, ROI_t* ROI_array, const int n_threads) {
+    features_init_ROI_array(ROI_array);
+    ROI_array->_size = _CCL_LSL_threshold_apply_with_features(data->er, data->era, data->rlc, data->eq, data->ner,
+                                                              data->band, data->band_rows, img_in, img_max_out,
+                                                              img_out, rows_min, rows_max, data->i0, data->i1,
+                                                              data->j0, data->j1, threshold_min, threshold_max,
+                                                              band_size, n_threads, ROI_array->id,
+                                                              ROI_array->xmin, ROI_array->xmax, ROI_array->ymin,
+                                                              ROI_array->ymax, ROI_array->S, ROI_array->Sx,
+                                                              ROI_array->Sy, ROI_array->Sxx, ROI_array->Syy,
+                                                              ROI_array->Sxy, ROI_array->x, ROI_array->y);
+    return ROI_array->_size;
+}
+
+// foreground pixels of a 2x2 block: | A B |
+//                                   | C D |
+#define BLK_A 0x1
+#define BLK_B 0x2
+#define BLK_C 0x4
+#define BLK_D 0x8
+
+CCL_block_data_t* CCL_block_alloc_and_init_data(int i0, int i1, int j0, int j1) {
+    CCL_block_data_t* data = (CCL_block_data_t*)malloc(sizeof(CCL_block_data_t));
+    data->i0 = i0;
+    data->i1 = i1;
+    data->j0 = j0;
+    data->j1 = j1;
+    const int nbi = ((i1 - i0) + 2) / 2;
+    const int nbj = ((j1 - j0) + 2) / 2;
+    const long n = (long)nbi * nbj;
+    data->blk = ui32matrix(0, nbi - 1, 0, nbj - 1);
+    // one line of empty blocks above and one column of empty blocks on each side: no bound check on the neighbours
+    data->msk = ui8matrix(-1, nbi - 1, -1, nbj);
+    zero_ui8matrix(data->msk, -1, nbi - 1, -1, nbj);
+    data->eq = ui32vector(0, n);
+    data->lut = ui32vector(0, n);
+    return data;
+}
+
+void CCL_block_free_data(CCL_block_data_t* data) {
+    const int nbi = ((data->i1 - data->i0) + 2) / 2;
+    const int nbj = ((data->j1 - data->j0) + 2) / 2;
+    const long n = (long)nbi * nbj;
+    free_ui32matrix(data->blk, 0, nbi - 1, 0, nbj - 1);
+    free_ui8matrix(data->msk, -1, nbi - 1, -1, nbj);
+    free_ui32vector(data->eq, 0, n);
+    free_ui32vector(data->lut, 0, n);
+    free(data);
+}
+
+// merges the provisional label 'e' (0 = no label yet) with the provisional label 'f', returns the resulting root
+static inline uint32_t _block_merge(uint32_t* data_eq, const uint32_t e, const uint32_t f) {
+    const uint32_t rf = _LSL_find(data_eq, f);
+    if (!e)
+        return rf;
+    const uint32_t re = _LSL_find(data_eq, e);
+    if (re < rf) {
+        data_eq[rf] = re;
+        return re;
+    }
+    data_eq[re] = rf;
+    return rf;
+}
+
+uint32_t _CCL_block_apply(uint32_t** data_blk, uint8_t** data_msk, uint32_t* data_eq, uint32_t* data_lut,
+                          const uint8_t** img_in, uint16_t** img_out, const int i0, const int i1, const int j0,
+                          const int j1) {
+    const int nbi = ((i1 - i0) + 2) / 2;
+    const int nbj = ((j1 - j0) + 2) / 2;
+
+    // first scan: masks of the blocks and provisional labels
+    uint32_t n = 0;
+    for (int bi = 0; bi < nbi; bi++) {
+        const int i = i0 + 2 * bi;
+        const uint8_t* l0 = img_in[i];
+        const uint8_t* l1 = (i + 1 <= i1) ? img_in[i + 1] : NULL;
+        uint8_t* msk = data_msk[bi];
+        int bj = 0;
+        for (int j = j0; j < j1; j += 2, bj++)
+            msk[bj] = (l0[j] ? BLK_A : 0) | (l0[j + 1] ? BLK_B : 0) |
+                      (l1 ? ((l1[j] ? BLK_C : 0) | (l1[j + 1] ? BLK_D : 0)) : 0);
+        if (bj < nbj) // last column of an image with an odd width
+            msk[bj] = (l0[j1] ? BLK_A : 0) | ((l1 && l1[j1]) ? BLK_C : 0);
+
+        const uint8_t* msk_up = data_msk[bi - 1];
+        const uint32_t* blk_up = (bi > 0) ? data_blk[bi - 1] : NULL;
+        uint32_t* blk = data_blk[bi];
+        for (bj = 0; bj < nbj; bj++) {
+            const uint8_t x = msk[bj];
+            if (!x)
+                continue;
+            // 8-connectivity: the pixels of two neighbouring blocks are connected if they touch
+            uint32_t e = 0;
+            if ((x & (BLK_A | BLK_B)) && (msk_up[bj] & (BLK_C | BLK_D)))
+                e = _block_merge(data_eq, e, blk_up[bj]);
+            if ((x & BLK_A) && (msk_up[bj - 1] & BLK_D))
+                e = _block_merge(data_eq, e, blk_up[bj - 1]);
+            if ((x & BLK_B) && (msk_up[bj + 1] & BLK_C))
+                e = _block_merge(data_eq, e, blk_up[bj + 1]);
+            if ((x & (BLK_A | BLK_C)) && (msk[bj - 1] & (BLK_B | BLK_D)))
+                e = _block_merge(data_eq, e, blk[bj - 1]);
+            if (!e) {
+                e = ++n;
+                data_eq[e] = e;
+            }
+            blk[bj] = e;
+        }
+    }
+
+    // the roots are always smaller than their children: one pass in the increasing order flattens the table
+    for (uint32_t e = 1; e <= n; e++) {
+        data_eq[e] = data_eq[data_eq[e]];
+        data_lut[e] = 0;
+    }
+
+    // second scan: the CCs are numbered in the raster order of their first pixel (same labels as LSL)
+    uint32_t trueN = 0;
+    for (int i = i0; i <= i1; i++) {
+        const uint8_t* line = img_in[i];
+        const uint32_t* blk = data_blk[(i - i0) >> 1];
+        uint16_t* line_out = img_out[i];
+        for (int j = j0; j <= j1; j++) {
+            if (line[j]) {
+                const uint32_t r = data_eq[blk[(j - j0) >> 1]];
+                if (!data_lut[r]) {
+                    trueN++;
+                    data_lut[r] = trueN <= MAX_ROI_SIZE ? trueN : CCL_LABEL_DROPPED;
+                }
+                line_out[j] = data_lut[r] == CCL_LABEL_DROPPED ? 0 : (uint16_t)data_lut[r];
+            } else {
+                line_out[j] = 0;
+            }
+        }
+    }
+    if (trueN > MAX_ROI_SIZE) {
+        fprintf(stderr, "(WW) %u CCs, only the %d first ones are kept ('MAX_ROI_SIZE').\n", trueN, MAX_ROI_SIZE);
+        trueN = MAX_ROI_SIZE;
+    }
+    return trueN;
+}
+
+uint32_t CCL_block_apply(CCL_block_data_t* data, const uint8_t** img_in, uint16_t** img_out) {
+    return _CCL_block_apply(data->blk, data->msk, data->eq, data->lut, img_in, img_out, data->i0, data->i1, data->j0,
+                            data->j1);
+}
+
+enum ccl_impl_e CCL_string_to_impl(const char* string) {
+    if (!strcmp(string, CCL_IMPL_LSL_STR))
+        return CCL_IMPL_LSL;
+    if (!strcmp(string, CCL_IMPL_BLOCK_STR))
+        return CCL_IMPL_BLOCK;
+    return N_CCL_IMPL;
+}
+
+uint32_t CCL_impl_caps(const enum ccl_impl_e impl) {
+    switch (impl) {
+    case CCL_IMPL_LSL:
+        return CCL_CAP_FEATURES | CCL_CAP_THREADS | CCL_CAP_ROWS | CCL_CAP_PACKED | CCL_CAP_BAND;
+    case CCL_IMPL_BLOCK:
+        return 0;
+    default:
+        return 0;
+    }
+}
+
+CCL_gen_data_t* CCL_alloc_and_init_data(const enum ccl_impl_e impl, int i0, int i1, int j0, int j1,
+                                        const int n_threads) {
+    CCL_gen_data_t* data = (CCL_gen_data_t*)malloc(sizeof(CCL_gen_data_t));
+    data->impl = impl;
+    data->i0 = i0;
+    data->i1 = i1;
+    data->j0 = j0;
+    data->j1 = j1;
+    switch (impl) {
+    case CCL_IMPL_LSL:
+        data->metadata = (void*)CCL_LSL_alloc_and_init_data(i0, i1, j0, j1);
+        break;
+    case CCL_IMPL_BLOCK:
+        data->metadata = (void*)CCL_block_alloc_and_init_data(i0, i1, j0, j1);
+        break;
+    default:
+        fprintf(stderr, "(EE) Unknown CCL implementation (%d).\n", (int)impl);
+        exit(1);
+    }
+    data->ftr_bands = NULL;
+    if (n_threads > 1 && !(CCL_impl_caps(impl) & CCL_CAP_FEATURES))
+        data->ftr_bands = features_alloc_bands(n_threads, MAX_ROI_SIZE);
+    return data;
+}
+
+uint32_t CCL_apply(CCL_gen_data_t* data, const uint8_t** img_in, const uint8_t* img_rows, uint16_t** img_out,
+                   const int n_threads) {
+    switch (data->impl) {
+    case CCL_IMPL_LSL:
+        return CCL_LSL_apply((CCL_data_t*)data->metadata, img_in, img_rows, img_out, n_threads);
+    case CCL_IMPL_BLOCK:
+        return CCL_block_apply((CCL_block_data_t*)data->metadata, img_in, img_out);
+    default:
+        return 0;
+    }
+}
+
+uint32_t CCL_apply_with_features(CCL_gen_data_t* data, const uint8_t** img_in, const uint8_t* img_rows,
+                                 uint16_t** img_out, ROI_t* ROI_array, const int n_threads) {
+    if (data->impl == CCL_IMPL_LSL)
+        return CCL_LSL_apply_with_features((CCL_data_t*)data->metadata, img_in, img_rows, img_out, ROI_array,
+                                           n_threads);
+    const uint32_t n_ROI = CCL_apply(data, img_in, img_rows, img_out, n_threads);
+    features_extract((const uint16_t**)img_out, data->i0, data->i1, data->j0, data->j1, n_ROI, ROI_array,
+                     data->ftr_bands);
+    return n_ROI;
+}
+
+void CCL_free_data(CCL_gen_data_t* data) {
+    switch (data->impl) {
+    case CCL_IMPL_LSL:
+        CCL_LSL_free_data((CCL_data_t*)data->metadata);
+        break;
+    case CCL_IMPL_BLOCK:
+        CCL_block_free_data((CCL_block_data_t*)data->metadata);
+        break;
+    default:
+        break;
+    }
+    if (data->ftr_bands)
+        features_free_bands(data->ftr_bands);
+    free(data);
 }
@@ -2,96 +2,227 @@
 #include <string.h>
 #include <stdlib.h>
 #include <assert.h>
-#include <nrc2.h>
+#include <math.h>
 
+#include "fmdt/macros.h"
 #include "fmdt/tools.h"
 #include "fmdt/KPPV.h"
 
-#define INF32 0xFFFFFFFF
-#define MAX_DIST 100
+// minimal bid increment of the auction solver (the result is at most n_ROI0 * AUCTION_EPS away from the optimal)
+#define AUCTION_EPS 0.01f
+// maximum number of bids per candidate pair (bounds the latency of the auction solver on crowded frames)
+#define AUCTION_MAX_BIDS_PER_PAIR 64
 
-KKPV_data_t* KPPV_alloc_and_init_data(int i0, int i1, int j0, int j1) {
+KKPV_data_t* KPPV_alloc_and_init_data(const int max_k, const size_t max_ROI_size) {
     KKPV_data_t* data = (KKPV_data_t*)malloc(sizeof(KKPV_data_t));
-    data->i0 = i0;
-    data->i1 = i1;
-    data->j0 = j0;
-    data->j1 = j1;
-    data->nearest = (uint32_t**)ui32matrix(data->i0, data->i1, data->j0, data->j1);
-    data->distances = (float**)f32matrix(data->i0, data->i1, data->j0, data->j1);
-    data->conflicts = (uint32_t*)ui32vector(data->j0, data->j1);
-    zero_ui32matrix(data->nearest, data->i0, data->i1, data->j0, data->j1);
-    zero_f32matrix(data->distances, data->i0, data->i1, data->j0, data->j1);
-    zero_ui32vector(data->conflicts, data->j0, data->j1);
+    data->max_k = max_k;
+    data->max_ROI_size = max_ROI_size;
+    data->max_n_pairs = (size_t)max_k * max_ROI_size;
+    data->pairs_start = (uint32_t*)malloc((max_ROI_size + 1) * sizeof(uint32_t));
+    data->pairs_ROI0 = (uint32_t*)malloc(data->max_n_pairs * sizeof(uint32_t));
+    data->pairs_ROI1 = (uint32_t*)malloc(data->max_n_pairs * sizeof(uint32_t));
+    data->pairs_dist = (float*)malloc(data->max_n_pairs * sizeof(float));
+    data->pairs_rank = (uint32_t*)malloc(data->max_n_pairs * sizeof(uint32_t));
+    data->conflicts = (uint32_t*)malloc(max_ROI_size * sizeof(uint32_t));
+    data->pairs_start[0] = 0;
+    memset(data->conflicts, 0, max_ROI_size * sizeof(uint32_t));
+    data->grid_cells = (uint32_t*)malloc((KPPV_GRID_CELLS_PER_ROI * max_ROI_size + 1) * sizeof(uint32_t));
+    data->grid_ROI1 = (uint32_t*)malloc(max_ROI_size * sizeof(uint32_t));
+    data->candidates = (uint32_t*)malloc(max_ROI_size * sizeof(uint32_t));
+    data->candidates_dist = (float*)malloc(max_ROI_size * sizeof(float));
+    data->candidates_rank = (uint32_t*)malloc(max_ROI_size * sizeof(uint32_t));
+    data->rev_start = (uint32_t*)malloc((max_ROI_size + 1) * sizeof(uint32_t));
+    data->rev_pairs = (uint32_t*)malloc(data->max_n_pairs * sizeof(uint32_t));
+    data->heap = (uint32_t*)malloc(data->max_n_pairs * sizeof(uint32_t));
+    data->price = (float*)malloc(max_ROI_size * sizeof(float));
+    data->owner = (int32_t*)malloc(max_ROI_size * sizeof(int32_t));
+    data->assigned = (int32_t*)malloc(max_ROI_size * sizeof(int32_t));
+    data->queue = (uint32_t*)malloc(max_ROI_size * sizeof(uint32_t));
     return data;
 }
 
 void KPPV_free_data(KKPV_data_t* data) {
-    free_ui32matrix(data->nearest, data->i0, data->i1, data->j0, data->j1);
-    free_f32matrix(data->distances, data->i0, data->i1, data->j0, data->j1);
-    free_ui32vector(data->conflicts, data->j0, data->j1);
+    free(data->pairs_start);
+    free(data->pairs_ROI0);
+    free(data->pairs_ROI1);
+    free(data->pairs_dist);
+    free(data->pairs_rank);
+    free(data->conflicts);
+    free(data->grid_cells);
+    free(data->grid_ROI1);
+    free(data->candidates);
+    free(data->candidates_dist);
+    free(data->candidates_rank);
+    free(data->rev_start);
+    free(data->rev_pairs);
+    free(data->heap);
+    free(data->price);
+    free(data->owner);
+    free(data->assigned);
+    free(data->queue);
     free(data);
 }
 
-void _compute_distance(const float* ROI0_x, const float* ROI0_y, const size_t n_ROI0, const float* ROI1_x,
-                       const float* ROI1_y, const size_t n_ROI1, float** distances) {
-    // parcours des stats 0
-    for (size_t i = 0; i < n_ROI0; i++) {
-        float x0 = ROI0_x[i];
-        float y0 = ROI0_y[i];
+enum asso_e KPPV_string_to_asso(const char* string) {
+    if (!strcmp(string, ASSO_RANK_STR))
+        return ASSO_RANK;
+    if (!strcmp(string, ASSO_GREEDY_STR))
+        return ASSO_GREEDY;
+    if (!strcmp(string, ASSO_AUCTION_STR))
+        return ASSO_AUCTION;
+    return N_ASSO;
+}
 
-        // parcours des stats 1
-        for (size_t j = 0; j < n_ROI1; j++) {
-            float x1 = ROI1_x[j];
-            float y1 = ROI1_y[j];
+typedef struct {
+    float x0, y0; // origin of the grid (= top left ROI1 centroid)
+    float side; // side of a cell (in pixels)
+    int nx, ny; // number of cells per row / per column
+} grid_t;
+
+// Buckets the ROI1 centroids into a uniform grid. The cells are stored in a CSR way: the ROI1 in the cell 'c' are
+// 'grid_ROI1[grid_cells[c]]' to 'grid_ROI1[grid_cells[c + 1] - 1]' (sorted by increasing index).
+static grid_t _grid_build(const float* ROI1_x, const float* ROI1_y, const size_t n_ROI1, const float max_dist,
+                          uint32_t* grid_cells, uint32_t* grid_ROI1) {
+    // the minimal side of a cell has to be strictly larger than sqrt(max_dist) so that all the ROI1 closer than
+    // 'max_dist' from a ROI0 are in the 3x3 cells around the ROI0 cell
+    grid_t grid = {0.f, 0.f, sqrtf(max_dist) + 1.f, 0, 0};
+    if (!n_ROI1)
+        return grid;
+
+    float xmin = ROI1_x[0], xmax = ROI1_x[0], ymin = ROI1_y[0], ymax = ROI1_y[0];
+    for (size_t j = 1; j < n_ROI1; j++) {
+        xmin = MIN(xmin, ROI1_x[j]);
+        xmax = MAX(xmax, ROI1_x[j]);
+        ymin = MIN(ymin, ROI1_y[j]);
+        ymax = MAX(ymax, ROI1_y[j]);
+    }
+    grid.x0 = xmin;
+    grid.y0 = ymin;
+    do {
+        grid.nx = (int)((xmax - xmin) / grid.side) + 1;
+        grid.ny = (int)((ymax - ymin) / grid.side) + 1;
+        if ((size_t)grid.nx * (size_t)grid.ny <= KPPV_GRID_CELLS_PER_ROI * n_ROI1)
+            break;
+        grid.side *= 2.f;
+    } while (1);
+
+    // counting sort of the ROI1 indices by cell
+    const int n_cells = grid.nx * grid.ny;
+    memset(grid_cells, 0, (n_cells + 1) * sizeof(uint32_t));
+    for (size_t j = 0; j < n_ROI1; j++) {
+        int c = (int)((ROI1_y[j] - grid.y0) / grid.side) * grid.nx + (int)((ROI1_x[j] - grid.x0) / grid.side);
+        grid_cells[c + 1]++;
+    }
+    for (int c = 0; c < n_cells; c++)
+        grid_cells[c + 1] += grid_cells[c];
+    for (size_t j = 0; j < n_ROI1; j++) {
+        int c = (int)((ROI1_y[j] - grid.y0) / grid.side) * grid.nx + (int)((ROI1_x[j] - grid.x0) / grid.side);
+        grid_ROI1[grid_cells[c]++] = j;
+    }
+    for (int c = n_cells; c > 0; c--)
+        grid_cells[c] = grid_cells[c - 1];
+    grid_cells[0] = 0;
 
-            // distances au carré
-            float d = (x1 - x0) * (x1 - x0) + (y1 - y0) * (y1 - y0);
+    return grid;
+}
 
-            // if d > MAX_DIST, on peut economiser l'accès mémoire (a implementer)
-            distances[i][j] = d;
+// Collects the ROI1 closer than 'max_dist' from (x0, y0) in 'candidates' (sorted by increasing index) and the
+// corresponding distances in 'candidates_dist'. Returns the number of candidates.
+static size_t _grid_search(const grid_t* grid, const uint32_t* grid_cells, const uint32_t* grid_ROI1,
+                           const float* ROI1_x, const float* ROI1_y, const float x0, const float y0,
+                           const float max_dist, uint32_t* candidates, float* candidates_dist) {
+    size_t n_candidates = 0;
+    const int cx = (int)floorf((x0 - grid->x0) / grid->side);
+    const int cy = (int)floorf((y0 - grid->y0) / grid->side);
+    for (int gy = MAX(cy - 1, 0); gy <= MIN(cy + 1, grid->ny - 1); gy++) {
+        for (int gx = MAX(cx - 1, 0); gx <= MIN(cx + 1, grid->nx - 1); gx++) {
+            const int c = gy * grid->nx + gx;
+            for (uint32_t g = grid_cells[c]; g < grid_cells[c + 1]; g++) {
+                const uint32_t j = grid_ROI1[g];
+                float x1 = ROI1_x[j];
+                float y1 = ROI1_y[j];
+
+                // distances au carré
+                float d = (x1 - x0) * (x1 - x0) + (y1 - y0) * (y1 - y0);
+                if (d < max_dist) {
+                    // insertion sort to keep the same order as a full scan of the ROI1
+                    size_t p = n_candidates++;
+                    while (p > 0 && candidates[p - 1] > j) {
+                        candidates[p] = candidates[p - 1];
+                        candidates_dist[p] = candidates_dist[p - 1];
+                        p--;
+                    }
+                    candidates[p] = j;
+                    candidates_dist[p] = d;
+                }
+            }
         }
     }
-}
-
-void compute_distance(float** distances, const ROI_t* ROI_array0, const ROI_t* ROI_array1) {
-    _compute_distance(ROI_array0->x, ROI_array0->y, ROI_array0->_size, ROI_array1->x, ROI_array1->y, ROI_array1->_size,
-                      distances);
+    return n_candidates;
 }
 
 void KPPV_match1(const float* ROI0_x, const float* ROI0_y, const size_t n_ROI0, const float* ROI1_x,
-                 const float* ROI1_y, const size_t n_ROI1, uint32_t** data_nearest, float** distances,
-                 uint32_t* data_conflicts, const int k) {
+                 const float* ROI1_y, const size_t n_ROI1, KKPV_data_t* data, const int k, const float max_dist,
+                 const double theta, const double tx, const double ty) {
     int k_index, val, cpt = 0;
+    assert(k <= data->max_k);
+    assert(n_ROI0 <= data->max_ROI_size);
+    assert(n_ROI1 <= data->max_ROI_size);
 
     // vecteur de conflits pour debug
-    // zero_ui32vector(data_conflicts, 0, ROI_array1->size);
+    // memset(data->conflicts, 0, n_ROI1 * sizeof(uint32_t));
+
+    // the ROI1 are bucketed in a grid so only the ROI1 close to each ROI0 are visited (instead of all the ROI1)
+    const grid_t grid = _grid_build(ROI1_x, ROI1_y, n_ROI1, max_dist, data->grid_cells, data->grid_ROI1);
 
-    zero_ui32matrix(data_nearest, 0, n_ROI0, 0, n_ROI1);
+    // the ROI0 are moved with the previous rigid transformation before to look for their neighbours (no motion
+    // prediction if the transformation is the identity or could not be computed)
+    const int predict = (theta != 0. || tx != 0. || ty != 0.) && isfinite(theta) && isfinite(tx) && isfinite(ty);
+    const float cos_theta = (float)cos(theta), sin_theta = (float)sin(theta);
 
-    // calculs de toutes les distances euclidiennes au carré entre nc0 et nc1
-    _compute_distance(ROI0_x, ROI0_y, n_ROI0, ROI1_x, ROI1_y, n_ROI1, distances);
+    size_t n_pairs = 0;
+    for (size_t i = 0; i < n_ROI0; i++) {
+        data->pairs_start[i] = n_pairs;
+        if (!n_ROI1)
+            continue;
 
-    // les k plus proches voisins dans l'ordre croissant
-    for (k_index = 1; k_index <= k; k_index++) {
-        // parcours des distances
-        for (size_t i = 0; i < n_ROI0; i++) {
-            for (size_t j = 0; j < n_ROI1; j++) {
-                // if une distance est calculée et ne fait pas pas déjà parti du tab data_nearest
-                if ((distances[i][j] != INF32) && (data_nearest[i][j] == 0) && (distances[i][j] < MAX_DIST)) {
-                    val = distances[i][j];
+        float x0 = ROI0_x[i];
+        float y0 = ROI0_y[i];
+        if (predict) {
+            x0 = (float)tx + ROI0_x[i] * cos_theta - ROI0_y[i] * sin_theta;
+            y0 = (float)ty + ROI0_x[i] * sin_theta + ROI0_y[i] * cos_theta;
+        }
+
+        // calculs des distances euclidiennes au carré entre la CC i de nc0 et ses voisines de nc1 (< max_dist)
+        const size_t n_candidates = _grid_search(&grid, data->grid_cells, data->grid_ROI1, ROI1_x, ROI1_y, x0, y0,
+                                                 max_dist, data->candidates, data->candidates_dist);
+        memset(data->candidates_rank, 0, n_candidates * sizeof(uint32_t));
+
+        // les k plus proches voisins dans l'ordre croissant
+        for (k_index = 1; k_index <= k; k_index++) {
+            // parcours des distances
+            for (size_t c = 0; c < n_candidates; c++) {
+                // if la distance ne fait pas pas déjà parti des k plus proches voisins
+                if (data->candidates_rank[c] == 0) {
+                    val = data->candidates_dist[c];
                     cpt = 0;
-                    // // compte le nombre de distances < val
-                    for (size_t l = 0; l < n_ROI1; l++) {
-                        if ((distances[i][l] < val) && (distances[i][l] != INF32)) {
+                    // compte le nombre de distances < val (the other ROI1 are farther than max_dist)
+                    for (size_t l = 0; l < n_candidates; l++) {
+                        if (data->candidates_dist[l] < val) {
                             cpt++;
                         }
                     }
                     // k_index-ième voisin
                     if (cpt < k_index) {
-                        data_nearest[i][j] = k_index;
+                        data->candidates_rank[c] = k_index;
+                        data->pairs_ROI0[n_pairs] = i;
+                        data->pairs_ROI1[n_pairs] = data->candidates[c];
+                        data->pairs_dist[n_pairs] = data->candidates_dist[c];
+                        data->pairs_rank[n_pairs] = k_index;
+                        n_pairs++;
                         // vecteur de conflits
                         // if (k_index == 1){
-                        //         data_conflicts[j]++;
+                        //         data->conflicts[data->candidates[c]]++;
                         // }
                         break;
                     }
@@ -99,83 +230,186 @@ void KPPV_match1(const float* ROI0_x, const float* ROI0_y, const size_t n_ROI0,
             }
         }
     }
+    data->pairs_start[n_ROI0] = n_pairs;
 }
 
-void KPPV_match2(const uint32_t** data_nearest, const float** distances, const uint16_t* ROI0_id, int32_t* ROI0_next_id,
-                 const size_t n_ROI0, const uint16_t* ROI1_id, int32_t* ROI1_prev_id, const size_t n_ROI1) {
+// Builds the reverse adjacency of the candidate pairs: the pairs that involve the ROI1 'j' are
+// 'rev_pairs[rev_start[j]]' to 'rev_pairs[rev_start[j + 1] - 1]' (sorted by increasing ROI0 index).
+static void _KPPV_reverse_pairs(const KKPV_data_t* data, const size_t n_ROI0, const size_t n_ROI1, uint32_t* rev_start,
+                                uint32_t* rev_pairs) {
+    const size_t n_pairs = data->pairs_start[n_ROI0];
+    memset(rev_start, 0, (n_ROI1 + 1) * sizeof(uint32_t));
+    for (size_t p = 0; p < n_pairs; p++)
+        rev_start[data->pairs_ROI1[p] + 1]++;
+    for (size_t j = 0; j < n_ROI1; j++)
+        rev_start[j + 1] += rev_start[j];
+    for (size_t p = 0; p < n_pairs; p++)
+        rev_pairs[rev_start[data->pairs_ROI1[p]]++] = p;
+    for (size_t j = n_ROI1; j > 0; j--)
+        rev_start[j] = rev_start[j - 1];
+    rev_start[0] = 0;
+}
+
+void KPPV_match2(KKPV_data_t* data, const uint16_t* ROI0_id, int32_t* ROI0_next_id, const size_t n_ROI0,
+                 const uint16_t* ROI1_id, int32_t* ROI1_prev_id, const size_t n_ROI1) {
+    _KPPV_reverse_pairs(data, n_ROI0, n_ROI1, data->rev_start, data->rev_pairs);
+
     uint32_t rang = 1;
     for (size_t i = 0; i < n_ROI0; i++) {
     change:
-        for (size_t j = 0; j < n_ROI1; j++) {
-            // si pas encore associé
-            if (!ROI1_prev_id[j]) {
-                // si ROI_array1->data[j] est dans les voisins de ROI0
-                if (data_nearest[i][j] == rang) {
-                    float d = distances[i][j];
-                    // test s'il existe une autre CC de ROI0 de mm rang et plus proche
-                    for (size_t k = i + 1; k < n_ROI0; k++) {
-                        if (data_nearest[k][j] == rang && distances[k][j] < d) {
-                            rang++;
-                            goto change;
-                        }
-                    }
-                    // association
-                    ROI0_next_id[i] = ROI1_id[j];
-                    ROI1_prev_id[j] = ROI0_id[i];
+        for (uint32_t p = data->pairs_start[i]; p < data->pairs_start[i + 1]; p++) {
+            // si ROI_array1->data[j] est dans les voisins de ROI0
+            if (data->pairs_rank[p] == rang) {
+                const uint32_t j = data->pairs_ROI1[p];
+                // si pas encore associé
+                if (ROI1_prev_id[j])
                     break;
+                float d = data->pairs_dist[p];
+                // test s'il existe une autre CC de ROI0 de mm rang et plus proche
+                for (uint32_t r = data->rev_start[j]; r < data->rev_start[j + 1]; r++) {
+                    const uint32_t q = data->rev_pairs[r];
+                    if (data->pairs_ROI0[q] > i && data->pairs_rank[q] == rang && data->pairs_dist[q] < d) {
+                        rang++;
+                        goto change;
+                    }
                 }
+                // association
+                ROI0_next_id[i] = ROI1_id[j];
+                ROI1_prev_id[j] = ROI0_id[i];
+                break;
             }
         }
         rang = 1;
     }
 }
 
-void _KPPV_match(uint32_t** data_nearest, float** data_distances, uint32_t* data_conflicts, const uint16_t* ROI0_id,
-                 const float* ROI0_x, const float* ROI0_y, int32_t* ROI0_next_id, const size_t n_ROI0,
-                 const uint16_t* ROI1_id, const float* ROI1_x, const float* ROI1_y, int32_t* ROI1_prev_id, const
-                 size_t n_ROI1, const int k) {
-    KPPV_match1(ROI0_x, ROI0_y, n_ROI0, ROI1_x, ROI1_y, n_ROI1, data_nearest, data_distances, data_conflicts, k);
-    KPPV_match2((const uint32_t**)data_nearest, (const float**)data_distances, ROI0_id, ROI0_next_id, n_ROI0, ROI1_id,
-                ROI1_prev_id, n_ROI1);
+// returns 1 if the pair 'a' has to be associated before the pair 'b' (the closest first, then the pairs order)
+static inline int _pair_before(const float* pairs_dist, const uint32_t a, const uint32_t b) {
+    return pairs_dist[a] < pairs_dist[b] || (pairs_dist[a] == pairs_dist[b] && a < b);
 }
 
-void KPPV_match(KKPV_data_t* data, ROI_t* ROI_array0, ROI_t* ROI_array1, const int k) {
-    _KPPV_match(data->nearest, data->distances, data->conflicts, ROI_array0->id, ROI_array0->x, ROI_array0->y,
-                ROI_array0->next_id, ROI_array0->_size, ROI_array1->id, ROI_array1->x, ROI_array1->y,
-                ROI_array1->prev_id, ROI_array1->_size, k);
+static void _heap_sift_down(uint32_t* heap, const size_t n, size_t h, const float* pairs_dist) {
+    while (1) {
+        size_t m = h, l = 2 * h + 1, r = 2 * h + 2;
+        if (l < n && _pair_before(pairs_dist, heap[l], heap[m]))
+            m = l;
+        if (r < n && _pair_before(pairs_dist, heap[r], heap[m]))
+            m = r;
+        if (m == h)
+            return;
+        uint32_t tmp = heap[h];
+        heap[h] = heap[m];
+        heap[m] = tmp;
+        h = m;
+    }
 }
 
-void KPPV_save_asso(const char* filename, const uint32_t** data_nearest, const float** data_distances,
-                    ROI_t* ROI_array) {
-    FILE* f = fopen(filename, "w");
-    if (f == NULL) {
-        fprintf(stderr, "(EE) error ouverture %s \n", filename);
-        exit(1);
+void KPPV_asso_greedy(KKPV_data_t* data, const uint16_t* ROI0_id, int32_t* ROI0_next_id, const size_t n_ROI0,
+                      const uint16_t* ROI1_id, int32_t* ROI1_prev_id) {
+    size_t n = data->pairs_start[n_ROI0];
+    for (size_t p = 0; p < n; p++)
+        data->heap[p] = p;
+    for (size_t h = n / 2; h > 0; h--)
+        _heap_sift_down(data->heap, n, h - 1, data->pairs_dist);
+
+    while (n) {
+        const uint32_t p = data->heap[0];
+        data->heap[0] = data->heap[--n];
+        _heap_sift_down(data->heap, n, 0, data->pairs_dist);
+
+        const uint32_t i = data->pairs_ROI0[p];
+        const uint32_t j = data->pairs_ROI1[p];
+        if (!ROI0_next_id[i] && !ROI1_prev_id[j]) {
+            ROI0_next_id[i] = ROI1_id[j];
+            ROI1_prev_id[j] = ROI0_id[i];
+        }
     }
+}
 
-    // tmp (le temps de mettre à jour n)
-    int cpt = 0;
-    for (size_t i = 0; i < ROI_array->_size; i++) {
-        if (ROI_array->S[i] != 0 && ROI_array->next_id[i])
-            cpt++;
+void KPPV_asso_auction(KKPV_data_t* data, const uint16_t* ROI0_id, int32_t* ROI0_next_id, const size_t n_ROI0,
+                       const uint16_t* ROI1_id, int32_t* ROI1_prev_id, const size_t n_ROI1, const float max_dist) {
+    const size_t n_pairs = data->pairs_start[n_ROI0];
+    const size_t max_n_bids = AUCTION_MAX_BIDS_PER_PAIR * n_pairs;
+    size_t q_head = 0, q_size = 0;
+    for (size_t j = 0; j < n_ROI1; j++) {
+        data->price[j] = 0.f;
+        data->owner[j] = -1;
+    }
+    for (size_t i = 0; i < n_ROI0; i++) {
+        data->assigned[i] = -1;
+        if (data->pairs_start[i + 1] > data->pairs_start[i])
+            data->queue[q_size++] = i;
     }
-    if (cpt != 0) {
-
-        fprintf(f, "%d\n", cpt);
-
-        size_t j;
-        for (size_t i = 0; i < ROI_array->_size; i++) {
-            if (!ROI_array->next_id[i]) {
-                if (ROI_array->S[i] > 0)
-                    fprintf(f, "%4lu \t ->   pas d'association\n", i);
-            } else {
-                j = (size_t)(ROI_array->next_id[i] - 1);
-                fprintf(f, "%4lu \t -> %4lu \t  : distance = %10.2f \t ; %4d-voisin\n", i, j, data_distances[i][j],
-                        data_nearest[i][j]);
+
+    // the unassigned ROI0 bid for their best ROI1 until all the ROI0 are assigned or prefer to stay unassigned
+    size_t n_bids = 0;
+    while (q_size && n_bids < max_n_bids) {
+        const uint32_t i = data->queue[q_head];
+        q_head = (q_head + 1) % n_ROI0;
+        q_size--;
+
+        // best and second best values, not being associated is always possible (value = 0)
+        int32_t best = -1;
+        float v1 = 0.f, v2 = 0.f;
+        for (uint32_t p = data->pairs_start[i]; p < data->pairs_start[i + 1]; p++) {
+            const float v = (max_dist - data->pairs_dist[p]) - data->price[data->pairs_ROI1[p]];
+            if (v > v1) {
+                v2 = v1;
+                v1 = v;
+                best = p;
+            } else if (v > v2) {
+                v2 = v;
             }
         }
+        if (best < 0)
+            continue;
+
+        const uint32_t j = data->pairs_ROI1[best];
+        data->price[j] += v1 - v2 + AUCTION_EPS;
+        if (data->owner[j] >= 0) {
+            data->assigned[data->owner[j]] = -1;
+            data->queue[(q_head + q_size) % n_ROI0] = data->owner[j];
+            q_size++;
+        }
+        data->owner[j] = i;
+        data->assigned[i] = best;
+        n_bids++;
     }
-    fclose(f);
+
+    for (size_t i = 0; i < n_ROI0; i++)
+        if (data->assigned[i] >= 0) {
+            const uint32_t j = data->pairs_ROI1[data->assigned[i]];
+            ROI0_next_id[i] = ROI1_id[j];
+            ROI1_prev_id[j] = ROI0_id[i];
+        }
+}
+
+void _KPPV_match(KKPV_data_t* data, const uint16_t* ROI0_id, const float* ROI0_x, const float* ROI0_y,
+                 int32_t* ROI0_next_id, const size_t n_ROI0, const uint16_t* ROI1_id, const float* ROI1_x,
+                 const float* ROI1_y, int32_t* ROI1_prev_id, const size_t n_ROI1, const int k, const float max_dist,
+                 const double theta, const double tx, const double ty, const enum asso_e asso) {
+    KPPV_match1(ROI0_x, ROI0_y, n_ROI0, ROI1_x, ROI1_y, n_ROI1, data, k, max_dist, theta, tx, ty);
+    switch (asso) {
+    case ASSO_RANK:
+        KPPV_match2(data, ROI0_id, ROI0_next_id, n_ROI0, ROI1_id, ROI1_prev_id, n_ROI1);
+        break;
+    case ASSO_GREEDY:
+        KPPV_asso_greedy(data, ROI0_id, ROI0_next_id, n_ROI0, ROI1_id, ROI1_prev_id);
+        break;
+    case ASSO_AUCTION:
+        KPPV_asso_auction(data, ROI0_id, ROI0_next_id, n_ROI0, ROI1_id, ROI1_prev_id, n_ROI1, max_dist);
+        break;
+    default:
+        fprintf(stderr, "(EE) Unknown association solver (%d).\n", (int)asso);
+        exit(1);
+    }
+}
+
+void KPPV_match(KKPV_data_t* data, ROI_t* ROI_array0, ROI_t* ROI_array1, const int k, const float max_dist,
+                const double theta, const double tx, const double ty, const enum asso_e asso) {
+    _KPPV_match(data, ROI_array0->id, ROI_array0->x, ROI_array0->y, ROI_array0->next_id, ROI_array0->_size,
+                ROI_array1->id, ROI_array1->x, ROI_array1->y, ROI_array1->prev_id, ROI_array1->_size, k, max_dist,
+                theta, tx, ty, asso);
 }
 
 void KPPV_save_asso_VT(const char* filename, int nc0, ROI_t* ROI_array, int frame) {
@@ -201,35 +435,10 @@ void KPPV_save_asso_VT(const char* filename, int nc0, ROI_t* ROI_array, int fram
     fclose(f);
 }
 
-void KPPV_conflicts_write(FILE* f, uint32_t* data_conflicts, uint32_t** data_nearest, float** data_distances,
-                          int n_asso, int n_conflict) {
-    // tmp (le temps de mettre à jour n)
-    int cpt = 0;
-    for (int i = 0; i < n_conflict; i++) {
-        if (data_conflicts[i] != 1 && data_conflicts[i] != 0)
-            cpt++;
-    }
-    if (cpt != 0) {
-
-        fprintf(f, "%d\n", cpt);
-
-        for (int j = 0; j < n_conflict; j++) {
-            if (data_conflicts[j] != 1 && data_conflicts[j] != 0) {
-                fprintf(f, "conflit CC = %4d : ", j);
-                for (int i = 0; i < n_asso; i++) {
-                    if (data_nearest[i][j] == 1) {
-                        fprintf(f, "%4d\t", i);
-                    }
-                }
-                fprintf(f, "\n");
-            }
-        }
-    }
-}
-
-void _KPPV_asso_conflicts_write(FILE* f, const uint32_t** KPPV_data_nearest, const float** KPPV_data_distances,
-                                const uint16_t* ROI_id, const uint32_t* ROI_S, const float* ROI_dx, const float* ROI_dy,
-                                const float* ROI_error, const int32_t* ROI_next_id, const size_t n_ROI) {
+void _KPPV_asso_conflicts_write(FILE* f, const uint32_t* KPPV_pairs_start, const uint32_t* KPPV_pairs_ROI1,
+                                const float* KPPV_pairs_dist, const uint32_t* KPPV_pairs_rank, const uint16_t* ROI_id,
+                                const uint32_t* ROI_S, const float* ROI_dx, const float* ROI_dy, const float* ROI_error,
+                                const int32_t* ROI_next_id, const size_t n_ROI) {
     // Asso
     int cpt = 0;
     for (size_t i = 0; i < n_ROI; i++) {
@@ -253,8 +462,15 @@ void _KPPV_asso_conflicts_write(FILE* f, const uint32_t** KPPV_data_nearest, con
             continue;
         if (ROI_next_id[i]) {
             j = (size_t)(ROI_next_id[i] - 1);
+            const uint32_t row_end = KPPV_pairs_start[i + 1];
+            uint32_t p = KPPV_pairs_start[i];
+            while (p < row_end && KPPV_pairs_ROI1[p] != j)
+                p++;
+            assert(p < row_end);
+            if (p == row_end) // the match is not in the candidates of 'i' (should never happen)
+                continue;
             fprintf(f, "  %4u | %4u || %6.2f | %4d || %5.1f | %5.1f | %6.3f \n", ROI_id[i], ROI_next_id[i],
-                    KPPV_data_distances[i][j], KPPV_data_nearest[i][j], ROI_dx[i], ROI_dy[i], ROI_error[i]);
+                    KPPV_pairs_dist[p], KPPV_pairs_rank[p], ROI_dx[i], ROI_dy[i], ROI_error[i]);
         }
     }
 
@@ -281,7 +497,7 @@ void _KPPV_asso_conflicts_write(FILE* f, const uint32_t** KPPV_data_nearest, con
 }
 
 void KPPV_asso_conflicts_write(FILE* f, const KKPV_data_t* KPPV_data, const ROI_t* ROI_array) {
-    _KPPV_asso_conflicts_write(f, (const uint32_t**)KPPV_data->nearest, (const float**)KPPV_data->distances,
-                               ROI_array->id, ROI_array->S, ROI_array->dx, ROI_array->dy, ROI_array->error,
-                               ROI_array->next_id, ROI_array->_size);
+    _KPPV_asso_conflicts_write(f, KPPV_data->pairs_start, KPPV_data->pairs_ROI1, KPPV_data->pairs_dist,
+                               KPPV_data->pairs_rank, ROI_array->id, ROI_array->S, ROI_array->dx, ROI_array->dy,
+                               ROI_array->error, ROI_array->next_id, ROI_array->_size);
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <math.h>
 #include <nrc2.h>
 
 #include "fmdt/args.h"
@@ -24,7 +25,15 @@ int main(int argc, char** argv) {
     int def_p_light_max = 80;
     int def_p_surface_min = 3;
     int def_p_surface_max = 1000;
+    float def_p_hot_axis_min = 0.f;
+    int def_p_ccl_threads = 1;
+    int def_p_ccl_band = 0;
+    char def_p_ccl_impl[] = CCL_IMPL_LSL_STR;
     int def_p_k = 3;
+    char def_p_knn_asso[] = ASSO_RANK_STR;
+    int def_p_knn_dist = 10;
+    int def_p_reg_max = 0;
+    int def_p_reg_iter = 3;
     int def_p_r_extrapol = 5;
     float def_p_angle_max = 20;
     int def_p_fra_star_min = 15;
@@ -71,9 +80,41 @@ int main(int argc, char** argv) {
         fprintf(stderr,
                 "  --surface-max       Minimum area of the CC                                                 [%d]\n",
                 def_p_surface_max);
+        fprintf(stderr,
+                "  --hot-axis-min      Minimum major semi-axis of the CC ellipse, sharper CCs are removed as      \n");
+        fprintf(stderr,
+                "                      hot pixels (0 = disabled)                                              [%f]\n",
+                def_p_hot_axis_min);
+        fprintf(stderr,
+                "  --ccl-threads       Number of threads of the connected-components labeling (OpenMP)       [%d]\n",
+                def_p_ccl_threads);
+        fprintf(stderr,
+                "  --ccl-band          Number of lines per band of the fused thresholds + CCL (0 = disabled)  [%d]\n",
+                def_p_ccl_band);
+        fprintf(stderr,
+                "  --ccl-impl          Connected-components labeling implementation ('LSL' or 'block')       [%s]\n",
+                def_p_ccl_impl);
         fprintf(stderr,
                 "  -k                  Number of neighbours                                                   [%d]\n",
                 def_p_k);
+        fprintf(stderr,
+                "  --knn-asso          Association solver for the k-nearest neighbours ('rank', 'greedy' or   \n");
+        fprintf(stderr,
+                "                      'auction')                                                             [%s]\n",
+                def_p_knn_asso);
+        fprintf(stderr,
+                "  --knn-dist          Maximum distance (in pixels) between two matched CCs                   [%d]\n",
+                def_p_knn_dist);
+        fprintf(stderr,
+                "  --knn-pred          Moves the CCs with the previous motion estimation before the matching      \n");
+        fprintf(stderr,
+                "  --reg-max           Maximum number of pairs of the robust motion estimation (0 = exact     \n");
+        fprintf(stderr,
+                "                      least squares on all the pairs, otherwise at least %2d)                 [%d]\n",
+                FEATURES_REG_GRID * FEATURES_REG_GRID, def_p_reg_max);
+        fprintf(stderr,
+                "  --reg-iter          Number of reweighting iterations of the robust motion estimation       [%d]\n",
+                def_p_reg_iter);
         fprintf(stderr,
                 "  --r-extrapol        Search radius for the next CC in case of extrapolation                 [%d]\n",
                 def_p_r_extrapol);
@@ -96,6 +137,12 @@ int main(int argc, char** argv) {
                 def_p_diff_dev);
         fprintf(stderr,
                 "  --track-all         Tracks all object types (star, meteor or noise)                            \n");
+        fprintf(stderr,
+                "  --bin-packed        Bit-packed binary images (1 bit per pixel) for the thresholds and the CCL  \n");
+        fprintf(stderr,
+                "  --stream            Unbounded streaming mode: the finished tracks are written on the fly and   \n");
+        fprintf(stderr,
+                "                      forgotten, the number of frames is not limited (without '--fra-end')       \n");
         fprintf(stderr,
                 "  -h                  This help                                                                  \n");
         exit(1);
@@ -109,7 +156,16 @@ int main(int argc, char** argv) {
     const int p_light_max = args_find_int(argc, argv, "--light-max", def_p_light_max);
     const int p_surface_min = args_find_int(argc, argv, "--surface-min", def_p_surface_min);
     const int p_surface_max = args_find_int(argc, argv, "--surface-max", def_p_surface_max);
+    const float p_hot_axis_min = args_find_float(argc, argv, "--hot-axis-min", def_p_hot_axis_min);
+    const int p_ccl_threads = args_find_int(argc, argv, "--ccl-threads", def_p_ccl_threads);
+    const int p_ccl_band = args_find_int(argc, argv, "--ccl-band", def_p_ccl_band);
+    const char* p_ccl_impl = args_find_char(argc, argv, "--ccl-impl", def_p_ccl_impl);
     const int p_k = args_find_int(argc, argv, "-k", def_p_k);
+    const char* p_knn_asso = args_find_char(argc, argv, "--knn-asso", def_p_knn_asso);
+    const int p_knn_dist = args_find_int(argc, argv, "--knn-dist", def_p_knn_dist);
+    const int p_knn_pred = args_find(argc, argv, "--knn-pred");
+    const int p_reg_max = args_find_int(argc, argv, "--reg-max", def_p_reg_max);
+    const int p_reg_iter = args_find_int(argc, argv, "--reg-iter", def_p_reg_iter);
     const int p_r_extrapol = args_find_int(argc, argv, "--r-extrapol", def_p_r_extrapol);
     const float p_angle_max = args_find_float(argc, argv, "--angle-max", def_p_angle_max);
     const int p_fra_star_min = args_find_int(argc, argv, "--fra-star-min", def_p_fra_star_min);
@@ -121,6 +177,9 @@ int main(int argc, char** argv) {
     const char* p_out_bb = args_find_char(argc, argv, "--out-bb", def_p_out_bb);
     const char* p_out_stats = args_find_char(argc, argv, "--out-stats", def_p_out_stats);
     const int p_track_all = args_find(argc, argv, "--track-all");
+    const int p_bin_packed = args_find(argc, argv, "--bin-packed");
+    const int p_stream = args_find(argc, argv, "--stream");
+    const size_t fra_end = (p_stream && !args_find(argc, argv, "--fra-end")) ? SIZE_MAX : (size_t)p_fra_end;
 
     // heading display
     printf("#  ---------------------\n");
@@ -136,13 +195,25 @@ int main(int argc, char** argv) {
     printf("#  * out-frames     = %s\n", p_out_frames);
     printf("#  * out-stats      = %s\n", p_out_stats);
     printf("#  * fra-start      = %d\n", p_fra_start);
-    printf("#  * fra-end        = %d\n", p_fra_end);
+    if (fra_end == SIZE_MAX)
+        printf("#  * fra-end        = none (stream)\n");
+    else
+        printf("#  * fra-end        = %lu\n", (unsigned long)fra_end);
     printf("#  * skip-fra       = %d\n", p_skip_fra);
     printf("#  * light-min      = %d\n", p_light_min);
     printf("#  * light-max      = %d\n", p_light_max);
     printf("#  * surface-min    = %d\n", p_surface_min);
     printf("#  * surface-max    = %d\n", p_surface_max);
+    printf("#  * hot-axis-min   = %4.2f\n", p_hot_axis_min);
+    printf("#  * ccl-threads    = %d\n", p_ccl_threads);
+    printf("#  * ccl-band       = %d\n", p_ccl_band);
+    printf("#  * ccl-impl       = %s\n", p_ccl_impl);
     printf("#  * k              = %d\n", p_k);
+    printf("#  * knn-asso       = %s\n", p_knn_asso);
+    printf("#  * knn-dist       = %d\n", p_knn_dist);
+    printf("#  * knn-pred       = %d\n", p_knn_pred);
+    printf("#  * reg-max        = %d\n", p_reg_max);
+    printf("#  * reg-iter       = %d\n", p_reg_iter);
     printf("#  * r-extrapol     = %d\n", p_r_extrapol);
     printf("#  * angle-max      = %f\n", p_angle_max);
     printf("#  * fra-star-min   = %d\n", p_fra_star_min);
@@ -150,6 +221,8 @@ int main(int argc, char** argv) {
     printf("#  * fra-meteor-max = %d\n", p_fra_meteor_max);
     printf("#  * diff-dev       = %4.2f\n", p_diff_dev);
     printf("#  * track-all      = %d\n", p_track_all);
+    printf("#  * bin-packed     = %d\n", p_bin_packed);
+    printf("#  * stream         = %d\n", p_stream);
     printf("#\n");
 
     // arguments checking
@@ -157,6 +230,66 @@ int main(int argc, char** argv) {
         fprintf(stderr, "(EE) '--in-video' is missing\n");
         exit(1);
     }
+    if (p_hot_axis_min < 0.f) {
+        fprintf(stderr, "(EE) '--hot-axis-min' has to be positive\n");
+        exit(1);
+    }
+    if (p_ccl_threads < 1) {
+        fprintf(stderr, "(EE) '--ccl-threads' has to be bigger than 0\n");
+        exit(1);
+    }
+#ifndef _OPENMP
+    if (p_ccl_threads > 1)
+        fprintf(stderr, "(WW) '--ccl-threads' has no effect (compiled without OpenMP)\n");
+#endif
+    if (p_ccl_band < 0) {
+        fprintf(stderr, "(EE) '--ccl-band' has to be positive\n");
+        exit(1);
+    }
+    if (p_ccl_band && p_bin_packed) {
+        fprintf(stderr, "(EE) '--ccl-band' and '--bin-packed' can't be combined\n");
+        exit(1);
+    }
+    const enum ccl_impl_e ccl_impl = CCL_string_to_impl(p_ccl_impl);
+    if (ccl_impl == N_CCL_IMPL) {
+        fprintf(stderr, "(EE) '--ccl-impl' has to be '%s' or '%s'\n", CCL_IMPL_LSL_STR, CCL_IMPL_BLOCK_STR);
+        exit(1);
+    }
+    const uint32_t ccl_caps = CCL_impl_caps(ccl_impl);
+    if (p_ccl_band && !(ccl_caps & CCL_CAP_BAND)) {
+        fprintf(stderr, "(EE) '--ccl-band' is not supported by the '%s' CCL implementation\n", p_ccl_impl);
+        exit(1);
+    }
+    if (p_bin_packed && !(ccl_caps & CCL_CAP_PACKED)) {
+        fprintf(stderr, "(EE) '--bin-packed' is not supported by the '%s' CCL implementation\n", p_ccl_impl);
+        exit(1);
+    }
+    if (p_ccl_threads > 1 && !(ccl_caps & CCL_CAP_THREADS))
+        fprintf(stderr, "(WW) '--ccl-threads' only applies to the features extraction with the '%s' CCL implementation\n",
+                p_ccl_impl);
+    const enum asso_e asso = KPPV_string_to_asso(p_knn_asso);
+    if (asso == N_ASSO) {
+        fprintf(stderr, "(EE) '--knn-asso' has to be '%s', '%s' or '%s'\n", ASSO_RANK_STR, ASSO_GREEDY_STR,
+                ASSO_AUCTION_STR);
+        exit(1);
+    }
+    if (p_knn_dist < 1) {
+        fprintf(stderr, "(EE) '--knn-dist' has to be bigger than 0\n");
+        exit(1);
+    }
+    if (p_reg_max < 0) {
+        fprintf(stderr, "(EE) '--reg-max' has to be positive\n");
+        exit(1);
+    }
+    if (p_reg_max > 0 && p_reg_max < FEATURES_REG_GRID * FEATURES_REG_GRID) {
+        fprintf(stderr, "(EE) '--reg-max' has to be 0 or at least %d (one pair per cell of the stratification grid)\n",
+                FEATURES_REG_GRID * FEATURES_REG_GRID);
+        exit(1);
+    }
+    if (p_reg_iter < 0) {
+        fprintf(stderr, "(EE) '--reg-iter' has to be positive\n");
+        exit(1);
+    }
     if (p_fra_star_min < 2) {
         fprintf(stderr, "(EE) '--fra-star-min' has to be bigger than 1\n");
         exit(1);
@@ -169,7 +302,7 @@ int main(int argc, char** argv) {
         fprintf(stderr, "(EE) '--fra-meteor-max' has to be bigger than '--fra-meteor-min'\n");
         exit(1);
     }
-    if ((p_fra_end - p_fra_start) > MAX_N_FRAMES) {
+    if (!p_stream && (p_fra_end - p_fra_start) > MAX_N_FRAMES) {
         fprintf(stderr, "(EE) '--fra-end' - '--fra-start' has to be lower than %d\n", MAX_N_FRAMES);
         exit(1);
     }
@@ -188,8 +321,8 @@ int main(int argc, char** argv) {
 
     int i0, i1, j0, j1; // image dimension (y_min, y_max, x_min, x_max)
     const size_t n_ffmpeg_threads = 0; // 0 = use all the threads available
-    video_t* video = video_init_from_file(p_in_video, p_fra_start, p_fra_end, p_skip_fra, n_ffmpeg_threads, &i0, &i1,
-                                          &j0, &j1);
+    video_t* video = video_init_from_file(p_in_video, p_fra_start, fra_end, p_skip_fra, n_ffmpeg_threads, &i0, &i1, &j0,
+                                          &j1);
 
     // ---------------- //
     // -- ALLOCATION -- //
@@ -199,79 +332,122 @@ int main(int argc, char** argv) {
     ROI_t* ROI_array0 = features_alloc_ROI_array(MAX_ROI_SIZE);
     ROI_t* ROI_array1 = features_alloc_ROI_array(MAX_ROI_SIZE);
     track_t* track_array = tracking_alloc_track_array(MAX_TRACKS_SIZE);
-    BB_t** BB_array = (BB_t**)malloc(MAX_N_FRAMES * sizeof(BB_t*));
+    BB_log_t* BB_log = tracking_alloc_BB_log(MAX_TRACKS_SIZE, 1);
     tracking_data_t* tracking_data = tracking_alloc_data(MAX(p_fra_star_min, p_fra_meteor_min), MAX_ROI_SIZE);
     int b = 1; // image border
     uint8_t **I = ui8matrix(i0 - b, i1 + b, j0 - b, j1 + b); // frame
-    uint8_t **SM_0 = ui8matrix(i0 - b, i1 + b, j0 - b, j1 + b); // hysteresis
     uint8_t **SM_1 = ui8matrix(i0 - b, i1 + b, j0 - b, j1 + b); // hysteresis
-    uint32_t **SM_2 = ui32matrix(i0 - b, i1 + b, j0 - b, j1 + b); // hysteresis
-    uint8_t **SH_0 = ui8matrix(i0 - b, i1 + b, j0 - b, j1 + b); // hysteresis
+    uint16_t **SM_2 = ui16matrix(i0 - b, i1 + b, j0 - b, j1 + b); // hysteresis
     uint8_t **SH_1 = ui8matrix(i0 - b, i1 + b, j0 - b, j1 + b); // hysteresis
     uint8_t **SH_2 = ui8matrix(i0 - b, i1 + b, j0 - b, j1 + b); // hysteresis
+    uint64_t **SM_1p = p_bin_packed ? tools_alloc_packed_matrix(i0, i1, j0, j1) : NULL; // hysteresis (bit-packed)
+    uint64_t **SH_1p = p_bin_packed ? tools_alloc_packed_matrix(i0, i1, j0, j1) : NULL; // hysteresis (bit-packed)
+    uint8_t *SM_rows = ui8vector(i0, i1); // non-empty lines of SM_1
+    uint8_t *SH_rows = ui8vector(i0, i1); // non-empty lines of SH_1
 
     // -------------------------- //
     // -- INITIALISATION MATRIX-- //
     // -------------------------- //
 
     tracking_init_global_data();
-    KKPV_data_t* kppv_data = KPPV_alloc_and_init_data(0, MAX_KPPV_SIZE, 0, MAX_KPPV_SIZE);
+    KKPV_data_t* kppv_data = KPPV_alloc_and_init_data(p_k, MAX_ROI_SIZE);
     features_init_ROI_array(ROI_array_tmp);
     features_init_ROI_array(ROI_array0);
     features_init_ROI_array(ROI_array1);
     tracking_init_track_array(track_array);
-    tracking_init_BB_array(BB_array);
+    tracking_init_BB_log(BB_log);
     tracking_init_data(tracking_data);
-    CCL_data_t* ccl_data = CCL_LSL_alloc_and_init_data(i0, i1, j0, j1);
+    CCL_gen_data_t* ccl_data = CCL_alloc_and_init_data(ccl_impl, i0, i1, j0, j1, p_ccl_threads);
     zero_ui8matrix(I, i0 - b, i1 + b, j0 - b, j1 + b);
-    zero_ui8matrix(SM_0, i0 - b, i1 + b, j0 - b, j1 + b);
     zero_ui8matrix(SM_1, i0 - b, i1 + b, j0 - b, j1 + b);
-    zero_ui32matrix(SM_2, i0 - b, i1 + b, j0 - b, j1 + b);
-    zero_ui8matrix(SH_0, i0 - b, i1 + b, j0 - b, j1 + b);
+    zero_ui16matrix(SM_2, i0 - b, i1 + b, j0 - b, j1 + b);
     zero_ui8matrix(SH_1, i0 - b, i1 + b, j0 - b, j1 + b);
     zero_ui8matrix(SH_2, i0 - b, i1 + b, j0 - b, j1 + b);
+    zero_ui8vector(SM_rows, i0, i1);
+    zero_ui8vector(SH_rows, i0, i1);
 
     // ----------------//
     // -- TRAITEMENT --//
     // ----------------//
 
     printf("# The program is running...\n");
+    // in streaming mode, the tracks and their bounding boxes are written as soon as they are finished
+    FILE* f_BB = NULL;
+    if (p_stream) {
+        if (p_out_bb && !(f_BB = fopen(p_out_bb, "w"))) {
+            fprintf(stderr, "(EE) error ouverture %s \n", p_out_bb);
+            exit(1);
+        }
+        printf("# Tracks [stream]:\n");
+        tracking_track_array_write_header(stdout);
+    }
     size_t real_n_tracks;
     unsigned n_frames = 0, n_stars = 0, n_meteors = 0, n_noise = 0;
+    double pred_theta = 0., pred_tx = 0., pred_ty = 0.; // motion used to predict the CC positions in the matching
+    double prev_theta = NAN, prev_tx = NAN, prev_ty = NAN; // warm start of the robust motion estimation
     while (video_get_next_frame(video, I)) {
         size_t frame = video->frame_current - 1;
-        assert(frame < MAX_N_FRAMES);
+        assert(p_stream || frame < MAX_N_FRAMES);
         fprintf(stderr, "(II) Frame n°%4lu", frame);
 
         // Step 1 : seuillage low/high
-        tools_copy_ui8matrix_ui8matrix((const uint8_t**)I, i0, i1, j0, j1, SH_0);
-        tools_copy_ui8matrix_ui8matrix((const uint8_t**)I, i0, i1, j0, j1, SM_0);
-        threshold_high((const uint8_t**)SM_0, SM_1, i0, i1, j0, j1, p_light_min);
-        threshold_high((const uint8_t**)SH_0, SH_1, i0, i1, j0, j1, p_light_max);
-
         // Step 2 : ECC/ACC
-        const int n_ROI = CCL_LSL_apply(ccl_data, (const uint8_t**)SM_1, SM_2);
-        features_extract((const uint32_t**)SM_2, i0, i1, j0, j1, n_ROI, ROI_array_tmp);
+        if (p_ccl_band) {
+            CCL_LSL_threshold_apply_with_features((CCL_data_t*)ccl_data->metadata, (const uint8_t**)I, SH_1, SM_2,
+                                                  SM_rows, SH_rows, p_light_min, p_light_max, p_ccl_band,
+                                                  ROI_array_tmp, p_ccl_threads);
+        } else if (p_bin_packed) {
+            threshold_dual_packed((const uint8_t**)I, SM_1p, SH_1p, SM_rows, SH_rows, i0, i1, j0, j1, p_light_min,
+                                  p_light_max);
+            CCL_LSL_apply_packed_with_features((CCL_data_t*)ccl_data->metadata, (const uint64_t**)SM_1p, SM_rows,
+                                               SM_2, ROI_array_tmp, p_ccl_threads);
+        } else {
+            threshold_dual((const uint8_t**)I, SM_1, SH_1, SM_rows, SH_rows, i0, i1, j0, j1, p_light_min, p_light_max);
+            CCL_apply_with_features(ccl_data, (const uint8_t**)SM_1, SM_rows, SM_2, ROI_array_tmp, p_ccl_threads);
+        }
 
-        // Step 3 : seuillage hysteresis && filter surface
-        features_merge_HI_CCL_v2((const uint32_t**)SM_2, (const uint8_t**)SH_1, SH_2, i0, i1, j0, j1, ROI_array_tmp,
-                                 p_surface_min, p_surface_max);
-        features_init_ROI_array(ROI_array1); // TODO: this is overkill, need to understand why we need to do that
+        // Step 3 : seuillage hysteresis && filter surface (&& hot pixels)
+        if (p_hot_axis_min > 0.f)
+            features_filter_hot_pixels(ROI_array_tmp, p_hot_axis_min);
+        if (p_bin_packed)
+            features_merge_HI_CCL_packed((const uint16_t**)SM_2, (const uint64_t**)SH_1p, SH_2, SM_rows, SH_rows, i0,
+                                         i1, j0, j1, ROI_array_tmp, p_surface_min, p_surface_max);
+        else
+            features_merge_HI_CCL_v2((const uint16_t**)SM_2, (const uint8_t**)SH_1, SH_2, SM_rows, SH_rows, i0, i1, j0,
+                                     j1, ROI_array_tmp, p_surface_min, p_surface_max);
         features_shrink_ROI_array((const ROI_t*)ROI_array_tmp, ROI_array1);
 
         // Step 4 : mise en correspondance
-        KPPV_match(kppv_data, ROI_array0, ROI_array1, p_k);
+        KPPV_match(kppv_data, ROI_array0, ROI_array1, p_k, (float)(p_knn_dist * p_knn_dist), pred_theta, pred_tx,
+                   pred_ty, asso);
 
         // Step 5 : recalage
         double first_theta, first_tx, first_ty, first_mean_error, first_std_deviation;
         double theta, tx, ty, mean_error, std_deviation;
-        features_compute_motion((const ROI_t*)ROI_array1, ROI_array0, &first_theta, &first_tx, &first_ty,
-                                &first_mean_error, &first_std_deviation, &theta, &tx, &ty, &mean_error, &std_deviation);
+        if (p_reg_max)
+            features_compute_motion_robust((const ROI_t*)ROI_array1, ROI_array0, (size_t)p_reg_max, p_reg_iter,
+                                           prev_theta, prev_tx, prev_ty, &first_theta, &first_tx, &first_ty,
+                                           &first_mean_error, &first_std_deviation, &theta, &tx, &ty, &mean_error,
+                                           &std_deviation);
+        else
+            features_compute_motion((const ROI_t*)ROI_array1, ROI_array0, &first_theta, &first_tx, &first_ty,
+                                    &first_mean_error, &first_std_deviation, &theta, &tx, &ty, &mean_error,
+                                    &std_deviation);
+        if (isfinite(theta) && isfinite(tx) && isfinite(ty)) {
+            prev_theta = theta;
+            prev_tx = tx;
+            prev_ty = ty;
+            if (p_knn_pred) {
+                pred_theta = theta;
+                pred_tx = tx;
+                pred_ty = ty;
+            }
+        }
 
         // Step 6: tracking
         for (size_t r = 0; r < ROI_array1->_size; r++)
             ROI_array1->frame[r] = frame;
-        tracking_perform(tracking_data, (const ROI_t*)ROI_array0, ROI_array1, track_array, BB_array, frame, theta, tx,
+        tracking_perform(tracking_data, (const ROI_t*)ROI_array0, ROI_array1, track_array, BB_log, frame, theta, tx,
                          ty, mean_error, std_deviation, p_r_extrapol, p_angle_max, p_diff_dev, p_track_all,
                          p_fra_star_min, p_fra_meteor_min, p_fra_meteor_max);
 
@@ -306,6 +482,9 @@ int main(int argc, char** argv) {
             }
         }
 
+        if (p_stream)
+            tracking_flush_tracks(track_array, BB_log, frame, stdout, f_BB, p_track_all, 0);
+
         n_frames++;
         real_n_tracks = tracking_count_objects(track_array, &n_stars, &n_meteors, &n_noise);
         fprintf(stderr, " -- Tracks = ['meteor': %3d, 'star': %3d, 'noise': %3d, 'total': %3lu]\r", n_meteors, n_stars,
@@ -318,9 +497,15 @@ int main(int argc, char** argv) {
     }
     fprintf(stderr, "\n");
 
-    if (p_out_bb)
-        tracking_save_array_BB(p_out_bb, BB_array, track_array, MAX_N_FRAMES, p_track_all);
-    tracking_track_array_write(stdout, track_array);
+    if (p_stream) {
+        tracking_flush_tracks(track_array, BB_log, SIZE_MAX, stdout, f_BB, p_track_all, 1);
+        if (f_BB)
+            fclose(f_BB);
+    } else {
+        if (p_out_bb)
+            tracking_save_array_BB(p_out_bb, BB_log, track_array, p_track_all);
+        tracking_track_array_write(stdout, track_array);
+    }
 
     printf("# Statistics:\n");
     printf("# -> Processed frames = %4d\n", n_frames);
@@ -332,22 +517,25 @@ int main(int argc, char** argv) {
     // ----------
 
     free_ui8matrix(I, i0 - b, i1 + b, j0 - b, j1 + b);
-    free_ui8matrix(SM_0, i0 - b, i1 + b, j0 - b, j1 + b);
     free_ui8matrix(SM_1, i0 - b, i1 + b, j0 - b, j1 + b);
-    free_ui32matrix(SM_2, i0 - b, i1 + b, j0 - b, j1 + b);
-    free_ui8matrix(SH_0, i0 - b, i1 + b, j0 - b, j1 + b);
+    free_ui16matrix(SM_2, i0 - b, i1 + b, j0 - b, j1 + b);
     free_ui8matrix(SH_1, i0 - b, i1 + b, j0 - b, j1 + b);
     free_ui8matrix(SH_2, i0 - b, i1 + b, j0 - b, j1 + b);
+    free_ui8vector(SM_rows, i0, i1);
+    free_ui8vector(SH_rows, i0, i1);
+    if (p_bin_packed) {
+        tools_free_packed_matrix(SM_1p, i0);
+        tools_free_packed_matrix(SH_1p, i0);
+    }
     features_free_ROI_array(ROI_array_tmp);
     features_free_ROI_array(ROI_array0);
     features_free_ROI_array(ROI_array1);
     video_free(video);
-    CCL_LSL_free_data(ccl_data);
+    CCL_free_data(ccl_data);
     KPPV_free_data(kppv_data);
-    tracking_free_BB_array(BB_array);
+    tracking_free_BB_log(BB_log);
     tracking_free_track_array(track_array);
     tracking_free_data(tracking_data);
-    free(BB_array);
 
     printf("# End of the program, exiting.\n");
 
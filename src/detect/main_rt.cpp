@@ -17,13 +17,13 @@
 #include "fmdt/video.h"
 #include "fmdt/macros.h"
 
-#include "fmdt/CCL_LSL/CCL_LSL.hpp"
+#include "fmdt/CCL_engine/CCL_engine.hpp"
 #include "fmdt/Delayer/Delayer.hpp"
 #include "fmdt/Features/Features_extractor.hpp"
 #include "fmdt/Features/Features_merger.hpp"
 #include "fmdt/Features/Features_motion.hpp"
 #include "fmdt/KNN_matcher/KNN_matcher.hpp"
-#include "fmdt/Threshold/Threshold.hpp"
+#include "fmdt/Threshold/Threshold_dual.hpp"
 #include "fmdt/Tracking/Tracking.hpp"
 #include "fmdt/Video/Video.hpp"
 #include "fmdt/Logger/Logger_ROI.hpp"
@@ -43,7 +43,11 @@ int main(int argc, char** argv) {
     int def_p_light_max = 80;
     int def_p_surface_min = 3;
     int def_p_surface_max = 1000;
+    int def_p_ccl_threads = 1;
+    char def_p_ccl_impl[] = CCL_IMPL_LSL_STR;
     int def_p_k = 3;
+    char def_p_knn_asso[] = ASSO_RANK_STR;
+    int def_p_knn_dist = 10;
     int def_p_r_extrapol = 5;
     float def_p_angle_max = 20;
     int def_p_fra_star_min = 15;
@@ -90,9 +94,25 @@ int main(int argc, char** argv) {
         fprintf(stderr,
                 "  --surface-max       Minimum area of the CC                                                 [%d]\n",
                 def_p_surface_max);
+        fprintf(stderr,
+                "  --ccl-threads       Number of threads of the connected-components labeling (OpenMP)       [%d]\n",
+                def_p_ccl_threads);
+        fprintf(stderr,
+                "  --ccl-impl          Connected-components labeling implementation ('LSL' or 'block')       [%s]\n",
+                def_p_ccl_impl);
         fprintf(stderr,
                 "  -k                  Number of neighbours                                                   [%d]\n",
                 def_p_k);
+        fprintf(stderr,
+                "  --knn-asso          Association solver for the k-nearest neighbours ('rank', 'greedy' or   \n");
+        fprintf(stderr,
+                "                      'auction')                                                             [%s]\n",
+                def_p_knn_asso);
+        fprintf(stderr,
+                "  --knn-dist          Maximum distance (in pixels) between two matched CCs                   [%d]\n",
+                def_p_knn_dist);
+        fprintf(stderr,
+                "  --knn-pred          Moves the CCs with the previous motion estimation before the matching      \n");
         fprintf(stderr,
                 "  --r-extrapol        Search radius for the next CC in case of extrapolation                 [%d]\n",
                 def_p_r_extrapol);
@@ -128,7 +148,12 @@ int main(int argc, char** argv) {
     const int p_light_max = args_find_int(argc, argv, "--light-max", def_p_light_max);
     const int p_surface_min = args_find_int(argc, argv, "--surface-min", def_p_surface_min);
     const int p_surface_max = args_find_int(argc, argv, "--surface-max", def_p_surface_max);
+    const int p_ccl_threads = args_find_int(argc, argv, "--ccl-threads", def_p_ccl_threads);
+    const char* p_ccl_impl = args_find_char(argc, argv, "--ccl-impl", def_p_ccl_impl);
     const int p_k = args_find_int(argc, argv, "-k", def_p_k);
+    const char* p_knn_asso = args_find_char(argc, argv, "--knn-asso", def_p_knn_asso);
+    const int p_knn_dist = args_find_int(argc, argv, "--knn-dist", def_p_knn_dist);
+    const int p_knn_pred = args_find(argc, argv, "--knn-pred");
     const int p_r_extrapol = args_find_int(argc, argv, "--r-extrapol", def_p_r_extrapol);
     const float p_angle_max = args_find_float(argc, argv, "--angle-max", def_p_angle_max);
     const int p_fra_star_min = args_find_int(argc, argv, "--fra-star-min", def_p_fra_star_min);
@@ -161,7 +186,12 @@ int main(int argc, char** argv) {
     printf("#  * light-max      = %d\n", p_light_max);
     printf("#  * surface-min    = %d\n", p_surface_min);
     printf("#  * surface-max    = %d\n", p_surface_max);
+    printf("#  * ccl-threads    = %d\n", p_ccl_threads);
+    printf("#  * ccl-impl       = %s\n", p_ccl_impl);
     printf("#  * k              = %d\n", p_k);
+    printf("#  * knn-asso       = %s\n", p_knn_asso);
+    printf("#  * knn-dist       = %d\n", p_knn_dist);
+    printf("#  * knn-pred       = %d\n", p_knn_pred);
     printf("#  * r-extrapol     = %d\n", p_r_extrapol);
     printf("#  * angle-max      = %f\n", p_angle_max);
     printf("#  * fra-star-min   = %d\n", p_fra_star_min);
@@ -182,6 +212,32 @@ int main(int argc, char** argv) {
         fprintf(stderr, "(EE) '--in-video' is missing\n");
         exit(1);
     }
+    if (p_ccl_threads < 1) {
+        fprintf(stderr, "(EE) '--ccl-threads' has to be bigger than 0\n");
+        exit(1);
+    }
+#ifndef _OPENMP
+    if (p_ccl_threads > 1)
+        fprintf(stderr, "(WW) '--ccl-threads' has no effect (compiled without OpenMP)\n");
+#endif
+    const enum ccl_impl_e ccl_impl = CCL_string_to_impl(p_ccl_impl);
+    if (ccl_impl == N_CCL_IMPL) {
+        fprintf(stderr, "(EE) '--ccl-impl' has to be '%s' or '%s'\n", CCL_IMPL_LSL_STR, CCL_IMPL_BLOCK_STR);
+        exit(1);
+    }
+    if (p_ccl_threads > 1 && !(CCL_impl_caps(ccl_impl) & CCL_CAP_THREADS))
+        fprintf(stderr, "(WW) '--ccl-threads' only applies to the features extraction with the '%s' CCL implementation\n",
+                p_ccl_impl);
+    const enum asso_e asso = KPPV_string_to_asso(p_knn_asso);
+    if (asso == N_ASSO) {
+        fprintf(stderr, "(EE) '--knn-asso' has to be '%s', '%s' or '%s'\n", ASSO_RANK_STR, ASSO_GREEDY_STR,
+                ASSO_AUCTION_STR);
+        exit(1);
+    }
+    if (p_knn_dist < 1) {
+        fprintf(stderr, "(EE) '--knn-dist' has to be bigger than 0\n");
+        exit(1);
+    }
     if (p_fra_star_min < 2) {
         fprintf(stderr, "(EE) '--fra-star-min' has to be bigger than 1\n");
         exit(1);
@@ -225,20 +281,18 @@ int main(int argc, char** argv) {
     const size_t i1 = video.get_i1();
     const size_t j0 = video.get_j0();
     const size_t j1 = video.get_j1();
-    Threshold threshold_min(i0, i1, j0, j1, b, p_light_min);
-    Threshold threshold_max(i0, i1, j0, j1, b, p_light_max);
-    threshold_min.set_custom_name("Thr<min>");
-    threshold_max.set_custom_name("Thr<max>");
-    CCL_LSL lsl(i0, i1, j0, j1, b);
-    Features_extractor extractor(i0, i1, j0, j1, b, MAX_ROI_SIZE);
+    Threshold_dual threshold_min_max(i0, i1, j0, j1, b, p_light_min, p_light_max);
+    threshold_min_max.set_custom_name("Thr<min,max>");
+    CCL_engine labeler(i0, i1, j0, j1, b, ccl_impl, p_ccl_threads);
+    Features_extractor extractor(i0, i1, j0, j1, b, MAX_ROI_SIZE, p_ccl_threads);
     extractor.set_custom_name("Extractor");
     Features_merger merger(i0, i1, j0, j1, b, p_surface_min, p_surface_max, MAX_ROI_SIZE);
     merger.set_custom_name("Merger");
-    KNN_matcher matcher(i0, i1, j0, j1, p_k, MAX_ROI_SIZE);
+    KNN_matcher matcher(p_k, (float)(p_knn_dist * p_knn_dist), p_knn_pred, asso, MAX_ROI_SIZE);
     Features_motion motion(MAX_ROI_SIZE);
     motion.set_custom_name("Motion");
     Tracking tracking(p_r_extrapol, p_angle_max, p_diff_dev, p_track_all, p_fra_star_min, p_fra_meteor_min,
-                      p_fra_meteor_max, MAX_ROI_SIZE, MAX_TRACKS_SIZE, MAX_N_FRAMES);
+                      p_fra_meteor_max, MAX_ROI_SIZE, MAX_TRACKS_SIZE);
     Delayer<uint16_t> delayer_ROI_id(MAX_ROI_SIZE, 0);
     Delayer<uint16_t> delayer_ROI_xmin(MAX_ROI_SIZE, 0);
     Delayer<uint16_t> delayer_ROI_xmax(MAX_ROI_SIZE, 0);
@@ -250,11 +304,14 @@ int main(int argc, char** argv) {
     Delayer<float> delayer_ROI_x(MAX_ROI_SIZE, 0.f);
     Delayer<float> delayer_ROI_y(MAX_ROI_SIZE, 0.f);
     Delayer<int32_t> delayer_ROI_prev_id(MAX_ROI_SIZE, 0);
-    Delayer<uint32_t> delayer_ROI_frame(MAX_ROI_SIZE, 0);
+    Delayer<uint64_t> delayer_ROI_frame(MAX_ROI_SIZE, 0);
     Delayer<int32_t> delayer_ROI_time(MAX_ROI_SIZE, 0);
     Delayer<int32_t> delayer_ROI_time_motion(MAX_ROI_SIZE, 0);
     Delayer<uint8_t> delayer_ROI_is_extrapolated(MAX_ROI_SIZE, 0);
     Delayer<uint32_t> delayer_n_ROI(1, 0);
+    Delayer<double> delayer_theta(1, 0.);
+    Delayer<double> delayer_tx(1, 0.);
+    Delayer<double> delayer_ty(1, 0.);
     delayer_ROI_id.set_custom_name("D<ROI_id>");
     delayer_ROI_xmin.set_custom_name("D<ROI_xmin>");
     delayer_ROI_xmax.set_custom_name("D<ROI_xmax>");
@@ -271,8 +328,11 @@ int main(int argc, char** argv) {
     delayer_ROI_time_motion.set_custom_name("D<ROI_t_mo>");
     delayer_ROI_is_extrapolated.set_custom_name("D<ROI_is_ex>");
     delayer_n_ROI.set_custom_name("D<n_ROI>");
+    delayer_theta.set_custom_name("D<theta>");
+    delayer_tx.set_custom_name("D<tx>");
+    delayer_ty.set_custom_name("D<ty>");
     Logger_ROI log_ROI(p_out_stats ? p_out_stats : "", MAX_ROI_SIZE, MAX_TRACKS_SIZE);
-    Logger_KNN log_KNN(p_out_stats ? p_out_stats : "", i0, i1, j0, j1, MAX_ROI_SIZE);
+    Logger_KNN log_KNN(p_out_stats ? p_out_stats : "", p_k, MAX_ROI_SIZE);
     Logger_motion log_motion(p_out_stats ? p_out_stats : "");
     Logger_track log_track(p_out_stats ? p_out_stats : "", MAX_TRACKS_SIZE);
     Logger_frame log_frame(p_out_frames ? p_out_frames : "", i0, i1, j0, j1, b);
@@ -299,20 +359,22 @@ int main(int argc, char** argv) {
     delayer_ROI_time_motion[dly::tsk::produce] = video[vid::sck::generate::out_img];
     delayer_ROI_is_extrapolated[dly::tsk::produce] = video[vid::sck::generate::out_img];
     delayer_n_ROI[dly::tsk::produce] = video[vid::sck::generate::out_img];
+    delayer_theta[dly::tsk::produce] = video[vid::sck::generate::out_img];
+    delayer_tx[dly::tsk::produce] = video[vid::sck::generate::out_img];
+    delayer_ty[dly::tsk::produce] = video[vid::sck::generate::out_img];
 
     // Step 1 : seuillage low/high
-    threshold_min[thr::sck::apply::in_img] = video[vid::sck::generate::out_img];
-    threshold_max[thr::sck::apply::in_img] = video[vid::sck::generate::out_img];
+    threshold_min_max[thr_dual::sck::apply::in_img] = video[vid::sck::generate::out_img];
 
     // Step 2 : ECC/ACC
-    lsl[ccl::sck::apply::in_img] = threshold_min[thr::sck::apply::out_img];
+    labeler[ccl_eng::sck::apply::in_img] = threshold_min_max[thr_dual::sck::apply::out_img_min];
 
-    extractor[ftr_ext::sck::extract::in_img] = lsl[ccl::sck::apply::out_img];
-    extractor[ftr_ext::sck::extract::in_n_ROI] = lsl[ccl::sck::apply::out_n_ROI];
+    extractor[ftr_ext::sck::extract::in_img] = labeler[ccl_eng::sck::apply::out_img];
+    extractor[ftr_ext::sck::extract::in_n_ROI] = labeler[ccl_eng::sck::apply::out_n_ROI];
 
     // Step 3 : seuillage hysteresis && filter surface
-    merger[ftr_mrg::sck::merge::in_img1] = lsl[ccl::sck::apply::out_img];
-    merger[ftr_mrg::sck::merge::in_img2] = threshold_max[thr::sck::apply::out_img];
+    merger[ftr_mrg::sck::merge::in_img1] = labeler[ccl_eng::sck::apply::out_img];
+    merger[ftr_mrg::sck::merge::in_img2] = threshold_min_max[thr_dual::sck::apply::out_img_max];
     merger[ftr_mrg::sck::merge::in_ROI_id] = extractor[ftr_ext::sck::extract::out_ROI_id];
     merger[ftr_mrg::sck::merge::in_ROI_xmin] = extractor[ftr_ext::sck::extract::out_ROI_xmin];
     merger[ftr_mrg::sck::merge::in_ROI_xmax] = extractor[ftr_ext::sck::extract::out_ROI_xmax];
@@ -323,7 +385,7 @@ int main(int argc, char** argv) {
     merger[ftr_mrg::sck::merge::in_ROI_Sy] = extractor[ftr_ext::sck::extract::out_ROI_Sy];
     merger[ftr_mrg::sck::merge::in_ROI_x] = extractor[ftr_ext::sck::extract::out_ROI_x];
     merger[ftr_mrg::sck::merge::in_ROI_y] = extractor[ftr_ext::sck::extract::out_ROI_y];
-    merger[ftr_mrg::sck::merge::in_n_ROI] = lsl[ccl::sck::apply::out_n_ROI];
+    merger[ftr_mrg::sck::merge::in_n_ROI] = labeler[ccl_eng::sck::apply::out_n_ROI];
 
     // Step 4 : mise en correspondance
     matcher[knn::sck::match::in_ROI0_id] = delayer_ROI_id[dly::sck::produce::out];
@@ -334,6 +396,9 @@ int main(int argc, char** argv) {
     matcher[knn::sck::match::in_ROI1_x] = merger[ftr_mrg::sck::merge::out_ROI_x];
     matcher[knn::sck::match::in_ROI1_y] = merger[ftr_mrg::sck::merge::out_ROI_y];
     matcher[knn::sck::match::in_n_ROI1] = merger[ftr_mrg::sck::merge::out_n_ROI];
+    matcher[knn::sck::match::in_theta] = delayer_theta[dly::sck::produce::out];
+    matcher[knn::sck::match::in_tx] = delayer_tx[dly::sck::produce::out];
+    matcher[knn::sck::match::in_ty] = delayer_ty[dly::sck::produce::out];
 
     // Step 5 : recalage
     motion[ftr_mtn::sck::compute::in_ROI0_next_id] = matcher[knn::sck::match::out_ROI0_next_id];
@@ -391,6 +456,9 @@ int main(int argc, char** argv) {
     delayer_ROI_time_motion[dly::sck::memorize::in] = tracking[trk::sck::perform::out_ROI1_time_motion];
     delayer_ROI_is_extrapolated[dly::sck::memorize::in] = tracking[trk::sck::perform::out_ROI1_is_extrapolated];
     delayer_n_ROI[dly::sck::memorize::in] = merger[ftr_mrg::sck::merge::out_n_ROI];
+    delayer_theta[dly::sck::memorize::in] = motion[ftr_mtn::sck::compute::out_theta];
+    delayer_tx[dly::sck::memorize::in] = motion[ftr_mtn::sck::compute::out_tx];
+    delayer_ty[dly::sck::memorize::in] = motion[ftr_mtn::sck::compute::out_ty];
 
     if (p_out_stats) {
         log_ROI[lgr_roi::sck::write::in_ROI0_id] = delayer_ROI_id[dly::sck::produce::out];
@@ -425,8 +493,10 @@ int main(int argc, char** argv) {
         log_ROI[lgr_roi::sck::write::in_n_tracks] = tracking[trk::sck::perform::out_n_tracks];
         log_ROI[lgr_roi::sck::write::in_frame] = video[vid::sck::generate::out_frame];
 
-        log_KNN[lgr_knn::sck::write::in_data_nearest] = matcher[knn::sck::match::out_data_nearest];
-        log_KNN[lgr_knn::sck::write::in_data_distances] = matcher[knn::sck::match::out_data_distances];
+        log_KNN[lgr_knn::sck::write::in_pairs_start] = matcher[knn::sck::match::out_pairs_start];
+        log_KNN[lgr_knn::sck::write::in_pairs_ROI1] = matcher[knn::sck::match::out_pairs_ROI1];
+        log_KNN[lgr_knn::sck::write::in_pairs_dist] = matcher[knn::sck::match::out_pairs_dist];
+        log_KNN[lgr_knn::sck::write::in_pairs_rank] = matcher[knn::sck::match::out_pairs_rank];
         log_KNN[lgr_knn::sck::write::in_ROI_id] = delayer_ROI_id[dly::sck::produce::out];
         log_KNN[lgr_knn::sck::write::in_ROI_S] = delayer_ROI_S[dly::sck::produce::out];
         log_KNN[lgr_knn::sck::write::in_ROI_dx] = motion[ftr_mtn::sck::compute::out_ROI0_dx];
@@ -479,7 +549,7 @@ int main(int argc, char** argv) {
       // pipeline stage 1
       std::make_tuple<std::vector<aff3ct::module::Task*>, std::vector<aff3ct::module::Task*>,
                       std::vector<aff3ct::module::Task*>>(
-        { &threshold_min[thr::tsk::apply], &threshold_max[thr::tsk::apply] },
+        { &threshold_min_max[thr_dual::tsk::apply], },
         { &merger[ftr_mrg::tsk::merge], },
         { } ),
       // pipeline stage 2
@@ -501,6 +571,9 @@ int main(int argc, char** argv) {
           &delayer_ROI_time_motion[dly::tsk::produce],
           &delayer_ROI_is_extrapolated[dly::tsk::produce],
           &delayer_n_ROI[dly::tsk::produce],
+          &delayer_theta[dly::tsk::produce],
+          &delayer_tx[dly::tsk::produce],
+          &delayer_ty[dly::tsk::produce],
           &matcher[knn::tsk::match],
           &motion[ftr_mtn::tsk::compute],
           &tracking[trk::tsk::perform],
@@ -520,6 +593,9 @@ int main(int argc, char** argv) {
           // &delayer_ROI_time_motion[dly::tsk::memorize],
           // &delayer_ROI_is_extrapolated[dly::tsk::memorize],
           &delayer_n_ROI[dly::tsk::memorize],
+          &delayer_theta[dly::tsk::memorize],
+          &delayer_tx[dly::tsk::memorize],
+          &delayer_ty[dly::tsk::memorize],
           },
         { },
         { /* no exclusions in this stage */ } ),
@@ -601,8 +677,7 @@ int main(int argc, char** argv) {
 
     fprintf(stderr, "\n");
     if (p_out_bb)
-        tracking_save_array_BB(p_out_bb, tracking.get_BB_array(), tracking.get_track_array(), MAX_N_FRAMES,
-                               p_track_all);
+        tracking_save_array_BB(p_out_bb, tracking.get_BB_log(), tracking.get_track_array(), p_track_all);
     tracking_track_array_write(stdout, tracking.get_track_array());
 
     unsigned n_stars = 0, n_meteors = 0, n_noise = 0;
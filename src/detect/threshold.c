@@ -1,5 +1,14 @@
 #include <string.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
+#include "fmdt/macros.h"
+#include "fmdt/tools.h"
 #include "fmdt/threshold.h"
 
 #define GRAY_LEVEL 256
@@ -29,6 +38,146 @@ void threshold_high(const uint8_t** m_in, uint8_t** m_out, const int i0, const i
     threshold(m_in, m_out, i0, i1, j0, j1, th);
 }
 
+void threshold_packed(const uint8_t** m_in, uint64_t** m_out, const int i0, const int i1, const int j0, const int j1,
+                      const uint8_t threshold) {
+    const int n_words = (int)PACKED_N_WORDS(j0, j1);
+    for (int i = i0; i <= i1; i++) {
+        const uint8_t* line = m_in[i] + j0;
+        for (int w = 0; w < n_words; w++) {
+            const int n_bits = MIN(64, ((j1 - j0) + 1) - 64 * w);
+            uint64_t word = 0;
+            for (int k = 0; k < n_bits; k++)
+                word |= (uint64_t)(line[64 * w + k] >= threshold) << k;
+            m_out[i][w] = word;
+        }
+    }
+}
+
+void threshold_dual(const uint8_t** m_in, uint8_t** m_out_min, uint8_t** m_out_max, uint8_t* rows_min,
+                    uint8_t* rows_max, const int i0, const int i1, const int j0, const int j1,
+                    const uint8_t threshold_min, const uint8_t threshold_max) {
+    const int n = (j1 - j0) + 1;
+#if defined(__AVX2__)
+    const __m256i t_min = _mm256_set1_epi8((char)threshold_min), t_max = _mm256_set1_epi8((char)threshold_max);
+#elif defined(__SSE2__)
+    const __m128i t_min = _mm_set1_epi8((char)threshold_min), t_max = _mm_set1_epi8((char)threshold_max);
+#elif defined(__ARM_NEON)
+    const uint8x16_t t_min = vdupq_n_u8(threshold_min), t_max = vdupq_n_u8(threshold_max);
+#endif
+    for (int i = i0; i <= i1; i++) {
+        const uint8_t* in = m_in[i] + j0;
+        uint8_t* out_min = m_out_min[i] + j0;
+        uint8_t* out_max = m_out_max[i] + j0;
+        uint8_t any_min = 0, any_max = 0;
+        int j = 0;
+        // x >= t <=> max(x, t) == x (there is no unsigned comparison in SSE2/AVX2)
+#if defined(__AVX2__)
+        __m256i acc_min = _mm256_setzero_si256(), acc_max = _mm256_setzero_si256();
+        for (; j + 32 <= n; j += 32) {
+            const __m256i x = _mm256_loadu_si256((const __m256i*)(in + j));
+            const __m256i x_min = _mm256_cmpeq_epi8(_mm256_max_epu8(x, t_min), x);
+            const __m256i x_max = _mm256_cmpeq_epi8(_mm256_max_epu8(x, t_max), x);
+            _mm256_storeu_si256((__m256i*)(out_min + j), x_min);
+            _mm256_storeu_si256((__m256i*)(out_max + j), x_max);
+            acc_min = _mm256_or_si256(acc_min, x_min);
+            acc_max = _mm256_or_si256(acc_max, x_max);
+        }
+        any_min = _mm256_movemask_epi8(acc_min) != 0;
+        any_max = _mm256_movemask_epi8(acc_max) != 0;
+#elif defined(__SSE2__)
+        __m128i acc_min = _mm_setzero_si128(), acc_max = _mm_setzero_si128();
+        for (; j + 16 <= n; j += 16) {
+            const __m128i x = _mm_loadu_si128((const __m128i*)(in + j));
+            const __m128i x_min = _mm_cmpeq_epi8(_mm_max_epu8(x, t_min), x);
+            const __m128i x_max = _mm_cmpeq_epi8(_mm_max_epu8(x, t_max), x);
+            _mm_storeu_si128((__m128i*)(out_min + j), x_min);
+            _mm_storeu_si128((__m128i*)(out_max + j), x_max);
+            acc_min = _mm_or_si128(acc_min, x_min);
+            acc_max = _mm_or_si128(acc_max, x_max);
+        }
+        any_min = _mm_movemask_epi8(acc_min) != 0;
+        any_max = _mm_movemask_epi8(acc_max) != 0;
+#elif defined(__ARM_NEON)
+        uint8x16_t acc_min = vdupq_n_u8(0), acc_max = vdupq_n_u8(0);
+        for (; j + 16 <= n; j += 16) {
+            const uint8x16_t x = vld1q_u8(in + j);
+            const uint8x16_t x_min = vcgeq_u8(x, t_min);
+            const uint8x16_t x_max = vcgeq_u8(x, t_max);
+            vst1q_u8(out_min + j, x_min);
+            vst1q_u8(out_max + j, x_max);
+            acc_min = vorrq_u8(acc_min, x_min);
+            acc_max = vorrq_u8(acc_max, x_max);
+        }
+        const uint64x2_t acc64_min = vreinterpretq_u64_u8(acc_min), acc64_max = vreinterpretq_u64_u8(acc_max);
+        any_min = (vgetq_lane_u64(acc64_min, 0) | vgetq_lane_u64(acc64_min, 1)) != 0;
+        any_max = (vgetq_lane_u64(acc64_max, 0) | vgetq_lane_u64(acc64_max, 1)) != 0;
+#endif
+        for (; j < n; j++) {
+            out_min[j] = (in[j] >= threshold_min) ? 255 : 0;
+            out_max[j] = (in[j] >= threshold_max) ? 255 : 0;
+            any_min |= out_min[j];
+            any_max |= out_max[j];
+        }
+        if (rows_min)
+            rows_min[i] = any_min != 0;
+        if (rows_max)
+            rows_max[i] = any_max != 0;
+    }
+}
+
+void threshold_dual_packed(const uint8_t** m_in, uint64_t** m_out_min, uint64_t** m_out_max, uint8_t* rows_min,
+                           uint8_t* rows_max, const int i0, const int i1, const int j0, const int j1,
+                           const uint8_t threshold_min, const uint8_t threshold_max) {
+    const int n = (j1 - j0) + 1;
+    const int n_words = (int)PACKED_N_WORDS(j0, j1);
+#if defined(__AVX2__)
+    const __m256i t_min = _mm256_set1_epi8((char)threshold_min), t_max = _mm256_set1_epi8((char)threshold_max);
+#elif defined(__SSE2__)
+    const __m128i t_min = _mm_set1_epi8((char)threshold_min), t_max = _mm_set1_epi8((char)threshold_max);
+#endif
+    for (int i = i0; i <= i1; i++) {
+        const uint8_t* in = m_in[i] + j0;
+        uint64_t any_min = 0, any_max = 0;
+        for (int w = 0; w < n_words; w++) {
+            const int n_bits = MIN(64, n - 64 * w);
+            uint64_t word_min = 0, word_max = 0;
+            int k = 0;
+            // the comparison masks are packed with 'movemask' (1 bit per byte, little endian)
+#if defined(__AVX2__)
+            if (n_bits == 64) {
+                for (; k < 64; k += 32) {
+                    const __m256i x = _mm256_loadu_si256((const __m256i*)(in + 64 * w + k));
+                    word_min |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(x, t_min),
+                                                                                           x)) << k;
+                    word_max |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(x, t_max),
+                                                                                           x)) << k;
+                }
+            }
+#elif defined(__SSE2__)
+            if (n_bits == 64) {
+                for (; k < 64; k += 16) {
+                    const __m128i x = _mm_loadu_si128((const __m128i*)(in + 64 * w + k));
+                    word_min |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(x, t_min), x)) << k;
+                    word_max |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(x, t_max), x)) << k;
+                }
+            }
+#endif
+            for (; k < n_bits; k++) {
+                word_min |= (uint64_t)(in[64 * w + k] >= threshold_min) << k;
+                word_max |= (uint64_t)(in[64 * w + k] >= threshold_max) << k;
+            }
+            m_out_min[i][w] = word_min;
+            m_out_max[i][w] = word_max;
+            any_min |= word_min;
+            any_max |= word_max;
+        }
+        if (rows_min)
+            rows_min[i] = any_min != 0;
+        if (rows_max)
+            rows_max[i] = any_max != 0;
+    }
+}
+
 void threshold_low(const uint8_t** m_in, uint8_t** m_out, const int i0, const int i1, const int j0, const int j1,
                    const uint8_t threshold) {
     int i, j;
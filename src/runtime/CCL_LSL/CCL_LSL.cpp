@@ -1,14 +1,23 @@
+#include <sstream>
+
 #include "fmdt/CCL.h"
 
 #include "fmdt/CCL_LSL/CCL_LSL.hpp"
 
-CCL_LSL::CCL_LSL(const int i0, const int i1, const int j0, const int j1, const int b)
-: Module(), i0(i0), i1(i1), j0(j0), j1(j1), b(b), in_img(nullptr), out_img(nullptr), out_data_er(nullptr),
+CCL_LSL::CCL_LSL(const int i0, const int i1, const int j0, const int j1, const int b, const int n_threads)
+: Module(), i0(i0), i1(i1), j0(j0), j1(j1), b(b), n_threads(n_threads), in_img(nullptr), out_img(nullptr), out_data_er(nullptr),
   out_data_era(nullptr), out_data_rlc(nullptr) {
     const std::string name = "CCL_LSL";
     this->set_name(name);
     this->set_short_name(name);
 
+    if ((j1 - j0) + 2 > UINT16_MAX) {
+        std::stringstream message;
+        message << "The image is too wide for the CCL ('(j1 - j0) + 2' = " << ((j1 - j0) + 2) << " > "
+                << UINT16_MAX << ").";
+        throw aff3ct::tools::invalid_argument(__FILE__, __LINE__, __func__, message.str());
+    }
+
     this->init_data();
 
     const size_t i_socket_size = ((i1 - i0) + 1 + 2 * b) * ((j1 - j0) + 1 + 2 * b);
@@ -16,12 +25,14 @@ CCL_LSL::CCL_LSL(const int i0, const int i1, const int j0, const int j1, const i
 
     auto &p = this->create_task("apply");
     auto ps_in_img = this->template create_socket_in<uint8_t>(p, "in_img", i_socket_size);
-    auto ps_out_img = this->template create_socket_out<uint32_t>(p, "out_img", i_socket_size);
+    auto ps_out_img = this->template create_socket_out<uint16_t>(p, "out_img", i_socket_size);
     auto ps_out_n_ROI = this->template create_socket_out<uint32_t>(p, "out_n_ROI", 1);
 
-    auto ps_out_data_er = this->template create_socket_out<uint32_t>(p, "out_data_er", d_socket_size);
-    auto ps_out_data_era = this->template create_socket_out<uint32_t>(p, "out_data_era", d_socket_size);
-    auto ps_out_data_rlc = this->template create_socket_out<uint32_t>(p, "out_data_rlc", d_socket_size);
+    auto ps_out_data_er = this->template create_socket_out<uint16_t>(p, "out_data_er", d_socket_size);
+    // one more column per line for the relative labels (see 'CCL_LSL_alloc_and_init_data')
+    const size_t r_socket_size = ((i1 - i0) + 1) * ((j1 - j0) + 2);
+    auto ps_out_data_era = this->template create_socket_out<uint32_t>(p, "out_data_era", r_socket_size);
+    auto ps_out_data_rlc = this->template create_socket_out<uint16_t>(p, "out_data_rlc", r_socket_size);
     auto ps_out_data_eq = this->template create_socket_out<uint32_t>(p, "out_data_eq", d_socket_size);
     auto ps_out_data_ner = this->template create_socket_out<uint32_t>(p, "out_data_ner", (i1 - i0) + 1);
 
@@ -30,27 +41,24 @@ CCL_LSL::CCL_LSL(const int i0, const int i1, const int j0, const int j1, const i
                          (aff3ct::module::Module &m, aff3ct::module::Task &t, const size_t frame_id) -> int {
         auto &lsl = static_cast<CCL_LSL&>(m);
         const uint8_t* m_in_img = static_cast<const uint8_t*>(t[ps_in_img].get_dataptr());
-        uint32_t* m_out_img = static_cast<uint32_t*>(t[ps_out_img].get_dataptr());
-        uint32_t* m_out_data_er = static_cast<uint32_t*>(t[ps_out_data_er].get_dataptr());
+        uint16_t* m_out_img = static_cast<uint16_t*>(t[ps_out_img].get_dataptr());
+        uint16_t* m_out_data_er = static_cast<uint16_t*>(t[ps_out_data_er].get_dataptr());
         uint32_t* m_out_data_era = static_cast<uint32_t*>(t[ps_out_data_era].get_dataptr());
-        uint32_t* m_out_data_rlc = static_cast<uint32_t*>(t[ps_out_data_rlc].get_dataptr());
+        uint16_t* m_out_data_rlc = static_cast<uint16_t*>(t[ps_out_data_rlc].get_dataptr());
 
         lsl.in_img[lsl.i0 - lsl.b] = m_in_img - (lsl.j0 - lsl.b);
         lsl.out_img[lsl.i0 - lsl.b] = m_out_img - (lsl.j0 - lsl.b);
         for (int i = lsl.i0 - lsl.b + 1; i <= lsl.i1 + lsl.b; i++) {
             lsl.out_img[i] = lsl.out_img[i - 1] + ((lsl.j1 - lsl.j0) + 1 + 2 * lsl.b);
             lsl.in_img[i] = lsl.in_img[i - 1] + ((lsl.j1 - lsl.j0) + 1 + 2 * lsl.b);
-            lsl.out_data_er[i] = lsl.out_data_er[i - 1] + ((lsl.j1 - lsl.j0) + 1);
-            lsl.out_data_era[i] = lsl.out_data_era[i - 1] + ((lsl.j1 - lsl.j0) + 1);
-            lsl.out_data_rlc[i] = lsl.out_data_rlc[i - 1] + ((lsl.j1 - lsl.j0) + 1);
         }
         lsl.out_data_er[lsl.i0] = m_out_data_er - lsl.j0;
         lsl.out_data_era[lsl.i0] = m_out_data_era - lsl.j0;
         lsl.out_data_rlc[lsl.i0] = m_out_data_rlc - lsl.j0;
         for (int i = lsl.i0 + 1; i <= lsl.i1; i++) {
             lsl.out_data_er[i] = lsl.out_data_er[i - 1] + ((lsl.j1 - lsl.j0) + 1);
-            lsl.out_data_era[i] = lsl.out_data_era[i - 1] + ((lsl.j1 - lsl.j0) + 1);
-            lsl.out_data_rlc[i] = lsl.out_data_rlc[i - 1] + ((lsl.j1 - lsl.j0) + 1);
+            lsl.out_data_era[i] = lsl.out_data_era[i - 1] + ((lsl.j1 - lsl.j0) + 2);
+            lsl.out_data_rlc[i] = lsl.out_data_rlc[i - 1] + ((lsl.j1 - lsl.j0) + 2);
         }
 
         uint32_t* m_out_n_ROI = static_cast<uint32_t*>(t[ps_out_n_ROI].get_dataptr());
@@ -59,20 +67,22 @@ CCL_LSL::CCL_LSL(const int i0, const int i1, const int j0, const int j1, const i
                                       lsl.out_data_rlc,
                                       static_cast<uint32_t*>(t[ps_out_data_eq].get_dataptr()),
                                       static_cast<uint32_t*>(t[ps_out_data_ner].get_dataptr()),
-                                      lsl.in_img, lsl.out_img, lsl.i0, lsl.i1, lsl.j0, lsl.j1);
+                                      lsl.in_img, nullptr, lsl.out_img, lsl.i0, lsl.i1, lsl.j0, lsl.j1,
+                                      lsl.n_threads);
         return aff3ct::module::status_t::SUCCESS;
     });
 }
 
 void CCL_LSL::init_data() {
     // this->data = CCL_LSL_alloc_and_init_data(i0, i1, j0, j1);
+    CCL_LSL_init_dispatch(); // before the clones run in parallel (the raw '_CCL_LSL_apply*' functions do not do it)
     this->in_img = (const uint8_t**)malloc((size_t)(((i1 - i0) + 1 + 2 * b) * sizeof(const uint8_t*)));
-    this->out_img = (uint32_t**)malloc((size_t)(((i1 - i0) + 1 + 2 * b) * sizeof(uint32_t*)));
+    this->out_img = (uint16_t**)malloc((size_t)(((i1 - i0) + 1 + 2 * b) * sizeof(uint16_t*)));
     this->in_img -= i0 - b;
     this->out_img -= i0 - b;
-    this->out_data_er = (uint32_t**)malloc((size_t)(((i1 - i0) + 1) * sizeof(uint32_t*)));
+    this->out_data_er = (uint16_t**)malloc((size_t)(((i1 - i0) + 1) * sizeof(uint16_t*)));
     this->out_data_era = (uint32_t**)malloc((size_t)(((i1 - i0) + 1) * sizeof(uint32_t*)));
-    this->out_data_rlc = (uint32_t**)malloc((size_t)(((i1 - i0) + 1) * sizeof(uint32_t*)));
+    this->out_data_rlc = (uint16_t**)malloc((size_t)(((i1 - i0) + 1) * sizeof(uint16_t*)));
     this->out_data_er -= i0;
     this->out_data_era -= i0;
     this->out_data_rlc -= i0;
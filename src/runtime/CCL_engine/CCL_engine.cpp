@@ -0,0 +1,78 @@
+#include <sstream>
+
+#include "fmdt/CCL_engine/CCL_engine.hpp"
+
+CCL_engine::CCL_engine(const int i0, const int i1, const int j0, const int j1, const int b,
+                       const enum ccl_impl_e impl, const int n_threads)
+: Module(), i0(i0), i1(i1), j0(j0), j1(j1), b(b), impl(impl), n_threads(n_threads), data(nullptr), in_img(nullptr),
+  out_img(nullptr) {
+    const std::string name = "CCL_engine";
+    this->set_name(name);
+    this->set_short_name(name);
+
+    if (impl == N_CCL_IMPL) {
+        std::stringstream message;
+        message << "Unknown CCL implementation ('impl' = " << (int)impl << ").";
+        throw aff3ct::tools::invalid_argument(__FILE__, __LINE__, __func__, message.str());
+    }
+
+    if ((j1 - j0) + 2 > UINT16_MAX) {
+        std::stringstream message;
+        message << "The image is too wide for the CCL ('(j1 - j0) + 2' = " << ((j1 - j0) + 2) << " > "
+                << UINT16_MAX << ").";
+        throw aff3ct::tools::invalid_argument(__FILE__, __LINE__, __func__, message.str());
+    }
+
+    this->init_data();
+
+    const size_t i_socket_size = ((i1 - i0) + 1 + 2 * b) * ((j1 - j0) + 1 + 2 * b);
+
+    auto &p = this->create_task("apply");
+    auto ps_in_img = this->template create_socket_in<uint8_t>(p, "in_img", i_socket_size);
+    auto ps_out_img = this->template create_socket_out<uint16_t>(p, "out_img", i_socket_size);
+    auto ps_out_n_ROI = this->template create_socket_out<uint32_t>(p, "out_n_ROI", 1);
+
+    this->create_codelet(p, [ps_in_img, ps_out_img, ps_out_n_ROI]
+                         (aff3ct::module::Module &m, aff3ct::module::Task &t, const size_t frame_id) -> int {
+        auto &eng = static_cast<CCL_engine&>(m);
+        const uint8_t* m_in_img = static_cast<const uint8_t*>(t[ps_in_img].get_dataptr());
+        uint16_t* m_out_img = static_cast<uint16_t*>(t[ps_out_img].get_dataptr());
+
+        eng.in_img[eng.i0 - eng.b] = m_in_img - (eng.j0 - eng.b);
+        eng.out_img[eng.i0 - eng.b] = m_out_img - (eng.j0 - eng.b);
+        for (int i = eng.i0 - eng.b + 1; i <= eng.i1 + eng.b; i++) {
+            eng.out_img[i] = eng.out_img[i - 1] + ((eng.j1 - eng.j0) + 1 + 2 * eng.b);
+            eng.in_img[i] = eng.in_img[i - 1] + ((eng.j1 - eng.j0) + 1 + 2 * eng.b);
+        }
+
+        uint32_t* m_out_n_ROI = static_cast<uint32_t*>(t[ps_out_n_ROI].get_dataptr());
+        *m_out_n_ROI = CCL_apply(eng.data, eng.in_img, nullptr, eng.out_img, eng.n_threads);
+        return aff3ct::module::status_t::SUCCESS;
+    });
+}
+
+void CCL_engine::init_data() {
+    this->data = CCL_alloc_and_init_data(impl, i0, i1, j0, j1, 1); // no features extraction here
+    this->in_img = (const uint8_t**)malloc((size_t)(((i1 - i0) + 1 + 2 * b) * sizeof(const uint8_t*)));
+    this->out_img = (uint16_t**)malloc((size_t)(((i1 - i0) + 1 + 2 * b) * sizeof(uint16_t*)));
+    this->in_img -= i0 - b;
+    this->out_img -= i0 - b;
+}
+
+CCL_engine::~CCL_engine() {
+    CCL_free_data(this->data);
+    free(this->in_img + (this->i0 - this->b));
+    free(this->out_img + (this->i0 - this->b));
+}
+
+CCL_engine* CCL_engine::clone() const {
+    auto m = new CCL_engine(*this);
+    m->deep_copy(*this);
+    return m;
+}
+
+void CCL_engine::deep_copy(const CCL_engine &m)
+{
+    Module::deep_copy(m);
+    this->init_data();
+}
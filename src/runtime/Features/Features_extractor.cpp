@@ -3,8 +3,9 @@
 #include "fmdt/Features/Features_extractor.hpp"
 
 Features_extractor::Features_extractor(const int i0, const int i1, const int j0, const int j1, const int b,
-                                       const size_t max_ROI_size)
-: Module(), i0(i0), i1(i1), j0(j0), j1(j1), b(b), max_ROI_size(max_ROI_size), in_img(nullptr) {
+                                       const size_t max_ROI_size, const int n_threads)
+: Module(), i0(i0), i1(i1), j0(j0), j1(j1), b(b), max_ROI_size(max_ROI_size), n_threads(n_threads), in_img(nullptr),
+  bands(nullptr) {
     const std::string name = "Features_extractor";
     this->set_name(name);
     this->set_short_name(name);
@@ -14,7 +15,7 @@ Features_extractor::Features_extractor(const int i0, const int i1, const int j0,
     auto socket_img_size = ((i1 - i0) + 1 + 2 * b) * ((j1 - j0) + 1 + 2 * b);
 
     auto &p = this->create_task("extract");
-    auto ps_in_img = this->template create_socket_in<uint32_t>(p, "in_img", socket_img_size);
+    auto ps_in_img = this->template create_socket_in<uint16_t>(p, "in_img", socket_img_size);
     auto ps_in_n_ROI = this->template create_socket_in<uint32_t>(p, "in_n_ROI", 1);
     auto ps_out_ROI_id = this->template create_socket_out<uint16_t>(p, "out_ROI_id", max_ROI_size);
     auto ps_out_ROI_xmin = this->template create_socket_out<uint16_t>(p, "out_ROI_xmin", max_ROI_size);
@@ -31,7 +32,7 @@ Features_extractor::Features_extractor(const int i0, const int i1, const int j0,
                              ps_out_ROI_ymax, ps_out_ROI_S, ps_out_ROI_Sx, ps_out_ROI_Sy, ps_out_ROI_x, ps_out_ROI_y]
                          (aff3ct::module::Module &m, aff3ct::module::Task &t, const size_t frame_id) -> int {
         auto &ext = static_cast<Features_extractor&>(m);
-        const uint32_t* m_in_img = static_cast<const uint32_t*>(t[ps_in_img].get_dataptr());
+        const uint16_t* m_in_img = static_cast<const uint16_t*>(t[ps_in_img].get_dataptr());
         ext.in_img[ext.i0 - ext.b] = m_in_img - (ext.j0 - ext.b);
         for (int i = ext.i0 - ext.b + 1; i <= ext.i1 + ext.b; i++)
             ext.in_img[i] = ext.in_img[i - 1] + ((ext.j1 - ext.j0) + 1 + 2 * ext.b);
@@ -47,21 +48,25 @@ Features_extractor::Features_extractor(const int i0, const int i1, const int j0,
                           static_cast<uint32_t*>(t[ps_out_ROI_S].get_dataptr()),
                           static_cast<uint32_t*>(t[ps_out_ROI_Sx].get_dataptr()),
                           static_cast<uint32_t*>(t[ps_out_ROI_Sy].get_dataptr()),
+                          nullptr, nullptr, nullptr, // no second-order moments
                           static_cast<float*>(t[ps_out_ROI_x].get_dataptr()),
                           static_cast<float*>(t[ps_out_ROI_y].get_dataptr()),
-                          n_ROI);
+                          n_ROI, ext.bands);
 
         return aff3ct::module::status_t::SUCCESS;
     });
 }
 
 void Features_extractor::init_data() {
-    this->in_img = (const uint32_t**)malloc((size_t)(((i1 - i0) + 1 + 2 * b) * sizeof(const uint32_t*)));
+    this->in_img = (const uint16_t**)malloc((size_t)(((i1 - i0) + 1 + 2 * b) * sizeof(const uint16_t*)));
     this->in_img -= i0 - b;
+    this->bands = n_threads > 1 ? features_alloc_bands(n_threads, max_ROI_size) : nullptr;
 }
 
 Features_extractor::~Features_extractor() {
     free(this->in_img + (this->i0 - this->b));
+    if (this->bands)
+        features_free_bands(this->bands);
 }
 
 Features_extractor* Features_extractor::clone() const {
@@ -15,7 +15,7 @@ Features_merger::Features_merger(const int i0, const int i1, const int j0, const
     auto socket_img_size = ((i1 - i0) + 1 + 2 * b) * ((j1 - j0) + 1 + 2 * b);
 
     auto &p = this->create_task("merge");
-    auto ps_in_img1 = this->template create_socket_in<uint32_t>(p, "in_img1", socket_img_size);
+    auto ps_in_img1 = this->template create_socket_in<uint16_t>(p, "in_img1", socket_img_size);
     auto ps_in_img2 = this->template create_socket_in<uint8_t>(p, "in_img2", socket_img_size);
 
     auto ps_in_ROI_id = this->template create_socket_in<uint16_t>(p, "in_ROI_id", max_ROI_size);
@@ -51,7 +51,7 @@ Features_merger::Features_merger(const int i0, const int i1, const int j0, const
                              ps_out_ROI_y, ps_out_n_ROI, ps_out_img]
                          (aff3ct::module::Module &m, aff3ct::module::Task &t, const size_t frame_id) -> int {
         auto &mrg = static_cast<Features_merger&>(m);
-        const uint32_t* m_in_img1 = static_cast<const uint32_t*>(t[ps_in_img1].get_dataptr());
+        const uint16_t* m_in_img1 = static_cast<const uint16_t*>(t[ps_in_img1].get_dataptr());
         const uint8_t* m_in_img2 = static_cast<const uint8_t*>(t[ps_in_img2].get_dataptr());
         uint8_t* m_out_img = static_cast<uint8_t*>(t[ps_out_img].get_dataptr());
         mrg.in_img1[mrg.i0 - mrg.b] = m_in_img1 - (mrg.j0 - mrg.b);
@@ -68,12 +68,9 @@ Features_merger::Features_merger(const int i0, const int i1, const int j0, const
         std::copy_n(static_cast<const uint32_t*>(t[ps_in_ROI_S].get_dataptr()), in_n_ROI,
                     static_cast<uint32_t*>(t[ps_out_ROI_S].get_dataptr()));
 
-        _features_merge_HI_CCL_v2(mrg.in_img1, mrg.in_img2, mrg.out_img, mrg.i0, mrg.i1, mrg.j0, mrg.j1,
+        _features_merge_HI_CCL_v2(mrg.in_img1, mrg.in_img2, mrg.out_img, nullptr, nullptr, mrg.i0, mrg.i1, mrg.j0,
+                                  mrg.j1,
                                   static_cast<const uint16_t*>(t[ps_in_ROI_id].get_dataptr()),
-                                  static_cast<const uint16_t*>(t[ps_in_ROI_xmin].get_dataptr()),
-                                  static_cast<const uint16_t*>(t[ps_in_ROI_xmax].get_dataptr()),
-                                  static_cast<const uint16_t*>(t[ps_in_ROI_ymin].get_dataptr()),
-                                  static_cast<const uint16_t*>(t[ps_in_ROI_ymax].get_dataptr()),
                                   static_cast<uint32_t*>(t[ps_out_ROI_S].get_dataptr()),
                                   in_n_ROI,
                                   mrg.S_min, mrg.S_max);
@@ -86,6 +83,7 @@ Features_merger::Features_merger(const int i0, const int i1, const int j0, const
                                                       static_cast<const uint32_t*>(t[ps_out_ROI_S].get_dataptr()),
                                                       static_cast<const uint32_t*>(t[ps_in_ROI_Sx].get_dataptr()),
                                                       static_cast<const uint32_t*>(t[ps_in_ROI_Sy].get_dataptr()),
+                                                      nullptr, nullptr, nullptr, // no second-order moments
                                                       static_cast<const float*>(t[ps_in_ROI_x].get_dataptr()),
                                                       static_cast<const float*>(t[ps_in_ROI_y].get_dataptr()),
                                                       in_n_ROI,
@@ -97,6 +95,7 @@ Features_merger::Features_merger(const int i0, const int i1, const int j0, const
                                                       static_cast<uint32_t*>(t[ps_out_ROI_S].get_dataptr()),
                                                       static_cast<uint32_t*>(t[ps_out_ROI_Sx].get_dataptr()),
                                                       static_cast<uint32_t*>(t[ps_out_ROI_Sy].get_dataptr()),
+                                                      nullptr, nullptr, nullptr,
                                                       static_cast<float*>(t[ps_out_ROI_x].get_dataptr()),
                                                       static_cast<float*>(t[ps_out_ROI_y].get_dataptr()));
 
@@ -107,7 +106,7 @@ Features_merger::Features_merger(const int i0, const int i1, const int j0, const
 }
 
 void Features_merger::init_data() {
-    this->in_img1 = (const uint32_t**)malloc((size_t)(((i1 - i0) + 1 + 2 * b) * sizeof(const uint32_t*)));
+    this->in_img1 = (const uint16_t**)malloc((size_t)(((i1 - i0) + 1 + 2 * b) * sizeof(const uint16_t*)));
     this->in_img2 = (const uint8_t**)malloc((size_t)(((i1 - i0) + 1 + 2 * b) * sizeof(const uint8_t*)));
     this->out_img = (uint8_t**)malloc((size_t)(((i1 - i0) + 1 + 2 * b) * sizeof(uint8_t*)));
     this->in_img1 -= i0 - b;
@@ -2,18 +2,14 @@
 
 #include "fmdt/KNN_matcher/KNN_matcher.hpp"
 
-KNN_matcher::KNN_matcher(const size_t i0, const int i1, const int j0, const int j1, const size_t k,
+KNN_matcher::KNN_matcher(const size_t k, const float max_dist, const bool pred, const enum asso_e asso,
                          const size_t max_ROI_size)
-: Module(), i0(i0), i1(i1), j0(j0), j1(j1), k(k), /* data(nullptr), */ out_data_nearest(nullptr),
-  out_data_distances(nullptr) {
+: Module(), k(k), max_dist(max_dist), pred(pred), asso(asso), data(nullptr) {
     const std::string name = "KNN_matcher";
     this->set_name(name);
     this->set_short_name(name);
 
-    this->out_data_nearest = (uint32_t**)malloc((size_t)(((i1 - i0) + 1) * sizeof(const uint32_t*)));
-    this->out_data_nearest -= i0;
-    this->out_data_distances = (float**)malloc((size_t)(((i1 - i0) + 1) * sizeof(float*)));
-    this->out_data_distances -= i0;
+    this->data = KPPV_alloc_and_init_data(k, max_ROI_size);
 
     auto &p = this->create_task("match");
 
@@ -25,37 +21,35 @@ KNN_matcher::KNN_matcher(const size_t i0, const int i1, const int j0, const int
     auto ps_in_ROI1_x = this->template create_socket_in<float>(p, "in_ROI1_x", max_ROI_size);
     auto ps_in_ROI1_y = this->template create_socket_in<float>(p, "in_ROI1_y", max_ROI_size);
     auto ps_in_n_ROI1 = this->template create_socket_in<uint32_t>(p, "in_n_ROI1", 1);
+    auto ps_in_theta = this->template create_socket_in<double>(p, "in_theta", 1);
+    auto ps_in_tx = this->template create_socket_in<double>(p, "in_tx", 1);
+    auto ps_in_ty = this->template create_socket_in<double>(p, "in_ty", 1);
 
-    const size_t d_socket_size = ((i1 - i0) + 1) * ((j1 - j0) + 1);
+    const size_t max_n_pairs = this->data->max_n_pairs;
     auto ps_out_ROI0_next_id = this->template create_socket_out<int32_t>(p, "out_ROI0_next_id", max_ROI_size);
     auto ps_out_ROI1_prev_id = this->template create_socket_out<int32_t>(p, "out_ROI1_prev_id", max_ROI_size);
-    auto ps_out_data_nearest = this->template create_socket_out<uint32_t>(p, "out_data_nearest", d_socket_size);
-    auto ps_out_data_distances = this->template create_socket_out<float>(p, "out_data_distances", d_socket_size);
-    auto ps_out_data_conflicts = this->template create_socket_out<uint32_t>(p, "out_data_conflicts", j1 - j0 + 1);
+    auto ps_out_pairs_start = this->template create_socket_out<uint32_t>(p, "out_pairs_start", max_ROI_size + 1);
+    auto ps_out_pairs_ROI1 = this->template create_socket_out<uint32_t>(p, "out_pairs_ROI1", max_n_pairs);
+    auto ps_out_pairs_dist = this->template create_socket_out<float>(p, "out_pairs_dist", max_n_pairs);
+    auto ps_out_pairs_rank = this->template create_socket_out<uint32_t>(p, "out_pairs_rank", max_n_pairs);
 
     this->create_codelet(p, [ps_in_ROI0_id, ps_in_ROI0_x, ps_in_ROI0_y, ps_in_n_ROI0, ps_in_ROI1_id, ps_in_ROI1_x,
-                             ps_in_ROI1_y, ps_in_n_ROI1, ps_out_ROI0_next_id, ps_out_ROI1_prev_id,
-                             ps_out_data_nearest, ps_out_data_distances, ps_out_data_conflicts]
+                             ps_in_ROI1_y, ps_in_n_ROI1, ps_in_theta, ps_in_tx, ps_in_ty, ps_out_ROI0_next_id,
+                             ps_out_ROI1_prev_id, ps_out_pairs_start, ps_out_pairs_ROI1, ps_out_pairs_dist,
+                             ps_out_pairs_rank]
                          (aff3ct::module::Module &m, aff3ct::module::Task &t, const size_t frame_id) -> int {
         auto &knn = static_cast<KNN_matcher&>(m);
 
         const size_t n_ROI0 = (size_t)*static_cast<const uint32_t*>(t[ps_in_n_ROI0].get_dataptr());
         const size_t n_ROI1 = (size_t)*static_cast<const uint32_t*>(t[ps_in_n_ROI1].get_dataptr());
-
-        uint32_t* m_out_data_nearest = static_cast<uint32_t*>(t[ps_out_data_nearest].get_dataptr());
-        float* m_out_data_distances = static_cast<float*>(t[ps_out_data_distances].get_dataptr());
-        knn.out_data_nearest[knn.i0] = m_out_data_nearest - knn.j0;
-        knn.out_data_distances[knn.i0] = m_out_data_distances - knn.j0;
-        for (int i = knn.i0 + 1; i <= knn.i1; i++) {
-            knn.out_data_nearest[i] = knn.out_data_nearest[i - 1] + ((knn.j1 - knn.j0) + 1);
-            knn.out_data_distances[i] = knn.out_data_distances[i - 1] + ((knn.j1 - knn.j0) + 1);
-        }
+        // motion of the previous frame (used to predict the position of the ROI0)
+        const double theta = knn.pred ? *static_cast<const double*>(t[ps_in_theta].get_dataptr()) : 0.;
+        const double tx = knn.pred ? *static_cast<const double*>(t[ps_in_tx].get_dataptr()) : 0.;
+        const double ty = knn.pred ? *static_cast<const double*>(t[ps_in_ty].get_dataptr()) : 0.;
 
         std::fill_n(static_cast<int32_t*>(t[ps_out_ROI0_next_id].get_dataptr()), n_ROI0, 0);
         std::fill_n(static_cast<int32_t*>(t[ps_out_ROI1_prev_id].get_dataptr()), n_ROI1, 0);
-        _KPPV_match(knn.out_data_nearest,
-                    knn.out_data_distances,
-                    static_cast<uint32_t*>(t[ps_out_data_conflicts].get_dataptr()),
+        _KPPV_match(knn.data,
                     static_cast<const uint16_t*>(t[ps_in_ROI0_id].get_dataptr()),
                     static_cast<const float*>(t[ps_in_ROI0_x].get_dataptr()),
                     static_cast<const float*>(t[ps_in_ROI0_y].get_dataptr()),
@@ -65,13 +59,18 @@ KNN_matcher::KNN_matcher(const size_t i0, const int i1, const int j0, const int
                     static_cast<const float*>(t[ps_in_ROI1_x].get_dataptr()),
                     static_cast<const float*>(t[ps_in_ROI1_y].get_dataptr()),
                     static_cast<int32_t*>(t[ps_out_ROI1_prev_id].get_dataptr()),
-                    n_ROI1, knn.k);
+                    n_ROI1, knn.k, knn.max_dist, theta, tx, ty, knn.asso);
+
+        const size_t n_pairs = knn.data->pairs_start[n_ROI0];
+        std::copy_n(knn.data->pairs_start, n_ROI0 + 1, static_cast<uint32_t*>(t[ps_out_pairs_start].get_dataptr()));
+        std::copy_n(knn.data->pairs_ROI1, n_pairs, static_cast<uint32_t*>(t[ps_out_pairs_ROI1].get_dataptr()));
+        std::copy_n(knn.data->pairs_dist, n_pairs, static_cast<float*>(t[ps_out_pairs_dist].get_dataptr()));
+        std::copy_n(knn.data->pairs_rank, n_pairs, static_cast<uint32_t*>(t[ps_out_pairs_rank].get_dataptr()));
 
         return aff3ct::module::status_t::SUCCESS;
     });
 }
 
 KNN_matcher::~KNN_matcher() {
-    free(this->out_data_nearest + this->i0);
-    free(this->out_data_distances + this->i0);
+    KPPV_free_data(this->data);
 }
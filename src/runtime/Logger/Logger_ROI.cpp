@@ -38,7 +38,7 @@ Logger_ROI::Logger_ROI(const std::string ROI_path, const size_t max_ROI_size, co
     auto ps_in_ROI1_time_motion = this->template create_socket_in<int32_t>(p, "in_ROI1_time_motion", max_ROI_size);
     auto ps_in_n_ROI1 = this->template create_socket_in<uint32_t>(p, "in_n_ROI1", 1);
 
-    auto ps_in_track_id = this->template create_socket_in<uint16_t>(p, "in_track_id", max_tracks_size);
+    auto ps_in_track_id = this->template create_socket_in<uint32_t>(p, "in_track_id", max_tracks_size);
     auto ps_in_track_end = this->template create_socket_in<uint8_t>(p, "in_track_end", max_tracks_size * sizeof(ROI_light_t));
     auto ps_in_track_obj_type = this->template create_socket_in<uint8_t>(p, "in_track_obj_type", max_tracks_size * sizeof(enum obj_e));
     auto ps_in_n_tracks = this->template create_socket_in<uint32_t>(p, "in_n_tracks", 1);
@@ -89,7 +89,7 @@ Logger_ROI::Logger_ROI(const std::string ROI_path, const size_t max_ROI_size, co
                                       static_cast<const int32_t*>(t[ps_in_ROI1_time].get_dataptr()),
                                       static_cast<const int32_t*>(t[ps_in_ROI1_time_motion].get_dataptr()),
                                       *static_cast<const uint32_t*>(t[ps_in_n_ROI1].get_dataptr()),
-                                      static_cast<const uint16_t*>(t[ps_in_track_id].get_dataptr()),
+                                      static_cast<const uint32_t*>(t[ps_in_track_id].get_dataptr()),
                                       static_cast<const ROI_light_t*>(t[ps_in_track_end].get_dataptr()),
                                       static_cast<const enum obj_e*>(t[ps_in_track_obj_type].get_dataptr()),
                                       *static_cast<const uint32_t*>(t[ps_in_n_tracks].get_dataptr()));
@@ -10,7 +10,7 @@ Logger_track::Logger_track(const std::string tracks_path, const size_t max_track
     this->set_short_name(name);
 
     auto &p = this->create_task("write");
-    auto ps_in_track_id = this->template create_socket_in<uint16_t>(p, "in_track_id", max_tracks_size);
+    auto ps_in_track_id = this->template create_socket_in<uint32_t>(p, "in_track_id", max_tracks_size);
     auto ps_in_track_begin = this->template create_socket_in<uint8_t>(p, "in_track_begin", max_tracks_size * sizeof(ROI_light_t));
     auto ps_in_track_end = this->template create_socket_in<uint8_t>(p, "in_track_end", max_tracks_size * sizeof(ROI_light_t));
     auto ps_in_track_obj_type = this->template create_socket_in<uint8_t>(p, "in_track_obj_type", max_tracks_size * sizeof(enum obj_e));
@@ -27,7 +27,7 @@ Logger_track::Logger_track(const std::string tracks_path, const size_t max_track
 
         const uint32_t frame = *static_cast<const size_t*>(t[ps_in_frame].get_dataptr());
 
-        const uint16_t* track_id = static_cast<const uint16_t*>(t[ps_in_track_id].get_dataptr());
+        const uint32_t* track_id = static_cast<const uint32_t*>(t[ps_in_track_id].get_dataptr());
         const ROI_light_t* track_begin = static_cast<const ROI_light_t*>(t[ps_in_track_begin].get_dataptr());
         const ROI_light_t* track_end = static_cast<const ROI_light_t*>(t[ps_in_track_end].get_dataptr());
         const enum obj_e* track_obj_type = static_cast<const enum obj_e*>(t[ps_in_track_obj_type].get_dataptr());
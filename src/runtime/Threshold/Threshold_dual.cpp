@@ -0,0 +1,71 @@
+#include "fmdt/threshold.h"
+
+#include "fmdt/Threshold/Threshold_dual.hpp"
+
+Threshold_dual::Threshold_dual(const int i0, const int i1, const int j0, const int j1, const int b,
+                               const uint8_t thr_min, const uint8_t thr_max)
+: Module(), i0(i0), i1(i1), j0(j0), j1(j1), b(b), thr_min(thr_min), thr_max(thr_max), in_img(nullptr),
+  out_img_min(nullptr), out_img_max(nullptr) {
+    const std::string name = "Threshold_dual";
+    this->set_name(name);
+    this->set_short_name(name);
+
+    this->init_data();
+
+    auto socket_size = ((i1 - i0) + 1 + 2 * b) * ((j1 - j0) + 1 + 2 * b);
+
+    auto &p = this->create_task("apply");
+    auto ps_in_img = this->template create_socket_in<uint8_t>(p, "in", socket_size);
+    auto ps_out_img_min = this->template create_socket_out<uint8_t>(p, "out_min", socket_size);
+    auto ps_out_img_max = this->template create_socket_out<uint8_t>(p, "out_max", socket_size);
+
+    this->create_codelet(p, [ps_in_img, ps_out_img_min, ps_out_img_max](aff3ct::module::Module &m,
+                                                                        aff3ct::module::Task &t,
+                                                                        const size_t frame_id) -> int {
+        auto &thr = static_cast<Threshold_dual&>(m);
+        const int row_size = (thr.j1 - thr.j0) + 1 + 2 * thr.b;
+
+        const uint8_t* m_in_img = static_cast<const uint8_t*>(t[ps_in_img].get_dataptr());
+        uint8_t* m_out_img_min = static_cast<uint8_t*>(t[ps_out_img_min].get_dataptr());
+        uint8_t* m_out_img_max = static_cast<uint8_t*>(t[ps_out_img_max].get_dataptr());
+        thr.in_img[thr.i0 - thr.b] = m_in_img - (thr.j0 - thr.b);
+        thr.out_img_min[thr.i0 - thr.b] = m_out_img_min - (thr.j0 - thr.b);
+        thr.out_img_max[thr.i0 - thr.b] = m_out_img_max - (thr.j0 - thr.b);
+        for (int i = thr.i0 - thr.b + 1; i <= thr.i1 + thr.b; i++) {
+            thr.in_img[i] = thr.in_img[i - 1] + row_size;
+            thr.out_img_min[i] = thr.out_img_min[i - 1] + row_size;
+            thr.out_img_max[i] = thr.out_img_max[i - 1] + row_size;
+        }
+
+        threshold_dual(thr.in_img, thr.out_img_min, thr.out_img_max, nullptr, nullptr, thr.i0, thr.i1, thr.j0, thr.j1,
+                       thr.thr_min, thr.thr_max);
+        return aff3ct::module::status_t::SUCCESS;
+    });
+}
+
+void Threshold_dual::init_data() {
+    this->in_img = (const uint8_t**)malloc((size_t)(((i1 - i0) + 1 + 2 * b) * sizeof(const uint8_t*)));
+    this->out_img_min = (uint8_t**)malloc((size_t)(((i1 - i0) + 1 + 2 * b) * sizeof(uint8_t*)));
+    this->out_img_max = (uint8_t**)malloc((size_t)(((i1 - i0) + 1 + 2 * b) * sizeof(uint8_t*)));
+    this->in_img -= i0 - b;
+    this->out_img_min -= i0 - b;
+    this->out_img_max -= i0 - b;
+}
+
+Threshold_dual::~Threshold_dual() {
+    free(this->in_img + this->i0 - this->b);
+    free(this->out_img_min + this->i0 - this->b);
+    free(this->out_img_max + this->i0 - this->b);
+}
+
+Threshold_dual* Threshold_dual::clone() const {
+    auto m = new Threshold_dual(*this);
+    m->deep_copy(*this);
+    return m;
+}
+
+void Threshold_dual::deep_copy(const Threshold_dual &m)
+{
+    Module::deep_copy(m);
+    this->init_data();
+}
@@ -4,29 +4,29 @@
 
 Tracking::Tracking(const size_t r_extrapol, const float angle_max, const float diff_dev, const int track_all,
                    const size_t fra_star_min, const size_t fra_meteor_min, const size_t fra_meteor_max,
-                   const size_t max_ROI_size, const size_t max_tracks_size, const size_t max_n_frames)
+                   const size_t max_ROI_size, const size_t max_tracks_size)
 : Module(), r_extrapol(r_extrapol), angle_max(angle_max), diff_dev(diff_dev), track_all(track_all),
   fra_star_min(fra_star_min), fra_meteor_min(fra_meteor_min), fra_meteor_max(fra_meteor_max),
-  max_ROI_size(max_ROI_size), max_tracks_size(max_tracks_size), max_n_frames(max_n_frames), tracking_data(nullptr),
-  track_array(nullptr), BB_array(nullptr) {
+  max_ROI_size(max_ROI_size), max_tracks_size(max_tracks_size), tracking_data(nullptr), track_array(nullptr),
+  BB_log(nullptr) {
     const std::string name = "Tracking";
     this->set_name(name);
     this->set_short_name(name);
 
     this->tracking_data = tracking_alloc_data(std::max(fra_star_min, fra_meteor_min), max_ROI_size);
     this->track_array = tracking_alloc_track_array(max_tracks_size);
-    this->BB_array = (BB_t**)malloc(max_n_frames * sizeof(BB_t*));
+    this->BB_log = tracking_alloc_BB_log(max_tracks_size, 1);
 
     tracking_init_data(this->tracking_data);
     tracking_init_track_array(this->track_array);
-    tracking_init_BB_array(this->BB_array);
+    tracking_init_BB_log(this->BB_log);
 
     auto &p = this->create_task("perform");
 
     auto ps_in_frame = this->template create_socket_in<uint32_t>(p, "in_frame", 1);
 
     auto ps_in_ROI0_id = this->template create_socket_in<uint16_t>(p, "in_ROI0_id", max_ROI_size);
-    auto ps_in_ROI0_frame = this->template create_socket_in<uint32_t>(p, "in_ROI0_frame", max_ROI_size);
+    auto ps_in_ROI0_frame = this->template create_socket_in<uint64_t>(p, "in_ROI0_frame", max_ROI_size);
     auto ps_in_ROI0_xmin = this->template create_socket_in<uint16_t>(p, "in_ROI0_xmin", max_ROI_size);
     auto ps_in_ROI0_xmax = this->template create_socket_in<uint16_t>(p, "in_ROI0_xmax", max_ROI_size);
     auto ps_in_ROI0_ymin = this->template create_socket_in<uint16_t>(p, "in_ROI0_ymin", max_ROI_size);
@@ -57,13 +57,13 @@ Tracking::Tracking(const size_t r_extrapol, const float angle_max, const float d
     auto ps_in_mean_error = this->template create_socket_in<double>(p, "in_mean_error", 1);
     auto ps_in_std_deviation = this->template create_socket_in<double>(p, "in_std_deviation", 1);
 
-    auto ps_out_ROI1_frame = this->template create_socket_out<uint32_t>(p, "out_ROI1_frame", max_ROI_size);
+    auto ps_out_ROI1_frame = this->template create_socket_out<uint64_t>(p, "out_ROI1_frame", max_ROI_size);
     auto ps_out_ROI1_time = this->template create_socket_out<int32_t>(p, "out_ROI1_time", max_ROI_size);
     auto ps_out_ROI1_time_motion = this->template create_socket_out<int32_t>(p, "out_ROI1_time_motion", max_ROI_size);
     auto ps_out_ROI1_is_extrapolated = this->template create_socket_out<uint8_t>(p, "out_ROI1_is_extrapolated", max_ROI_size);
 
 
-    auto ps_out_track_id = this->template create_socket_out<uint16_t>(p, "out_track_id", max_tracks_size);
+    auto ps_out_track_id = this->template create_socket_out<uint32_t>(p, "out_track_id", max_tracks_size);
     auto ps_out_track_begin = this->template create_socket_out<uint8_t>(p, "out_track_begin", max_tracks_size * sizeof(ROI_light_t));
     auto ps_out_track_end = this->template create_socket_out<uint8_t>(p, "out_track_end", max_tracks_size * sizeof(ROI_light_t));
     auto ps_out_track_extrapol_x = this->template create_socket_out<float>(p, "out_track_extrapol_x", max_tracks_size);
@@ -91,14 +91,14 @@ Tracking::Tracking(const size_t r_extrapol, const float angle_max, const float d
         const uint32_t n_ROI1 = *static_cast<const uint32_t*>(t[ps_in_n_ROI1].get_dataptr());
         const uint32_t frame = *static_cast<const size_t*>(t[ps_in_frame].get_dataptr());
 
-        std::fill_n(static_cast<uint32_t*>(t[ps_out_ROI1_frame].get_dataptr()), n_ROI1, frame);
+        std::fill_n(static_cast<uint64_t*>(t[ps_out_ROI1_frame].get_dataptr()), n_ROI1, (uint64_t)frame);
         std::fill_n(static_cast<int32_t*>(t[ps_out_ROI1_time].get_dataptr()), n_ROI1, 0);
         std::fill_n(static_cast<int32_t*>(t[ps_out_ROI1_time_motion].get_dataptr()), n_ROI1, 0);
         std::fill_n(static_cast<uint8_t*>(t[ps_out_ROI1_is_extrapolated].get_dataptr()), n_ROI1, 0);
 
         _tracking_perform(trk.tracking_data,
                           static_cast<const uint16_t*>(t[ps_in_ROI0_id].get_dataptr()),
-                          static_cast<const uint32_t*>(t[ps_in_ROI0_frame].get_dataptr()),
+                          static_cast<const uint64_t*>(t[ps_in_ROI0_frame].get_dataptr()),
                           static_cast<const uint16_t*>(t[ps_in_ROI0_xmin].get_dataptr()),
                           static_cast<const uint16_t*>(t[ps_in_ROI0_xmax].get_dataptr()),
                           static_cast<const uint16_t*>(t[ps_in_ROI0_ymin].get_dataptr()),
@@ -113,7 +113,7 @@ Tracking::Tracking(const size_t r_extrapol, const float angle_max, const float d
                           static_cast<const uint8_t*>(t[ps_in_ROI0_is_extrapolated].get_dataptr()),
                           n_ROI0,
                           static_cast<const uint16_t*>(t[ps_in_ROI1_id].get_dataptr()),
-                          static_cast<const uint32_t*>(t[ps_out_ROI1_frame].get_dataptr()),
+                          static_cast<const uint64_t*>(t[ps_out_ROI1_frame].get_dataptr()),
                           static_cast<const uint16_t*>(t[ps_in_ROI1_xmin].get_dataptr()),
                           static_cast<const uint16_t*>(t[ps_in_ROI1_xmax].get_dataptr()),
                           static_cast<const uint16_t*>(t[ps_in_ROI1_ymin].get_dataptr()),
@@ -135,7 +135,9 @@ Tracking::Tracking(const size_t r_extrapol, const float angle_max, const float d
                           trk.track_array->change_state_reason,
                           &trk.track_array->_offset,
                           &trk.track_array->_size,
-                          trk.BB_array,
+                          trk.track_array->_max_size,
+                          trk.track_array->_n_flushed,
+                          trk.BB_log,
                           frame,
                           *static_cast<double*>(t[ps_in_theta].get_dataptr()),
                           *static_cast<double*>(t[ps_in_tx].get_dataptr()),
@@ -145,7 +147,7 @@ Tracking::Tracking(const size_t r_extrapol, const float angle_max, const float d
                           trk.r_extrapol, trk.angle_max, trk.diff_dev, trk.track_all, trk.fra_star_min,
                           trk.fra_meteor_min, trk.fra_meteor_max);
 
-        uint16_t* out_track_id = static_cast<uint16_t*>(t[ps_out_track_id].get_dataptr());
+        uint32_t* out_track_id = static_cast<uint32_t*>(t[ps_out_track_id].get_dataptr());
         ROI_light_t* out_track_begin = static_cast<ROI_light_t*>(t[ps_out_track_begin].get_dataptr());
         ROI_light_t* out_track_end = static_cast<ROI_light_t*>(t[ps_out_track_end].get_dataptr());
         float* out_track_extrapol_x = static_cast<float*>(t[ps_out_track_extrapol_x].get_dataptr());
@@ -178,6 +180,5 @@ Tracking::Tracking(const size_t r_extrapol, const float angle_max, const float d
 Tracking::~Tracking() {
     tracking_free_data(this->tracking_data);
     tracking_free_track_array(this->track_array);
-    tracking_free_BB_array(this->BB_array);
-    free(this->BB_array);
+    tracking_free_BB_log(this->BB_log);
 }